@@ -2,7 +2,6 @@
 
 const byte DNS_PORT = 53;
 const char magicBytes[MAGIC_LENGTH] = {'C', 'M'};
-const char magicBytesEmpty[MAGIC_LENGTH] = {'\0', '\0'};
 
 const char mimeHTML[] PROGMEM = "text/html";
 const char mimeJSON[] PROGMEM = "application/json";
@@ -11,6 +10,203 @@ const char mimeCSS[] PROGMEM = "text/css";
 const char mimeJS[] PROGMEM = "application/javascript";
 
 bool DEBUG_MODE = false;
+LogRing<LOG_RING_SIZE> debugLog;
+
+/**
+ * Chunked Response
+ *
+ * Collects a response body in a small buffer and sends it out as HTTP
+ * chunks, so the body never exists as a whole in memory.
+ */
+class ChunkedResponse : public Print {
+public:
+    ChunkedResponse(WebServer *server) : server(server), length(0) {}
+
+    using Print::write;
+
+    size_t write(uint8_t c) {
+        buf[length++] = c;
+        if (length == sizeof(buf)) {
+            send();
+        }
+        return 1;
+    }
+
+    void end() {
+        send();
+        server->sendContent("");
+    }
+
+private:
+    WebServer *server;
+    char buf[128];
+    size_t length;
+
+    void send() {
+        if (length > 0) {
+            server->sendContent_P(buf, length);
+            length = 0;
+        }
+    }
+};
+
+static long readInteger(const uint8_t *ptr, size_t size, bool isSigned) {
+    switch (size) {
+        case 1: { int8_t s; uint8_t u; memcpy(&s, ptr, 1); memcpy(&u, ptr, 1); return isSigned ? (long)s : (long)u; }
+        case 2: { int16_t s; uint16_t u; memcpy(&s, ptr, 2); memcpy(&u, ptr, 2); return isSigned ? (long)s : (long)u; }
+        case 4: { int32_t s; uint32_t u; memcpy(&s, ptr, 4); memcpy(&u, ptr, 4); return isSigned ? (long)s : (long)u; }
+        default: { long v = 0; memcpy(&v, ptr, size < sizeof(v) ? size : sizeof(v)); return v; }
+    }
+}
+
+static void writeInteger(uint8_t *ptr, size_t size, long value) {
+    switch (size) {
+        case 1: { int8_t v = value; memcpy(ptr, &v, 1); break; }
+        case 2: { int16_t v = value; memcpy(ptr, &v, 2); break; }
+        case 4: { int32_t v = value; memcpy(ptr, &v, 4); break; }
+        default: memcpy(ptr, &value, size < sizeof(value) ? size : sizeof(value));
+    }
+}
+
+static void printJsonString(Print &out, const char *value, size_t size) {
+    out.write('"');
+    for (size_t i = 0; i < size && value[i]; i++) {
+        char c = value[i];
+        if (c == '"' || c == '\\') {
+            out.write('\\');
+            out.write(c);
+        } else if ((uint8_t)c < 0x20) {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out.write(escaped);
+        } else {
+            out.write(c);
+        }
+    }
+    out.write('"');
+}
+
+static void printJsonField(Print &out, const ConfigField &field, const uint8_t *config) {
+    const uint8_t *ptr = config + field.offset;
+    char number[24];
+
+    switch (field.type) {
+        case PARAMETER_BOOL:
+            out.write(*ptr ? "true" : "false");
+            break;
+        case PARAMETER_INT:
+            snprintf(number, sizeof(number), "%ld", readInteger(ptr, field.size, true));
+            out.write(number);
+            break;
+        case PARAMETER_UINT:
+            snprintf(number, sizeof(number), "%lu", (unsigned long)readInteger(ptr, field.size, false));
+            out.write(number);
+            break;
+        case PARAMETER_FLOAT: {
+            double value;
+            if (field.size == sizeof(float)) {
+                float f;
+                memcpy(&f, ptr, sizeof(f));
+                value = f;
+            } else {
+                memcpy(&value, ptr, sizeof(value));
+            }
+            if (isnan(value) || isinf(value)) {
+                out.write("null");
+            } else {
+                snprintf(number, sizeof(number), field.size == sizeof(float) ? "%.9g" : "%.15g", value);
+                out.write(number);
+            }
+            break;
+        }
+        case PARAMETER_STRING:
+            printJsonString(out, (const char *)ptr, field.size);
+            break;
+    }
+}
+
+// Stores a JSON value in a field. Values of the wrong type are ignored.
+static void setField(const ConfigField &field, uint8_t *config, JsonToken token, const char *value) {
+    uint8_t *ptr = config + field.offset;
+
+    switch (field.type) {
+        case PARAMETER_BOOL:
+            if (token == JSON_TRUE || token == JSON_FALSE) {
+                *ptr = token == JSON_TRUE;
+            }
+            break;
+        case PARAMETER_INT:
+            if (token == JSON_NUMBER) {
+                writeInteger(ptr, field.size, strtol(value, NULL, 10));
+            }
+            break;
+        case PARAMETER_UINT:
+            if (token == JSON_NUMBER) {
+                writeInteger(ptr, field.size, (long)strtoul(value, NULL, 10));
+            }
+            break;
+        case PARAMETER_FLOAT:
+            if (token == JSON_NUMBER) {
+                if (field.size == sizeof(float)) {
+                    float f = strtof(value, NULL);
+                    memcpy(ptr, &f, sizeof(f));
+                } else {
+                    double d = strtod(value, NULL);
+                    memcpy(ptr, &d, sizeof(d));
+                }
+            }
+            break;
+        case PARAMETER_STRING:
+            if (token == JSON_STRING) {
+                memset(ptr, 0, field.size);
+                strncpy((char *)ptr, value, field.size - 1);
+            }
+            break;
+    }
+}
+
+// Pulls the members of a flat JSON object and hands every scalar one to
+// member. Nested values are skipped. Returns the HTTP status to answer
+// with: 200, 400 for malformed JSON or 413 when a string or number does
+// not fit CONFIG_JSON_ARENA.
+static int pullObject(const char *body, size_t length, std::function<void(const char *, JsonToken, const char *)> member) {
+    char arena[CONFIG_JSON_ARENA];
+    char key[CONFIG_JSON_KEY];
+    JsonPullParser json(body, length, arena, sizeof(arena));
+
+    JsonToken token = json.next();
+    if (token == JSON_OBJECT_BEGIN) {
+        while ((token = json.next()) == JSON_KEY) {
+            // Longer keys cannot name a field, their values are skipped.
+            bool known = json.getTextLength() < sizeof(key);
+            if (known) {
+                memcpy(key, json.text(), json.getTextLength() + 1);
+            }
+
+            token = json.next();
+            if (token == JSON_OBJECT_BEGIN || token == JSON_ARRAY_BEGIN) {
+                if (!json.skip(token)) {
+                    break;
+                }
+                continue;
+            }
+            if (token == JSON_ERROR || token == JSON_TOO_LONG) {
+                break;
+            }
+
+            if (known) {
+                member(key, token, json.text());
+            }
+        }
+
+        token = json.next();
+    }
+
+    if (token == JSON_END) {
+        return 200;
+    }
+    return token == JSON_TOO_LONG ? 413 : 400;
+}
 
 Mode ConfigManager::getMode() {
     return this->mode;
@@ -52,11 +248,20 @@ void ConfigManager::setAPICallback(std::function<void(WebServer*)> callback) {
     this->apiCallback = callback;
 }
 
+void ConfigManager::setAssets(const EmbeddedAsset *assets, size_t count) {
+    this->assets = assets;
+    this->assetCount = count;
+}
+
 void ConfigManager::loop() {
-    if (mode == ap && apTimeout > 0 && ((millis() - apStart) / 1000) > apTimeout) {
+    if (mode == ap && apTimeout > 0 && ((millis() - apStart) / 1000) > (unsigned long)apTimeout) {
         ESP.restart();
     }
 
+    if (scanning) {
+        serviceScan();
+    }
+
     if (dnsServer) {
         dnsServer->processNextRequest();
     }
@@ -70,25 +275,20 @@ void ConfigManager::save() {
     this->writeConfig();
 }
 
-JsonObject &ConfigManager::decodeJson(String jsonString)
-{
-    DynamicJsonBuffer jsonBuffer;
-
-    if (jsonString.length() == 0) {
-        return jsonBuffer.createObject();
-    }
-
-    JsonObject& obj = jsonBuffer.parseObject(jsonString);
-
-    if (!obj.success()) {
-        return jsonBuffer.createObject();
+// Answers 413 when the request body is larger than CONFIG_MAX_BODY.
+bool ConfigManager::rejectLargeBody(const String &body) {
+    if (server->header("Content-Length").toInt() <= CONFIG_MAX_BODY && body.length() <= (size_t)CONFIG_MAX_BODY) {
+        return false;
     }
 
-    return obj;
+    server->send(413, FPSTR(mimePlain), F("Payload too large."));
+    return true;
 }
 
 void ConfigManager::streamFile(const char *file, const char mime[]) {
-    SPIFFS.begin();
+    if (!spiffsMounted) {
+        spiffsMounted = SPIFFS.begin();
+    }
 
     File f = SPIFFS.open(file, "r");
     if (!f) {
@@ -102,30 +302,99 @@ void ConfigManager::streamFile(const char *file, const char mime[]) {
 }
 
 void ConfigManager::handleAPGet() {
-    streamFile(apFilename, mimeHTML);
+    if (!serveAsset(apFilename)) {
+        streamFile(apFilename, mimeHTML);
+    }
+}
+
+// Sends an embedded asset as stored, gzipped. A client that already holds
+// this version gets a bodyless 304. HTML is revalidated on every load so
+// a firmware update shows up; the rest is cached for a day.
+bool ConfigManager::serveAsset(const char *path) {
+    const EmbeddedAsset *asset = NULL;
+    for (size_t i = 0; i < assetCount; i++) {
+        if (strcmp(assets[i].path, path) == 0) {
+            asset = &assets[i];
+            break;
+        }
+    }
+    if (!asset) {
+        return false;
+    }
+
+    bool isHTML = strcmp(asset->mime, mimeHTML) == 0;
+    server->sendHeader("ETag", asset->etag);
+    server->sendHeader("Cache-Control", isHTML ? "no-cache" : "max-age=86400");
+
+    if (server->header("If-None-Match") == asset->etag) {
+        server->send(304);
+        return true;
+    }
+
+    server->sendHeader("Content-Encoding", "gzip");
+    server->send_P(200, asset->mime, (PGM_P)asset->data, asset->length);
+    return true;
 }
 
+// Takes pitch and velocity, and any settable field of the Config struct
+// under its own name, e.g. per-pad lists next to the defaults.
 void ConfigManager::handleAPPost() {
     bool isJson = server->header("Content-Type") == FPSTR(mimeJSON);
-    String pitch;
-    String velocity;
+    char pitch[MIDI_LENGTH] = "";
+    char velocity[MIDI_LENGTH] = "";
+    bool configChanged = false;
 
-    if (isJson) {
-        JsonObject& obj = this->decodeJson(server->arg("plain"));
+    // arg() hands out a copy; take it once for the check and the parser.
+    const String &body = server->arg("plain");
+    if (rejectLargeBody(body)) {
+        return;
+    }
 
-        pitch = obj.get<String>("pitch");
-        velocity = obj.get<String>("velocity");
+    if (isJson) {
+        int status = pullObject(body.c_str(), body.length(), [&](const char *key, JsonToken token, const char *value) {
+            if (token != JSON_STRING && token != JSON_NUMBER) {
+                return;
+            }
+            if (strcmp(key, "pitch") == 0) {
+                strncpy(pitch, value, MIDI_LENGTH - 1);
+            } else if (strcmp(key, "velocity") == 0) {
+                strncpy(velocity, value, MIDI_LENGTH - 1);
+            }
+            for (size_t i = 0; i < fieldCount; i++) {
+                if (fields[i].mode != get && strcmp(fields[i].name, key) == 0) {
+                    setField(fields[i], (uint8_t *)config, token, value);
+                    configChanged = true;
+                }
+            }
+        });
+        if (status != 200) {
+            readConfig();
+            server->send(status, FPSTR(mimePlain), F("Invalid JSON."));
+            return;
+        }
     } else {
-        pitch = server->arg("pitch");
-        velocity = server->arg("velocity");
+        strncpy(pitch, server->arg("pitch").c_str(), MIDI_LENGTH - 1);
+        strncpy(velocity, server->arg("velocity").c_str(), MIDI_LENGTH - 1);
+        // Form values are all text; numbers are parsed as if from JSON.
+        for (size_t i = 0; i < fieldCount; i++) {
+            if (fields[i].mode != get && server->hasArg(fields[i].name)) {
+                JsonToken token = fields[i].type == PARAMETER_STRING ? JSON_STRING : JSON_NUMBER;
+                setField(fields[i], (uint8_t *)config, token, server->arg(fields[i].name).c_str());
+                configChanged = true;
+            }
+        }
     }
 
-    if (pitch.length() == 0) {
+    if (pitch[0] == '\0') {
+        readConfig();
         server->send(400, FPSTR(mimePlain), F("Invalid ssid."));
         return;
     }
 
-    storeMidiValues(pitch, velocity, false);
+    storeMidiValues(pitch, velocity);
+    if (configChanged) {
+        writeConfig();
+    }
 
     server->send(204, FPSTR(mimePlain), F("Saved. Will attempt to reboot."));
 
@@ -133,79 +402,150 @@ void ConfigManager::handleAPPost() {
 
 }
 
+// Answers from the scan cache right away and starts a background scan
+// when the cache is older than SCAN_TTL_MS. The client polls again while
+// "scanning" is true.
 void ConfigManager::handleScanGet() {
-    DynamicJsonBuffer jsonBuffer;
-    JsonArray& jsonArray = jsonBuffer.createArray();
-
-    DebugPrintln("Scanning WiFi networks...");
-    int n = WiFi.scanNetworks();
-    DebugPrintln("scan complete");
-    if (n == 0) {
-        DebugPrintln("no networks found");
+    unsigned long now = millis();
+    bool stale = scannedAt == 0 || now - scannedAt >= SCAN_TTL_MS;
+    if (stale && !scanning) {
+        startScan();
+    }
+
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, FPSTR(mimeJSON), "");
+
+    ChunkedResponse out(server.get());
+    char number[12];
+
+    out.write("{\"scanning\":");
+    out.write(scanning ? "true" : "false");
+    out.write(",\"age\":");
+    if (scannedAt == 0) {
+        out.write("null");
     } else {
-        DebugPrint(n);
-        DebugPrintln(" networks found:");
-
-        for (int i = 0; i < n; ++i) {
-            String ssid = WiFi.SSID(i);
-            int rssi = WiFi.RSSI(i);
-            String security = WiFi.encryptionType(i) == WIFI_OPEN ? "none" : "enabled";
-
-            DebugPrint("Name: ");
-            DebugPrint(ssid);
-            DebugPrint(" - Strength: ");
-            DebugPrint(rssi);
-            DebugPrint(" - Security: ");
-            DebugPrintln(security);
-
-            DynamicJsonBuffer jsonBufferItem;
-            JsonObject& obj = jsonBuffer.createObject();
-            obj.set("ssid", ssid);
-            obj.set("strength", rssi);
-            obj.set("security", security == "none" ? false : true);
-            jsonArray.add(obj);
+        snprintf(number, sizeof(number), "%lu", now - scannedAt);
+        out.write(number);
+    }
+    out.write(",\"networks\":[");
+    for (uint8_t i = 0; i < scanCount; i++) {
+        if (i > 0) {
+            out.write(',');
         }
+        out.write("{\"ssid\":");
+        printJsonString(out, scanResults[i].ssid, sizeof(scanResults[i].ssid));
+        snprintf(number, sizeof(number), "%d", scanResults[i].rssi);
+        out.write(",\"strength\":");
+        out.write(number);
+        out.write(",\"security\":");
+        out.write(scanResults[i].secure ? "true" : "false");
+        out.write('}');
     }
+    out.write("]}");
+    out.end();
+}
 
-    String body;
-    jsonArray.printTo(body);
-
-    server->send(200, FPSTR(mimeJSON), body);
+void ConfigManager::startScan() {
+    DebugLog(LOG_SCAN_STARTED);
+    scanning = WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
 }
 
-void ConfigManager::handleRESTGet() {
-    DynamicJsonBuffer jsonBuffer;
-    JsonObject& obj = jsonBuffer.createObject();
+// Copies the results of a finished background scan into the cache,
+// strongest networks first.
+void ConfigManager::serviceScan() {
+    int16_t n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) {
+        return;
+    }
+
+    scanning = false;
+    if (n < 0) {
+        DebugLog(LOG_SCAN_FAILED);
+        return;
+    }
 
-    std::list<BaseParameter*>::iterator it;
-    for (it = parameters.begin(); it != parameters.end(); ++it) {
-        if ((*it)->getMode() == set) {
+    DebugLog(LOG_SCAN_DONE, n);
+
+    scanCount = 0;
+    for (int16_t i = 0; i < n; ++i) {
+        ScanResult result;
+        strncpy(result.ssid, WiFi.SSID(i).c_str(), sizeof(result.ssid) - 1);
+        result.ssid[sizeof(result.ssid) - 1] = '\0';
+        result.rssi = WiFi.RSSI(i);
+        result.secure = WiFi.encryptionType(i) != WIFI_OPEN;
+
+        // Insertion into the sorted cache, the weakest falls off when full.
+        uint8_t at = scanCount;
+        while (at > 0 && scanResults[at - 1].rssi < result.rssi) {
+            at--;
+        }
+        if (at == SCAN_MAX_RESULTS) {
             continue;
         }
+        uint8_t last = scanCount < SCAN_MAX_RESULTS ? scanCount : SCAN_MAX_RESULTS - 1;
+        for (uint8_t j = last; j > at; j--) {
+            scanResults[j] = scanResults[j - 1];
+        }
+        scanResults[at] = result;
+        if (scanCount < SCAN_MAX_RESULTS) {
+            scanCount++;
+        }
+    }
 
-        (*it)->toJson(&obj);
+    WiFi.scanDelete();
+    scannedAt = millis();
+    if (scannedAt == 0) {
+        scannedAt = 1;
     }
+}
+
+// Streams the settings straight from the Config struct into the response.
+void ConfigManager::handleRESTGet() {
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, FPSTR(mimeJSON), "");
+
+    ChunkedResponse out(server.get());
+    bool first = true;
+
+    out.write('{');
+    for (size_t i = 0; i < fieldCount; i++) {
+        if (fields[i].mode == set) {
+            continue;
+        }
 
-    String body;
-    obj.printTo(body);
+        if (!first) {
+            out.write(',');
+        }
+        first = false;
 
-    server->send(200, FPSTR(mimeJSON), body);
+        printJsonString(out, fields[i].name, strlen(fields[i].name));
+        out.write(':');
+        printJsonField(out, fields[i], (const uint8_t *)config);
+    }
+    out.write('}');
+    out.end();
 }
 
+// Applies each member of the body to its field while parsing. A broken
+// body puts the Config struct back the way it was stored.
 void ConfigManager::handleRESTPut() {
-    JsonObject& obj = this->decodeJson(server->arg("plain"));
-    if (!obj.success()) {
-        server->send(400, FPSTR(mimeJSON), "");
+    const String &body = server->arg("plain");
+    if (rejectLargeBody(body)) {
         return;
     }
 
-    std::list<BaseParameter*>::iterator it;
-    for (it = parameters.begin(); it != parameters.end(); ++it) {
-        if ((*it)->getMode() == get) {
-            continue;
+    int status = pullObject(body.c_str(), body.length(), [this](const char *key, JsonToken token, const char *value) {
+        for (size_t i = 0; i < fieldCount; i++) {
+            if (fields[i].mode != get && strcmp(fields[i].name, key) == 0) {
+                setField(fields[i], (uint8_t *)config, token, value);
+            }
         }
+    });
 
-        (*it)->fromJson(&obj);
+    if (status != 200) {
+        readConfig();
+        server->send(status, FPSTR(mimeJSON), "");
+        return;
     }
 
     writeConfig();
@@ -253,7 +593,6 @@ bool ConfigManager::wifiConnected() {
 }
 
 void ConfigManager::setup() {
-    char magic[MAGIC_LENGTH];
     char pitch[MIDI_LENGTH];
     char velocity[MIDI_LENGTH];
 
@@ -262,19 +601,102 @@ void ConfigManager::setup() {
     DebugPrint(F("MAC: "));
     DebugPrintln(WiFi.macAddress());
 
-    EEPROM.get(0, magic);
-    EEPROM.get(MAGIC_LENGTH, pitch);
+    if (!store.begin(CONFIG_SCHEMA_VERSION)) {
+        DebugPrintln(F("Config partition not found, settings will not be saved"));
+    }
+
+    if (!store.has(CONFIG_KEY_PITCH)) {
+        migrateEEPROM();
+    }
+
+    getMidiValues(pitch, velocity);
     DebugPrint(F("Pitch: \""));
     DebugPrint(pitch);
     DebugPrintln(F("\""));
 
-    EEPROM.get(MAGIC_LENGTH + MIDI_LENGTH, velocity);
     DebugPrint(F("Velocity: \""));
     DebugPrint(velocity);
     DebugPrintln(F("\""));
     readConfig();
 }
 
+// Copies settings saved by firmware that still used the EEPROM layout.
+void ConfigManager::migrateEEPROM() {
+    char magic[MAGIC_LENGTH];
+    char pitch[MIDI_LENGTH];
+    char velocity[MIDI_LENGTH];
+
+    EEPROM.begin(CONFIG_OFFSET + configSize);
+    EEPROM.get(0, magic);
+    if (memcmp(magic, magicBytes, MAGIC_LENGTH) != 0) {
+        return;
+    }
+
+    DebugPrintln(F("Migrating EEPROM settings"));
+
+    EEPROM.get(MAGIC_LENGTH, pitch);
+    EEPROM.get(MAGIC_LENGTH + MIDI_LENGTH, velocity);
+    pitch[MIDI_LENGTH - 1] = '\0';
+    velocity[MIDI_LENGTH - 1] = '\0';
+    storeMidiValues(pitch, velocity);
+
+    byte *ptr = (byte *)config;
+    for (size_t i = 0; i < configSize; i++) {
+        *(ptr++) = EEPROM.read(CONFIG_OFFSET + i);
+    }
+    writeConfig();
+}
+
+void ConfigManager::getMidiValues(char pitch[MIDI_LENGTH], char velocity[MIDI_LENGTH]) {
+    memset(pitch, 0, MIDI_LENGTH);
+    memset(velocity, 0, MIDI_LENGTH);
+
+    store.get(CONFIG_KEY_PITCH, pitch, MIDI_LENGTH - 1);
+    store.get(CONFIG_KEY_VELOCITY, velocity, MIDI_LENGTH - 1);
+}
+
+// The receiver the sensor last paired with, so it can skip the scan at
+// boot. Returns false if none was stored yet.
+bool ConfigManager::getReceiver(uint8_t mac[6], uint8_t &channel) {
+    uint8_t receiver[13];
+    size_t length = store.get(CONFIG_KEY_RECEIVER, receiver, sizeof(receiver));
+    if (length != 7 && length != sizeof(receiver)) {
+        return false;
+    }
+
+    memcpy(mac, receiver, 6);
+    channel = receiver[6];
+    return true;
+}
+
+// The standby receiver stored with it, on the same channel. Returns false
+// if there was none.
+bool ConfigManager::getStandby(uint8_t mac[6]) {
+    uint8_t receiver[13];
+    if (store.get(CONFIG_KEY_RECEIVER, receiver, sizeof(receiver)) != sizeof(receiver)) {
+        return false;
+    }
+
+    memcpy(mac, receiver + 7, 6);
+    return true;
+}
+
+// Cheap to call on every pairing, flash is only written when it changed.
+bool ConfigManager::setReceiver(const uint8_t mac[6], uint8_t channel, const uint8_t standby[6]) {
+    uint8_t receiver[13];
+    memcpy(receiver, mac, 6);
+    receiver[6] = channel;
+    if (standby) {
+        memcpy(receiver + 7, standby, 6);
+    }
+
+    return store.put(CONFIG_KEY_RECEIVER, receiver, standby ? 13 : 7);
+}
+
+const ConfigStoreStats &ConfigManager::getStoreStats() {
+    return store.getStats();
+}
+
 void ConfigManager::startAP() {
     mode = ap;
 
@@ -308,6 +730,9 @@ void ConfigManager::startAP() {
 
     server->begin();
 
+    // Warm the scan cache while the user connects to the portal.
+    startScan();
+
     apStart = millis();
 }
 
@@ -326,7 +751,7 @@ void ConfigManager::startApi() {
 }
 
 void ConfigManager::createBaseWebServer() {
-    const char* headerKeys[] = {"Content-Type"};
+    const char* headerKeys[] = {"Content-Type", "Content-Length", "If-None-Match"};
     size_t headerKeysSize = sizeof(headerKeys)/sizeof(char*);
 
     server.reset(new WebServer(this->webPort));
@@ -338,6 +763,10 @@ void ConfigManager::createBaseWebServer() {
     server->on("/", HTTPMethod::HTTP_GET, std::bind(&ConfigManager::handleAPGet, this));
     server->on("/", HTTPMethod::HTTP_POST, std::bind(&ConfigManager::handleAPPost, this));
     server->on("/scan", HTTPMethod::HTTP_GET, std::bind(&ConfigManager::handleScanGet, this));
+    for (size_t i = 0; i < assetCount; i++) {
+        const char *path = assets[i].path;
+        server->on(path, HTTPMethod::HTTP_GET, [this, path]() { serveAsset(path); });
+    }
     server->onNotFound(std::bind(&ConfigManager::handleNotFound, this));
 }
 
@@ -349,47 +778,34 @@ void ConfigManager::clearMidiValues(bool reboot) {
     memset(velocity, 0, MIDI_LENGTH);
 
     DebugPrintln(F("Clearing WiFi connection."));
-    storeMidiValues(pitch, velocity, true);
+    storeMidiValues(pitch, velocity);
 
     if (reboot) {
         ESP.restart();
     }
 }
 
-void ConfigManager::storeMidiValues(String pitch, String velocity, bool resetMagic) {
-    char pitchChar[MIDI_LENGTH];
-
-    char velocityChar[MIDI_LENGTH];
-
-    // if (EEPROM.length() == 0) {
-    //     DebugPrintln(F("WiFi Settings cannot be stored before ConfigManager::begin()"));
-    //     return;
-    // }
-
-    strncpy(pitchChar, pitch.c_str(), MIDI_LENGTH);
-    strncpy(velocityChar, velocity.c_str(), MIDI_LENGTH);
-
+// Only values that differ from the stored ones reach the flash.
+void ConfigManager::storeMidiValues(const char *pitch, const char *velocity) {
     DebugPrint(F("Storing MIDI values for pitch: \""));
-    DebugPrint(pitchChar);
+    DebugPrint(pitch);
     DebugPrint(F(" velocity: \""));
-    DebugPrint(velocityChar);
+    DebugPrint(velocity);
 
     DebugPrintln(F("\""));
 
-    EEPROM.put(0, resetMagic ? magicBytesEmpty : magicBytes);
-    EEPROM.put(MAGIC_LENGTH, pitchChar);
-    EEPROM.put(MAGIC_LENGTH + MIDI_LENGTH, velocityChar);
-    bool wroteChange = EEPROM.commit();
+    bool wroteChange = store.put(CONFIG_KEY_PITCH, pitch, strnlen(pitch, MIDI_LENGTH - 1));
+    wroteChange = store.put(CONFIG_KEY_VELOCITY, velocity, strnlen(velocity, MIDI_LENGTH - 1)) && wroteChange;
 
-    DebugPrint(F("EEPROM committed: "));
-    DebugPrintln(wroteChange ? F("true") : F("false"));
+    DebugLog(wroteChange ? LOG_CONFIG_STORED : LOG_CONFIG_UNCHANGED);
 }
 
 void ConfigManager::clearSettings(bool reboot) {
     DebugPrintln(F("Clearing Settings...."));
-    std::list<BaseParameter*>::iterator it;
-    for (it = parameters.begin(); it != parameters.end(); ++it) {
-        (*it)->clearData();
+    for (size_t i = 0; i < fieldCount; i++) {
+        DebugPrint("Clearing: ");
+        DebugPrintln(fields[i].name);
+        memset((uint8_t *)config + fields[i].offset, 0, fields[i].size);
     }
 
     writeConfig();
@@ -400,20 +816,13 @@ void ConfigManager::clearSettings(bool reboot) {
 }
 
 void ConfigManager::readConfig() {
-    byte *ptr = (byte *)config;
-
-    for (int i = 0; i < configSize; i++) {
-        *(ptr++) = EEPROM.read(CONFIG_OFFSET + i);
-    }
+    store.getBlock(CONFIG_KEY_CONFIG, config, configSize);
 }
 
 void ConfigManager::writeConfig() {
-    byte *ptr = (byte *)config;
-
-    for (int i = 0; i < configSize; i++) {
-        EEPROM.write(CONFIG_OFFSET + i, *(ptr++));
+    if (!store.putBlock(CONFIG_KEY_CONFIG, config, configSize)) {
+        DebugLog(LOG_CONFIG_NOT_STORED);
     }
-    EEPROM.commit();
 }
 
 boolean ConfigManager::isIp(String str) {
@@ -14,9 +14,11 @@
     #include <WebServer.h>
 #endif
 
+#include <stddef.h>
 #include <functional>
-#include <list>
-#include "ArduinoJson.h"
+#include <ConfigStore.h>
+#include <LogRing.h>
+#include "JsonPull.h"
 
 #if defined(ARDUINO_ARCH_ESP8266) //ESP8266
     #define WIFI_OPEN  ENC_TYPE_NONE
@@ -24,18 +26,60 @@
     #define WIFI_OPEN  WIFI_AUTH_OPEN
 #endif
 
-#define MAGIC_LENGTH 2
 #define MIDI_LENGTH 10
+
+// -- Keys in the ConfigStore. The user's Config struct takes the keys from
+//    CONFIG_KEY_CONFIG on, one per CONFIG_STORE_MAX_VALUE bytes.
+#define CONFIG_KEY_PITCH 0
+#define CONFIG_KEY_VELOCITY 1
+#define CONFIG_KEY_CONFIG 2
+#define CONFIG_KEY_RECEIVER (CONFIG_STORE_MAX_KEYS - 1)
+#define CONFIG_MAX_SIZE ((CONFIG_KEY_RECEIVER - CONFIG_KEY_CONFIG) * CONFIG_STORE_MAX_VALUE)
+
+// -- Bump when the Config struct changes layout; settings stored with
+//    another version are ignored.
+#ifndef CONFIG_SCHEMA_VERSION
+#define CONFIG_SCHEMA_VERSION 1
+#endif
+
+// -- Layout of the EEPROM sector used before the ConfigStore, read once
+//    to migrate old devices.
+#define MAGIC_LENGTH 2
 #define CONFIG_OFFSET 22 // sum of previous - where configs start in memory
 
+// -- Request bodies are parsed in place: larger ones are answered with
+//    413, and no string or number in them may exceed the arena. WebServer
+//    has read the whole body by the time a handler runs, so the limit
+//    bounds the parse, not what the request may cost to receive.
+#ifndef CONFIG_MAX_BODY
+#define CONFIG_MAX_BODY 2048
+#endif
+#define CONFIG_JSON_ARENA 128
+#define CONFIG_JSON_KEY 32
+
+// -- /scan answers from a cache of the strongest SCAN_MAX_RESULTS networks
+//    and rescans in the background once the cache is SCAN_TTL_MS old.
+#define SCAN_MAX_RESULTS 20
+#ifndef SCAN_TTL_MS
+#define SCAN_TTL_MS 30000
+#endif
+
 #if defined(ARDUINO_ARCH_ESP8266) //ESP8266
     using WebServer = ESP8266WebServer;
 #endif
 
+// -- Debug messages logged with DebugLog() wait in debugLog until a low
+//    priority task prints them; see LogFormats.h for the formats.
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64
+#endif
+
 extern bool DEBUG_MODE;
+extern LogRing<LOG_RING_SIZE> debugLog;
 
 #define DebugPrintln(a) (DEBUG_MODE ? Serial.println(a) : false)
 #define DebugPrint(a) (DEBUG_MODE ? Serial.print(a) : false)
+#define DebugLog(...) (DEBUG_MODE ? debugLog.log(micros(), __VA_ARGS__) : false)
 
 extern const char mimeHTML[];
 extern const char mimeJSON[];
@@ -46,97 +90,66 @@ extern const char mimeJS[];
 enum Mode {ap, api};
 enum ParameterMode { get, set, both};
 
-/**
- * Base Parameter
- */
-class BaseParameter {
-public:
-    virtual ParameterMode getMode() = 0;
-    virtual void fromJson(JsonObject *json) = 0;
-    virtual void toJson(JsonObject *json) = 0;
-    virtual void clearData() = 0;
+enum ParameterType {
+    PARAMETER_BOOL,
+    PARAMETER_INT,
+    PARAMETER_UINT,
+    PARAMETER_FLOAT,
+    PARAMETER_STRING,
 };
 
 /**
- * Config Parameter
+ * Config Field
+ *
+ * Describes one member of the user's Config struct. Build the table with
+ * CONFIG_FIELD so it is a constant the compiler places in flash:
+ *
+ *   constexpr ConfigField configFields[] = {
+ *       CONFIG_FIELD("threshold", Config, threshold, both),
+ *       CONFIG_FIELD("name", Config, name, get),
+ *   };
+ *   configManager.begin(config, configFields);
+ *
+ * Strings are char arrays, the last byte always stays '\0'.
  */
-template<typename T>
-class ConfigParameter : public BaseParameter {
-public:
-    ConfigParameter(const char *name, T *ptr, ParameterMode mode = both) {
-        this->name = name;
-        this->ptr = ptr;
-        this->mode = mode;
-    }
-
-    ParameterMode getMode() {
-        return this->mode;
-    }
-
-    void fromJson(JsonObject *json) {
-        if (json->containsKey(name) && json->is<T>(name)) {
-            *ptr = json->get<T>(name);
-        }
-    }
-
-    void toJson(JsonObject *json) {
-        json->set(name, *ptr);
-    }
-
-    void clearData() {
-        DebugPrint("Clearing: ");
-        DebugPrintln(name);
-        *ptr = T();
-    }
-
-private:
+struct ConfigField {
     const char *name;
-    T *ptr;
-    std::function<void(const char*)> cb;
+    uint16_t offset;
+    uint16_t size;
+    ParameterType type;
     ParameterMode mode;
 };
 
+template<typename T> struct ConfigFieldType;
+template<> struct ConfigFieldType<bool> { static constexpr ParameterType value = PARAMETER_BOOL; };
+template<> struct ConfigFieldType<signed char> { static constexpr ParameterType value = PARAMETER_INT; };
+template<> struct ConfigFieldType<short> { static constexpr ParameterType value = PARAMETER_INT; };
+template<> struct ConfigFieldType<int> { static constexpr ParameterType value = PARAMETER_INT; };
+template<> struct ConfigFieldType<long> { static constexpr ParameterType value = PARAMETER_INT; };
+template<> struct ConfigFieldType<unsigned char> { static constexpr ParameterType value = PARAMETER_UINT; };
+template<> struct ConfigFieldType<unsigned short> { static constexpr ParameterType value = PARAMETER_UINT; };
+template<> struct ConfigFieldType<unsigned int> { static constexpr ParameterType value = PARAMETER_UINT; };
+template<> struct ConfigFieldType<unsigned long> { static constexpr ParameterType value = PARAMETER_UINT; };
+template<> struct ConfigFieldType<float> { static constexpr ParameterType value = PARAMETER_FLOAT; };
+template<> struct ConfigFieldType<double> { static constexpr ParameterType value = PARAMETER_FLOAT; };
+template<size_t N> struct ConfigFieldType<char[N]> { static constexpr ParameterType value = PARAMETER_STRING; };
+
+#define CONFIG_FIELD(name, Struct, member, mode) \
+    { name, offsetof(Struct, member), sizeof(((Struct *)0)->member), \
+      ConfigFieldType<decltype(((Struct *)0)->member)>::value, mode }
+
 /**
- * Config String Parameter
+ * Embedded Asset
+ *
+ * A gzipped portal file compiled into flash, see scripts/embed_assets.py.
+ * The etag is the quoted content hash.
  */
-class ConfigStringParameter : public BaseParameter {
-public:
-    ConfigStringParameter(const char *name, char *ptr, size_t length, ParameterMode mode = both) {
-        this->name = name;
-        this->ptr = ptr;
-        this->length = length;
-        this->mode = mode;
-    }
-
-    ParameterMode getMode() {
-        return this->mode;
-    }
-
-    void fromJson(JsonObject *json) {
-        if (json->containsKey(name) && json->is<char *>(name)) {
-            const char * value = json->get<const char *>(name);
-
-            memset(ptr, 0, length);
-            strncpy(ptr, const_cast<char*>(value), length - 1);
-        }
-    }
-
-    void toJson(JsonObject *json) {
-        json->set(name, ptr);
-    }
-
-    void clearData() {
-        DebugPrint("Clearing: ");
-        DebugPrintln(name);
-        memset(ptr, 0, length);
-    }
-
-
-private:
-    const char *name;
-    char *ptr;
+struct EmbeddedAsset {
+    const char *path;
+    const char *mime;
+    const uint8_t *data;
     size_t length;
-    ParameterMode mode;
+    const char *etag;
 };
 
 /**
@@ -156,37 +169,41 @@ public:
     void setWebPort(const int port);
     void setAPCallback(std::function<void(WebServer*)> callback);
     void setAPICallback(std::function<void(WebServer*)> callback);
+    void setAssets(const EmbeddedAsset *assets, size_t count);
+    template<size_t N>
+    void setAssets(const EmbeddedAsset (&assets)[N]) {
+        setAssets(assets, N);
+    }
     void loop();
     void streamFile(const char *file, const char mime[]);
     void handleNotFound();
     void clearSettings(bool reboot);
     void clearMidiValues(bool reboot);
     void startAP();
+    void getMidiValues(char pitch[MIDI_LENGTH], char velocity[MIDI_LENGTH]);
+    bool getReceiver(uint8_t mac[6], uint8_t &channel);
+    bool getStandby(uint8_t mac[6]);
+    bool setReceiver(const uint8_t mac[6], uint8_t channel, const uint8_t standby[6] = NULL);
+    const ConfigStoreStats &getStoreStats();
 
     template<typename T>
     void begin(T &config) {
+        static_assert(sizeof(T) <= CONFIG_MAX_SIZE, "Config struct does not fit the config store");
+
         this->config = &config;
         this->configSize = sizeof(T);
 
-        EEPROM.begin(CONFIG_OFFSET + this->configSize);
-
         setup();
     }
 
-    template<typename T>
-    void addParameter(const char *name, T *variable) {
-        parameters.push_back(new ConfigParameter<T>(name, variable));
-    }
-    template<typename T>
-    void addParameter(const char *name, T *variable, ParameterMode mode) {
-        parameters.push_back(new ConfigParameter<T>(name, variable, mode));
-    }
-    void addParameter(const char *name, char *variable, size_t size) {
-        parameters.push_back(new ConfigStringParameter(name, variable, size));
-    }
-    void addParameter(const char *name, char *variable, size_t size, ParameterMode mode) {
-        parameters.push_back(new ConfigStringParameter(name, variable, size, mode));
+    template<typename T, size_t N>
+    void begin(T &config, const ConfigField (&fields)[N]) {
+        this->fields = fields;
+        this->fieldCount = N;
+
+        begin(config);
     }
+
     void save();
 
 private:
@@ -197,6 +214,9 @@ private:
     char *apName = (char *)"Thing";
     char *apPassword = NULL;
     char *apFilename = (char *)"/index.html";
+    const EmbeddedAsset *assets = NULL;
+    size_t assetCount = 0;
+    bool spiffsMounted = false;
     int apTimeout = 0;
     unsigned long apStart = 0;
 
@@ -205,18 +225,35 @@ private:
 
     int webPort = 80;
 
+    const ConfigField *fields = NULL;
+    size_t fieldCount = 0;
+
+    ConfigStore store;
     std::unique_ptr<DNSServer> dnsServer;
     std::unique_ptr<WebServer> server;
-    std::list<BaseParameter*> parameters;
+
+    struct ScanResult {
+        char ssid[33];
+        int8_t rssi;
+        bool secure;
+    };
+
+    ScanResult scanResults[SCAN_MAX_RESULTS];
+    uint8_t scanCount = 0;
+    bool scanning = false;
+    unsigned long scannedAt = 0;
 
     std::function<void(WebServer*)> apCallback;
     std::function<void(WebServer*)> apiCallback;
 
-    JsonObject &decodeJson(String jsonString);
+    bool rejectLargeBody(const String &body);
 
     void handleAPGet();
+    bool serveAsset(const char *path);
     void handleAPPost();
     void handleScanGet();
+    void startScan();
+    void serviceScan();
     void handleRESTGet();
     void handleRESTPut();
 
@@ -225,9 +262,10 @@ private:
     void startApi();
     void createBaseWebServer();
 
+    void migrateEEPROM();
     void readConfig();
     void writeConfig();
-    void storeMidiValues(String pitch, String velocity, bool resetMagic);
+    void storeMidiValues(const char *pitch, const char *velocity);
     boolean isIp(String str);
     String toStringIP(IPAddress ip);
 };
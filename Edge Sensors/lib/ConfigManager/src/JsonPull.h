@@ -0,0 +1,365 @@
+#ifndef __JSONPULL_H__
+#define __JSONPULL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define JSON_PULL_MAX_DEPTH 16
+
+enum JsonToken {
+    JSON_OBJECT_BEGIN,
+    JSON_OBJECT_END,
+    JSON_ARRAY_BEGIN,
+    JSON_ARRAY_END,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+    JSON_END,               // the document is complete
+    JSON_ERROR,             // malformed input, sticky
+    JSON_TOO_LONG,          // a string or number did not fit the arena, sticky
+};
+
+/**
+ * JSON Pull Parser
+ *
+ * Walks a JSON document one token per next() call without building a
+ * tree. Keys, strings (unescaped) and numbers are copied into the arena
+ * the caller provides and are valid until the next call, so a key has to
+ * be looked up before its value is pulled.
+ */
+class JsonPullParser {
+public:
+    JsonPullParser(const char *json, size_t length, char *arena, size_t arenaSize)
+        : json(json), length(length), pos(0), arena(arena), arenaSize(arenaSize), textLength(0),
+          depth(0), containers(0), state(EXPECT_VALUE), failed(JSON_END) {
+        arena[0] = '\0';
+    }
+
+    JsonToken next() {
+        if (failed != JSON_END) {
+            return failed;
+        }
+
+        skipWhitespace();
+        if (state == DONE) {
+            return pos == length ? JSON_END : fail(JSON_ERROR);
+        }
+        if (pos == length) {
+            return fail(JSON_ERROR);
+        }
+
+        char c = json[pos];
+
+        if (state == EXPECT_COMMA_OR_END) {
+            if (c == ',') {
+                pos++;
+                state = inObject() ? EXPECT_KEY : EXPECT_VALUE;
+                return next();
+            }
+            return closeContainer(c);
+        }
+
+        if (state == EXPECT_KEY || state == EXPECT_KEY_OR_END) {
+            if (c == '}' && state == EXPECT_KEY_OR_END) {
+                return closeContainer(c);
+            }
+            if (c != '"') {
+                return fail(JSON_ERROR);
+            }
+
+            JsonToken token = readString();
+            if (token != JSON_STRING) {
+                return token;
+            }
+            skipWhitespace();
+            if (pos == length || json[pos] != ':') {
+                return fail(JSON_ERROR);
+            }
+            pos++;
+            state = EXPECT_VALUE;
+            return JSON_KEY;
+        }
+
+        // EXPECT_VALUE or EXPECT_VALUE_OR_END
+        if (c == ']' && state == EXPECT_VALUE_OR_END) {
+            return closeContainer(c);
+        }
+        if (c == '{' || c == '[') {
+            if (depth == JSON_PULL_MAX_DEPTH) {
+                return fail(JSON_ERROR);
+            }
+            pos++;
+            if (c == '{') {
+                containers |= 1UL << depth;
+            } else {
+                containers &= ~(1UL << depth);
+            }
+            depth++;
+            state = c == '{' ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+            return c == '{' ? JSON_OBJECT_BEGIN : JSON_ARRAY_BEGIN;
+        }
+
+        JsonToken token;
+        if (c == '"') {
+            token = readString();
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            token = readNumber();
+        } else if (literal("true")) {
+            token = JSON_TRUE;
+        } else if (literal("false")) {
+            token = JSON_FALSE;
+        } else if (literal("null")) {
+            token = JSON_NULL;
+        } else {
+            return fail(JSON_ERROR);
+        }
+
+        if (token == JSON_ERROR || token == JSON_TOO_LONG) {
+            return token;
+        }
+        afterValue();
+        return token;
+    }
+
+    // Skips the value whose first token was just returned, nested objects
+    // and arrays included. Returns false if the document is broken.
+    bool skip(JsonToken first) {
+        if (first != JSON_OBJECT_BEGIN && first != JSON_ARRAY_BEGIN) {
+            return first != JSON_ERROR && first != JSON_TOO_LONG;
+        }
+
+        uint8_t level = depth - 1;
+        while (depth > level) {
+            JsonToken token = next();
+            if (token == JSON_ERROR || token == JSON_TOO_LONG || token == JSON_END) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char *text() const {
+        return arena;
+    }
+
+    size_t getTextLength() const {
+        return textLength;
+    }
+
+private:
+    enum State {
+        EXPECT_VALUE,
+        EXPECT_VALUE_OR_END,    // right after '['
+        EXPECT_KEY,
+        EXPECT_KEY_OR_END,      // right after '{'
+        EXPECT_COMMA_OR_END,
+        DONE,
+    };
+
+    const char *json;
+    size_t length;
+    size_t pos;
+
+    char *arena;
+    size_t arenaSize;
+    size_t textLength;
+
+    // -- Bit n of containers is set when the container at depth n is an
+    //    object rather than an array.
+    uint8_t depth;
+    uint32_t containers;
+    State state;
+    JsonToken failed;
+
+    JsonToken fail(JsonToken token) {
+        failed = token;
+        return token;
+    }
+
+    bool inObject() const {
+        return depth > 0 && (containers & (1UL << (depth - 1)));
+    }
+
+    void afterValue() {
+        state = depth == 0 ? DONE : EXPECT_COMMA_OR_END;
+    }
+
+    JsonToken closeContainer(char c) {
+        if (depth == 0 || c != (inObject() ? '}' : ']')) {
+            return fail(JSON_ERROR);
+        }
+        pos++;
+        depth--;
+        afterValue();
+        return c == '}' ? JSON_OBJECT_END : JSON_ARRAY_END;
+    }
+
+    void skipWhitespace() {
+        while (pos < length && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' || json[pos] == '\r')) {
+            pos++;
+        }
+    }
+
+    bool literal(const char *word) {
+        size_t n = strlen(word);
+        if (length - pos < n || memcmp(json + pos, word, n) != 0) {
+            return false;
+        }
+        pos += n;
+        return true;
+    }
+
+    bool append(char c) {
+        if (textLength + 1 >= arenaSize) {
+            return false;
+        }
+        arena[textLength++] = c;
+        arena[textLength] = '\0';
+        return true;
+    }
+
+    bool appendCodePoint(uint32_t cp) {
+        if (cp < 0x80) {
+            return append(cp);
+        }
+        if (cp < 0x800) {
+            return append(0xC0 | (cp >> 6)) && append(0x80 | (cp & 0x3F));
+        }
+        if (cp < 0x10000) {
+            return append(0xE0 | (cp >> 12)) && append(0x80 | ((cp >> 6) & 0x3F)) && append(0x80 | (cp & 0x3F));
+        }
+        return append(0xF0 | (cp >> 18)) && append(0x80 | ((cp >> 12) & 0x3F)) &&
+               append(0x80 | ((cp >> 6) & 0x3F)) && append(0x80 | (cp & 0x3F));
+    }
+
+    bool readHex4(uint32_t &value) {
+        if (length - pos < 4) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = json[pos++];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    JsonToken readString() {
+        pos++; // opening quote
+        textLength = 0;
+        arena[0] = '\0';
+
+        while (pos < length) {
+            char c = json[pos++];
+            if (c == '"') {
+                return JSON_STRING;
+            }
+            if ((uint8_t)c < 0x20) {
+                return fail(JSON_ERROR);
+            }
+            if (c != '\\') {
+                if (!append(c)) {
+                    return fail(JSON_TOO_LONG);
+                }
+                continue;
+            }
+
+            if (pos == length) {
+                break;
+            }
+            c = json[pos++];
+            char plain = 0;
+            switch (c) {
+                case '"': plain = '"'; break;
+                case '\\': plain = '\\'; break;
+                case '/': plain = '/'; break;
+                case 'b': plain = '\b'; break;
+                case 'f': plain = '\f'; break;
+                case 'n': plain = '\n'; break;
+                case 'r': plain = '\r'; break;
+                case 't': plain = '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!readHex4(cp)) {
+                        return fail(JSON_ERROR);
+                    }
+                    // A high surrogate followed by a low one is one code point.
+                    uint32_t low;
+                    if (cp >= 0xD800 && cp < 0xDC00 && length - pos >= 6 && json[pos] == '\\' && json[pos + 1] == 'u') {
+                        size_t mark = pos;
+                        pos += 2;
+                        if (readHex4(low) && low >= 0xDC00 && low < 0xE000) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        } else {
+                            pos = mark;
+                        }
+                    }
+                    if (!appendCodePoint(cp)) {
+                        return fail(JSON_TOO_LONG);
+                    }
+                    continue;
+                }
+                default:
+                    return fail(JSON_ERROR);
+            }
+            if (!append(plain)) {
+                return fail(JSON_TOO_LONG);
+            }
+        }
+
+        return fail(JSON_ERROR);
+    }
+
+    JsonToken readNumber() {
+        textLength = 0;
+        arena[0] = '\0';
+
+        size_t start = pos;
+        if (json[pos] == '-') {
+            pos++;
+        }
+        if (!digits()) {
+            return fail(JSON_ERROR);
+        }
+        if (pos < length && json[pos] == '.') {
+            pos++;
+            if (!digits()) {
+                return fail(JSON_ERROR);
+            }
+        }
+        if (pos < length && (json[pos] == 'e' || json[pos] == 'E')) {
+            pos++;
+            if (pos < length && (json[pos] == '+' || json[pos] == '-')) {
+                pos++;
+            }
+            if (!digits()) {
+                return fail(JSON_ERROR);
+            }
+        }
+
+        for (size_t i = start; i < pos; i++) {
+            if (!append(json[i])) {
+                return fail(JSON_TOO_LONG);
+            }
+        }
+        return JSON_NUMBER;
+    }
+
+    bool digits() {
+        size_t start = pos;
+        while (pos < length && json[pos] >= '0' && json[pos] <= '9') {
+            pos++;
+        }
+        return pos > start;
+    }
+};
+
+#endif /* __JSONPULL_H__ */
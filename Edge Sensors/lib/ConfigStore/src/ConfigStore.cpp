@@ -0,0 +1,326 @@
+#include "ConfigStore.h"
+
+#include <string.h>
+
+static const uint8_t sectorMagic[2] = {'C', 'S'};
+
+// CRC-16/CCITT-FALSE
+static uint16_t crc16(const uint8_t *data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+ConfigStore::ConfigStore() : partition(NULL), schema(0), sectorCount(0), head(0), headSequence(0), writeOffset(0) {
+    for (size_t i = 0; i < CONFIG_STORE_MAX_KEYS; i++) {
+        records[i] = NO_RECORD;
+    }
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool ConfigStore::begin(uint8_t schema, const char *label) {
+    this->schema = schema;
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!partition) {
+        return false;
+    }
+
+    sectorCount = partition->size / CONFIG_STORE_SECTOR_SIZE;
+    if (sectorCount > CONFIG_STORE_MAX_SECTORS) {
+        sectorCount = CONFIG_STORE_MAX_SECTORS;
+    }
+    if (sectorCount < 2) {
+        return false;
+    }
+
+    for (size_t i = 0; i < CONFIG_STORE_MAX_KEYS; i++) {
+        records[i] = NO_RECORD;
+    }
+
+    uint32_t sequences[CONFIG_STORE_MAX_SECTORS];
+    bool valid[CONFIG_STORE_MAX_SECTORS];
+    bool found = false;
+    for (uint8_t sector = 0; sector < sectorCount; sector++) {
+        valid[sector] = readHeader(sector, sequences[sector]);
+        if (valid[sector] && (!found || sequences[sector] > headSequence)) {
+            head = sector;
+            headSequence = sequences[sector];
+            found = true;
+        }
+    }
+
+    if (!found) {
+        head = 0;
+        headSequence = 1;
+        writeOffset = CONFIG_STORE_SECTOR_HEADER;
+        if (!erase(head) || !writeHeader(head, headSequence)) {
+            return false;
+        }
+    }
+
+    // Replay the sectors oldest first so newer records win.
+    for (;;) {
+        int oldest = -1;
+        for (uint8_t sector = 0; sector < sectorCount; sector++) {
+            if (valid[sector] && (oldest < 0 || sequences[sector] < sequences[oldest])) {
+                oldest = sector;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+
+        valid[oldest] = false;
+        uint32_t end = scanSector(oldest);
+        if (oldest == head) {
+            writeOffset = end;
+        }
+    }
+
+    // A power loss between starting a new sector and erasing the one after
+    // it leaves the spare dirty; finish the compaction now.
+    uint8_t spare = (head + 1) % sectorCount;
+    if (!isErased(spare)) {
+        return reclaim(spare);
+    }
+
+    return true;
+}
+
+bool ConfigStore::has(uint8_t key) const {
+    return key < CONFIG_STORE_MAX_KEYS && records[key] != NO_RECORD;
+}
+
+size_t ConfigStore::get(uint8_t key, void *buf, size_t size) const {
+    if (!has(key)) {
+        return 0;
+    }
+
+    uint8_t length;
+    if (esp_partition_read(partition, records[key], &length, 1) != ESP_OK) {
+        return 0;
+    }
+    if (esp_partition_read(partition, records[key] + 3, buf, length < size ? length : size) != ESP_OK) {
+        return 0;
+    }
+
+    return length;
+}
+
+bool ConfigStore::put(uint8_t key, const void *value, size_t length) {
+    if (!partition || key >= CONFIG_STORE_MAX_KEYS || length > CONFIG_STORE_MAX_VALUE) {
+        return false;
+    }
+
+    stats.writes++;
+    if (same(key, (const uint8_t *)value, length)) {
+        stats.unchanged++;
+        return true;
+    }
+
+    stats.bytesRequested += length;
+    if (writeOffset + CONFIG_STORE_RECORD_OVERHEAD + length > CONFIG_STORE_SECTOR_SIZE && !advance()) {
+        return false;
+    }
+
+    return append(key, (const uint8_t *)value, length);
+}
+
+size_t ConfigStore::getBlock(uint8_t firstKey, void *buf, size_t size) const {
+    uint8_t *out = (uint8_t *)buf;
+    size_t read = 0;
+
+    for (size_t offset = 0; offset < size; offset += CONFIG_STORE_MAX_VALUE) {
+        size_t chunk = size - offset < CONFIG_STORE_MAX_VALUE ? size - offset : CONFIG_STORE_MAX_VALUE;
+        size_t length = get(firstKey + offset / CONFIG_STORE_MAX_VALUE, out + offset, chunk);
+        read += length < chunk ? length : chunk;
+    }
+
+    return read;
+}
+
+bool ConfigStore::putBlock(uint8_t firstKey, const void *buf, size_t size) {
+    const uint8_t *in = (const uint8_t *)buf;
+    bool ok = true;
+
+    for (size_t offset = 0; offset < size; offset += CONFIG_STORE_MAX_VALUE) {
+        size_t chunk = size - offset < CONFIG_STORE_MAX_VALUE ? size - offset : CONFIG_STORE_MAX_VALUE;
+        ok = put(firstKey + offset / CONFIG_STORE_MAX_VALUE, in + offset, chunk) && ok;
+    }
+
+    return ok;
+}
+
+const ConfigStoreStats &ConfigStore::getStats() const {
+    return stats;
+}
+
+bool ConfigStore::readHeader(uint8_t sector, uint32_t &sequence) const {
+    uint8_t header[CONFIG_STORE_SECTOR_HEADER];
+    if (esp_partition_read(partition, sector * CONFIG_STORE_SECTOR_SIZE, header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+
+    if (memcmp(header + 4, sectorMagic, sizeof(sectorMagic)) != 0) {
+        return false;
+    }
+    if (crc16(header, 6) != (uint16_t)(header[6] | (header[7] << 8))) {
+        return false;
+    }
+
+    sequence = (uint32_t)header[0] | ((uint32_t)header[1] << 8) | ((uint32_t)header[2] << 16) | ((uint32_t)header[3] << 24);
+    return true;
+}
+
+bool ConfigStore::writeHeader(uint8_t sector, uint32_t sequence) {
+    uint8_t header[CONFIG_STORE_SECTOR_HEADER];
+    header[0] = (uint8_t)sequence;
+    header[1] = (uint8_t)(sequence >> 8);
+    header[2] = (uint8_t)(sequence >> 16);
+    header[3] = (uint8_t)(sequence >> 24);
+    memcpy(header + 4, sectorMagic, sizeof(sectorMagic));
+    uint16_t crc = crc16(header, 6);
+    header[6] = (uint8_t)crc;
+    header[7] = (uint8_t)(crc >> 8);
+
+    stats.bytesWritten += sizeof(header);
+    return esp_partition_write(partition, sector * CONFIG_STORE_SECTOR_SIZE, header, sizeof(header)) == ESP_OK;
+}
+
+// Indexes the records of one sector. Returns the offset within the sector
+// where the next record would go.
+uint32_t ConfigStore::scanSector(uint8_t sector) {
+    uint8_t record[CONFIG_STORE_MAX_VALUE + CONFIG_STORE_RECORD_OVERHEAD];
+    uint32_t base = sector * CONFIG_STORE_SECTOR_SIZE;
+    uint32_t offset = CONFIG_STORE_SECTOR_HEADER;
+
+    while (offset + CONFIG_STORE_RECORD_OVERHEAD <= CONFIG_STORE_SECTOR_SIZE) {
+        if (esp_partition_read(partition, base + offset, record, 3) != ESP_OK) {
+            return CONFIG_STORE_SECTOR_SIZE;
+        }
+
+        uint8_t length = record[0];
+        if (length == 0xFF) {
+            break;
+        }
+        size_t size = CONFIG_STORE_RECORD_OVERHEAD + length;
+        if (length > CONFIG_STORE_MAX_VALUE || offset + size > CONFIG_STORE_SECTOR_SIZE) {
+            // The length itself is damaged, nothing after it can be found.
+            stats.corruptRecords++;
+            return CONFIG_STORE_SECTOR_SIZE;
+        }
+
+        if (esp_partition_read(partition, base + offset + 3, record + 3, length + 2) != ESP_OK) {
+            return CONFIG_STORE_SECTOR_SIZE;
+        }
+
+        uint16_t crc = (uint16_t)(record[size - 2] | (record[size - 1] << 8));
+        if (crc16(record, size - 2) != crc) {
+            stats.corruptRecords++;
+        } else if (record[1] < CONFIG_STORE_MAX_KEYS && record[2] == schema) {
+            records[record[1]] = base + offset;
+        }
+
+        offset += size;
+    }
+
+    return offset;
+}
+
+bool ConfigStore::isErased(uint8_t sector) const {
+    uint8_t buf[256];
+    uint32_t base = sector * CONFIG_STORE_SECTOR_SIZE;
+
+    for (uint32_t offset = 0; offset < CONFIG_STORE_SECTOR_SIZE; offset += sizeof(buf)) {
+        if (esp_partition_read(partition, base + offset, buf, sizeof(buf)) != ESP_OK) {
+            return false;
+        }
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            if (buf[i] != 0xFF) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ConfigStore::erase(uint8_t sector) {
+    stats.sectorsErased++;
+    return esp_partition_erase_range(partition, sector * CONFIG_STORE_SECTOR_SIZE, CONFIG_STORE_SECTOR_SIZE) == ESP_OK;
+}
+
+// Copies the live records of sector into the head sector, then erases it.
+bool ConfigStore::reclaim(uint8_t sector) {
+    uint8_t value[CONFIG_STORE_MAX_VALUE];
+
+    for (uint8_t key = 0; key < CONFIG_STORE_MAX_KEYS; key++) {
+        if (records[key] == NO_RECORD || records[key] / CONFIG_STORE_SECTOR_SIZE != sector) {
+            continue;
+        }
+
+        size_t length = get(key, value, sizeof(value));
+        if (!append(key, value, length)) {
+            return false;
+        }
+    }
+
+    return erase(sector);
+}
+
+// Moves the head to the spare sector and compacts the oldest one, which
+// becomes the new spare. The live records of a whole sector always fit:
+// CONFIG_STORE_MAX_KEYS * (CONFIG_STORE_MAX_VALUE + overhead) < sector size.
+bool ConfigStore::advance() {
+    uint8_t next = (head + 1) % sectorCount;
+    if (!writeHeader(next, headSequence + 1)) {
+        return false;
+    }
+
+    head = next;
+    headSequence++;
+    writeOffset = CONFIG_STORE_SECTOR_HEADER;
+
+    return reclaim((head + 1) % sectorCount);
+}
+
+bool ConfigStore::append(uint8_t key, const uint8_t *value, size_t length) {
+    uint8_t record[CONFIG_STORE_MAX_VALUE + CONFIG_STORE_RECORD_OVERHEAD];
+    size_t size = CONFIG_STORE_RECORD_OVERHEAD + length;
+    if (writeOffset + size > CONFIG_STORE_SECTOR_SIZE) {
+        return false;
+    }
+
+    record[0] = (uint8_t)length;
+    record[1] = key;
+    record[2] = schema;
+    memcpy(record + 3, value, length);
+    uint16_t crc = crc16(record, length + 3);
+    record[length + 3] = (uint8_t)crc;
+    record[length + 4] = (uint8_t)(crc >> 8);
+
+    uint32_t offset = head * CONFIG_STORE_SECTOR_SIZE + writeOffset;
+    writeOffset += size;
+    stats.bytesWritten += size;
+    if (esp_partition_write(partition, offset, record, size) != ESP_OK) {
+        return false;
+    }
+
+    records[key] = offset;
+    return true;
+}
+
+bool ConfigStore::same(uint8_t key, const uint8_t *value, size_t length) const {
+    uint8_t stored[CONFIG_STORE_MAX_VALUE];
+    if (!has(key)) {
+        return false;
+    }
+
+    return get(key, stored, sizeof(stored)) == length && memcmp(stored, value, length) == 0;
+}
@@ -0,0 +1,100 @@
+#ifndef __CONFIGSTORE_H__
+#define __CONFIGSTORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+
+// -- Append-only record log in a raw flash partition. The partition is a
+//    ring of sectors; each starts with a header
+//
+//      0..3       4..5    6..7
+//      sequence   "CS"    CRC-16 of bytes 0..5
+//
+//    followed by records
+//
+//      0        1     2        3 .. 3+length-1   3+length..4+length
+//      length   key   schema   value             CRC-16 of bytes 0..2+length
+//
+//    A later record for a key replaces earlier ones. Erased flash (0xFF)
+//    ends a sector's records. One sector is always kept erased, so the
+//    oldest one can be compacted into the newest before it is reused.
+#define CONFIG_STORE_PARTITION "config"
+#define CONFIG_STORE_SECTOR_SIZE SPI_FLASH_SEC_SIZE
+#define CONFIG_STORE_MAX_SECTORS 16
+#define CONFIG_STORE_MAX_KEYS 32
+#define CONFIG_STORE_MAX_VALUE 64
+#define CONFIG_STORE_SECTOR_HEADER 8
+#define CONFIG_STORE_RECORD_OVERHEAD 5
+
+/**
+ * Config Store stats
+ */
+struct ConfigStoreStats {
+    uint32_t writes;            // put() calls
+    uint32_t unchanged;         // put() calls that matched the stored value
+    uint32_t bytesRequested;    // value bytes of the writes that hit flash
+    uint32_t bytesWritten;      // bytes programmed, headers and compaction included
+    uint32_t sectorsErased;
+    uint32_t corruptRecords;    // records with a bad CRC found at load
+};
+
+/**
+ * Config Store
+ *
+ * Small key/value store for settings. begin() scans the partition once
+ * and indexes the newest record of every key; put() appends a record only
+ * when the value differs from the stored one. Records written with
+ * another schema version are ignored, which is how a layout change resets
+ * the settings. A power loss at any point leaves either the old or the
+ * new value of the key being written.
+ */
+class ConfigStore {
+public:
+    ConfigStore();
+
+    bool begin(uint8_t schema, const char *label = CONFIG_STORE_PARTITION);
+
+    bool has(uint8_t key) const;
+
+    // Copies at most size bytes of the value into buf. Returns the stored
+    // length, 0 if the key has no value.
+    size_t get(uint8_t key, void *buf, size_t size) const;
+    bool put(uint8_t key, const void *value, size_t length);
+
+    // Stores a block longer than CONFIG_STORE_MAX_VALUE under consecutive
+    // keys starting at firstKey, one chunk per key, so that only the
+    // chunks that changed are written.
+    size_t getBlock(uint8_t firstKey, void *buf, size_t size) const;
+    bool putBlock(uint8_t firstKey, const void *buf, size_t size);
+
+    const ConfigStoreStats &getStats() const;
+
+private:
+    const esp_partition_t *partition;
+    uint8_t schema;
+    uint8_t sectorCount;
+    uint8_t head;
+    uint32_t headSequence;
+    uint32_t writeOffset;
+
+    // -- Partition offset of the newest record of every key, or NO_RECORD.
+    uint32_t records[CONFIG_STORE_MAX_KEYS];
+
+    ConfigStoreStats stats;
+
+    static const uint32_t NO_RECORD = 0xFFFFFFFF;
+
+    bool readHeader(uint8_t sector, uint32_t &sequence) const;
+    bool writeHeader(uint8_t sector, uint32_t sequence);
+    uint32_t scanSector(uint8_t sector);
+    bool isErased(uint8_t sector) const;
+    bool erase(uint8_t sector);
+    bool reclaim(uint8_t sector);
+    bool advance();
+    bool append(uint8_t key, const uint8_t *value, size_t length);
+    bool same(uint8_t key, const uint8_t *value, size_t length) const;
+};
+
+#endif /* __CONFIGSTORE_H__ */
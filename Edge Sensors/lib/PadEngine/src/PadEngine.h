@@ -0,0 +1,228 @@
+#ifndef __PADENGINE_H__
+#define __PADENGINE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <TouchOnset.h>
+
+// -- The ESP32 has ten capacitive touch channels. Pad state is kept in
+//    bitmasks, so the count is also bounded by the mask width.
+#define PAD_ENGINE_MAX_PADS 10
+
+typedef uint16_t PadMask;
+
+/**
+ * Pad Engine
+ *
+ * Runs the TouchOnset detector on several touch pins at once. Every pad
+ * is sampled once per scan, so the slope ring and the warm-up are shared,
+ * and the per-pad state is kept as parallel arrays: one pass of update()
+ * walks baseline, thresholds and hold-off side by side without touching
+ * anything else. Depth comparisons are done by multiplying the threshold
+ * with the baseline rather than dividing by it.
+ *
+ * Pads are added in setup(), adding one restarts the warm-up of all.
+ */
+class PadEngine {
+public:
+    PadEngine() : count(0) {
+        reset();
+    }
+
+    void reset() {
+        for (size_t slot = 0; slot < TOUCH_RING_SIZE; slot++) {
+            for (size_t i = 0; i < PAD_ENGINE_MAX_PADS; i++) {
+                ring[slot][i] = 0;
+            }
+        }
+        for (size_t i = 0; i < PAD_ENGINE_MAX_PADS; i++) {
+            baseline[i] = 0;
+            changedAt[i] = 0;
+        }
+        head = 0;
+        samples = 0;
+        sampling = false;
+        nextSampleAt = 0;
+        touched = 0;
+        pressed = 0;
+        released = 0;
+    }
+
+    // Returns the pad's index, or -1 when all pads are taken.
+    int addPad(uint8_t pin, uint8_t note, uint8_t velocity) {
+        if (count == PAD_ENGINE_MAX_PADS) {
+            return -1;
+        }
+
+        uint8_t i = count++;
+        pins[i] = pin;
+        notes[i] = note;
+        velocities[i] = velocity;
+        pressDepth[i] = TOUCH_PRESS_DEPTH;
+        releaseDepth[i] = TOUCH_RELEASE_DEPTH;
+        slopeDepth[i] = TOUCH_SLOPE_DEPTH;
+        holdoffUs[i] = TOUCH_HOLDOFF_US;
+        reset();
+
+        return i;
+    }
+
+    void setNote(uint8_t pad, uint8_t note, uint8_t velocity) {
+        notes[pad] = note;
+        velocities[pad] = velocity;
+    }
+
+    // Depths are fractions of the baseline in 1/256 units, as in TouchOnset.
+    void setThresholds(uint8_t pad, uint8_t press, uint8_t release, uint8_t slope) {
+        pressDepth[pad] = press;
+        releaseDepth[pad] = release;
+        slopeDepth[pad] = slope;
+    }
+
+    void setHoldoff(uint8_t pad, uint32_t us) {
+        holdoffUs[pad] = us;
+    }
+
+    // Reads every pad through read(pin), e.g. touchRead, then runs the
+    // detectors, once per TOUCH_SAMPLE_PERIOD_US however often it is
+    // called. A scan that comes more than a period late starts the ticks
+    // over rather than catching up with samples taken at the same time.
+    // Returns the pads whose state changed, 0 when no sample was due.
+    template<typename Read>
+    PadMask scan(Read read, unsigned long now) {
+        if (sampling && (long)(now - nextSampleAt) < 0) {
+            return 0;
+        }
+        bool late = !sampling || now - nextSampleAt >= TOUCH_SAMPLE_PERIOD_US;
+        nextSampleAt = (late ? now : nextSampleAt) + TOUCH_SAMPLE_PERIOD_US;
+        sampling = true;
+
+        uint16_t sample[PAD_ENGINE_MAX_PADS];
+        for (uint8_t i = 0; i < count; i++) {
+            sample[i] = read(pins[i]);
+        }
+
+        return update(sample, now);
+    }
+
+    // Feeds one sample per pad taken at time now (micros()), for callers
+    // that keep to TOUCH_SAMPLE_PERIOD_US themselves.
+    PadMask update(const uint16_t *sample, unsigned long now) {
+        pressed = 0;
+        released = 0;
+
+        uint16_t *oldest = ring[head];
+        head = (head + 1) & (TOUCH_RING_SIZE - 1);
+
+        if (samples < TOUCH_WARMUP_SAMPLES) {
+            for (uint8_t i = 0; i < count; i++) {
+                oldest[i] = sample[i];
+                baseline[i] += (uint32_t)sample[i] << TOUCH_BASELINE_SHIFT;
+            }
+            if (++samples == TOUCH_WARMUP_SAMPLES) {
+                for (uint8_t i = 0; i < count; i++) {
+                    baseline[i] /= TOUCH_WARMUP_SAMPLES;
+                }
+            }
+            return 0;
+        }
+
+        for (uint8_t i = 0; i < count; i++) {
+            uint32_t s = sample[i];
+            uint32_t old = oldest[i];
+            oldest[i] = s;
+
+            uint32_t base = baseline[i] >> TOUCH_BASELINE_SHIFT;
+            uint32_t scale = base + (base == 0);
+            uint32_t drop = s < base ? (base - s) << 8 : 0;
+            uint32_t fall = s < old ? (old - s) << 8 : 0;
+
+            PadMask bit = (PadMask)1 << i;
+            bool down = touched & bit;
+            if (!down) {
+                baseline[i] += (int32_t)s - (int32_t)base;
+            }
+
+            if (now - changedAt[i] < holdoffUs[i]) {
+                continue;
+            }
+
+            if (!down) {
+                bool deep = drop >= pressDepth[i] * scale;
+                bool fast = fall >= slopeDepth[i] * scale && drop >= (pressDepth[i] / 2) * scale;
+                if (deep || fast) {
+                    touched |= bit;
+                    pressed |= bit;
+                    changedAt[i] = now;
+                }
+            } else if (drop < releaseDepth[i] * scale) {
+                touched &= ~bit;
+                released |= bit;
+                changedAt[i] = now;
+            }
+        }
+
+        return pressed | released;
+    }
+
+    uint8_t size() const {
+        return count;
+    }
+
+    uint8_t getPin(uint8_t pad) const {
+        return pins[pad];
+    }
+
+    uint8_t getNote(uint8_t pad) const {
+        return notes[pad];
+    }
+
+    uint8_t getVelocity(uint8_t pad) const {
+        return velocities[pad];
+    }
+
+    uint16_t getBaseline(uint8_t pad) const {
+        return baseline[pad] >> TOUCH_BASELINE_SHIFT;
+    }
+
+    PadMask getTouched() const {
+        return touched;
+    }
+
+    PadMask getPressed() const {
+        return pressed;
+    }
+
+    PadMask getReleased() const {
+        return released;
+    }
+
+private:
+    uint8_t count;
+
+    // -- Slot major, so one scan writes a single contiguous row.
+    uint16_t ring[TOUCH_RING_SIZE][PAD_ENGINE_MAX_PADS];
+    size_t head;
+    uint16_t samples;
+    bool sampling;
+    unsigned long nextSampleAt;
+
+    // -- Per pad, indexed by pad. Baselines are fixed point, scaled by
+    //    2^TOUCH_BASELINE_SHIFT as in TouchOnset.
+    uint32_t baseline[PAD_ENGINE_MAX_PADS];
+    uint16_t pressDepth[PAD_ENGINE_MAX_PADS];
+    uint16_t releaseDepth[PAD_ENGINE_MAX_PADS];
+    uint16_t slopeDepth[PAD_ENGINE_MAX_PADS];
+    uint32_t holdoffUs[PAD_ENGINE_MAX_PADS];
+    unsigned long changedAt[PAD_ENGINE_MAX_PADS];
+    uint8_t pins[PAD_ENGINE_MAX_PADS];
+    uint8_t notes[PAD_ENGINE_MAX_PADS];
+    uint8_t velocities[PAD_ENGINE_MAX_PADS];
+
+    PadMask touched;
+    PadMask pressed;
+    PadMask released;
+};
+
+#endif /* __PADENGINE_H__ */
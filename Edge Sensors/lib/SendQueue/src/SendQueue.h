@@ -0,0 +1,225 @@
+#ifndef __SENDQUEUE_H__
+#define __SENDQUEUE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+
+#include <MidiFrame.h>
+
+#define SEND_QUEUE_CAPACITY 16
+#define SEND_QUEUE_FRAME_SIZE MIDI_FRAME_MAX_LENGTH
+#define SEND_QUEUE_TIMEOUT_MS 50
+#define SEND_QUEUE_RETRIES 3
+
+/**
+ * Pending Frame
+ */
+struct PendingFrame {
+    uint8_t data[SEND_QUEUE_FRAME_SIZE];
+    uint8_t length;
+    uint8_t attempts;
+    unsigned long sentAt;
+};
+
+/**
+ * Send Queue Stats
+ */
+struct SendQueueStats {
+    uint32_t sent;
+    uint32_t retries;
+    uint32_t dropped;
+    uint32_t overflows;
+    uint32_t mirrored;
+};
+
+/**
+ * Send Queue
+ *
+ * Fixed capacity FIFO of outbound frames. Only the head is ever on the
+ * air, so frames are delivered in the order they were queued. The owner
+ * reports the radio result through onSendComplete() and calls loop() to
+ * start the next frame and to expire frames whose ack never arrived.
+ *
+ * With a mirror set, every acked frame is handed to it once more before
+ * the next frame goes out, e.g. for a standby receiver. Its result only
+ * counts towards the stats: a mirror is never retried.
+ *
+ * The callbacks run in the middle of advancing the queue and must not
+ * push to it or clear() it.
+ */
+class SendQueue {
+public:
+    typedef std::function<bool(const uint8_t*, size_t)> Transmit;
+    typedef std::function<void(const PendingFrame&)> Dropped;
+    typedef std::function<bool(const PendingFrame&)> Failed;
+
+    SendQueue() {}
+
+    void onTransmit(Transmit transmit) {
+        this->transmit = transmit;
+    }
+
+    void onDropped(Dropped dropped) {
+        this->dropped = dropped;
+    }
+
+    // Called for every attempt that failed or timed out, before the frame
+    // is retried or dropped. Returning true, e.g. after switching to
+    // another receiver, gives the frame all its retries again.
+    void onFailed(Failed failed) {
+        this->failed = failed;
+    }
+
+    // mirror returns false when there is nowhere to send the copy to.
+    void onMirror(Transmit mirror) {
+        this->mirror = mirror;
+    }
+
+    bool push(const uint8_t *data, size_t length) {
+        if (length > SEND_QUEUE_FRAME_SIZE || count == SEND_QUEUE_CAPACITY) {
+            stats.overflows++;
+            return false;
+        }
+
+        PendingFrame &frame = frames[(head + count) % SEND_QUEUE_CAPACITY];
+        memcpy(frame.data, data, length);
+        frame.length = length;
+        frame.attempts = 0;
+        frame.sentAt = 0;
+        count++;
+
+        return true;
+    }
+
+    void onSendComplete(bool ok) {
+        if (!inFlight) {
+            return;
+        }
+
+        inFlight = false;
+        if (mirroring) {
+            mirroring = false;
+            stats.mirrored += ok;
+            pop();
+        } else if (ok) {
+            stats.sent++;
+            mirrorPending = (bool)mirror;
+            if (!mirrorPending) {
+                pop();
+            }
+        } else {
+            retryOrDrop();
+        }
+    }
+
+    void loop(unsigned long now) {
+        if (inFlight) {
+            if (now - frames[head].sentAt < SEND_QUEUE_TIMEOUT_MS) {
+                return;
+            }
+
+            inFlight = false;
+            if (mirroring) {
+                mirroring = false;
+                pop();
+            } else {
+                retryOrDrop();
+            }
+        }
+
+        if (mirrorPending) {
+            mirrorPending = false;
+            PendingFrame &frame = frames[head];
+            frame.sentAt = now;
+            if (mirror(frame.data, frame.length)) {
+                inFlight = true;
+                mirroring = true;
+                return;
+            }
+            pop();
+        }
+
+        if (count == 0 || !transmit) {
+            return;
+        }
+
+        PendingFrame &frame = frames[head];
+        frame.attempts++;
+        frame.sentAt = now;
+        inFlight = true;
+
+        if (!transmit(frame.data, frame.length)) {
+            inFlight = false;
+            retryOrDrop();
+        }
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+        inFlight = false;
+        mirroring = false;
+        mirrorPending = false;
+    }
+
+    bool isBusy() {
+        return inFlight;
+    }
+
+    // Whether the send on the air is a mirror rather than the frame itself.
+    bool isMirroring() {
+        return mirroring;
+    }
+
+    size_t size() {
+        return count;
+    }
+
+    const SendQueueStats &getStats() {
+        return stats;
+    }
+
+private:
+    PendingFrame frames[SEND_QUEUE_CAPACITY];
+    size_t head = 0;
+    size_t count = 0;
+    bool inFlight = false;
+    bool mirroring = false;
+    bool mirrorPending = false;
+
+    Transmit transmit;
+    Transmit mirror;
+    Dropped dropped;
+    Failed failed;
+    SendQueueStats stats = {};
+
+    void retryOrDrop() {
+        if (failed && failed(frames[head])) {
+            frames[head].attempts = 0;
+        }
+
+        if (frames[head].attempts <= SEND_QUEUE_RETRIES) {
+            stats.retries++;
+            return;
+        }
+
+        stats.dropped++;
+        if (dropped) {
+            dropped(frames[head]);
+        }
+        pop();
+    }
+
+    void pop() {
+        if (count == 0) {
+            return;
+        }
+        head = (head + 1) % SEND_QUEUE_CAPACITY;
+        count--;
+    }
+};
+
+#endif /* __SENDQUEUE_H__ */
@@ -0,0 +1,135 @@
+#ifndef __TOUCHONSET_H__
+#define __TOUCHONSET_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// -- Raw touchRead() values fall when the pad is touched. Thresholds are
+//    fractions of the tracked baseline in 1/256 units, so they follow the
+//    pad as it drifts with humidity and cabling.
+#define TOUCH_RING_SIZE 4                // samples used for the slope, power of two
+#define TOUCH_WARMUP_SAMPLES 16          // samples averaged into the first baseline
+#define TOUCH_BASELINE_SHIFT 6           // IIR weight of a new sample: 1/64
+#define TOUCH_PRESS_DEPTH 51             // 20% below baseline: touched
+#define TOUCH_RELEASE_DEPTH 26           // 10% below baseline: released again
+#define TOUCH_SLOPE_DEPTH 38             // 15% drop across the ring: fast onset
+#define TOUCH_HOLDOFF_US 3000            // minimum time between state changes
+
+// -- The ring and the baseline weight count samples, so the detectors
+//    expect one every TOUCH_SAMPLE_PERIOD_US: the slope is taken over 4 ms
+//    and the baseline follows with a time constant of 64 ms. PadEngine
+//    keeps to it however fast loop() runs.
+#ifndef TOUCH_SAMPLE_PERIOD_US
+#define TOUCH_SAMPLE_PERIOD_US 1000
+#endif
+
+/**
+ * Touch Onset detector
+ *
+ * Streaming detector over raw touch samples. A press fires as soon as the
+ * reading is TOUCH_PRESS_DEPTH below baseline, or earlier when it falls by
+ * TOUCH_SLOPE_DEPTH within the last TOUCH_RING_SIZE samples and is already
+ * halfway there. It releases below TOUCH_RELEASE_DEPTH (hysteresis). The
+ * baseline is only tracked while the pad is released. Feed it one sample
+ * per TOUCH_SAMPLE_PERIOD_US.
+ */
+class TouchOnset {
+public:
+    TouchOnset() {
+        reset();
+    }
+
+    void reset() {
+        for (size_t i = 0; i < TOUCH_RING_SIZE; i++) {
+            ring[i] = 0;
+        }
+        head = 0;
+        samples = 0;
+        baseline = 0;
+        touched = false;
+        pressed = false;
+        released = false;
+        changedAt = 0;
+    }
+
+    // Feeds one sample taken at time now (micros()). Returns true when the
+    // touch state changed, see wasPressed()/wasReleased().
+    bool update(uint16_t sample, unsigned long now) {
+        pressed = false;
+        released = false;
+
+        uint16_t oldest = ring[head];
+        ring[head] = sample;
+        head = (head + 1) & (TOUCH_RING_SIZE - 1);
+
+        if (samples < TOUCH_WARMUP_SAMPLES) {
+            baseline += (uint32_t)sample << TOUCH_BASELINE_SHIFT;
+            if (++samples == TOUCH_WARMUP_SAMPLES) {
+                baseline /= TOUCH_WARMUP_SAMPLES;
+            }
+            return false;
+        }
+
+        uint32_t base = baseline >> TOUCH_BASELINE_SHIFT;
+        uint32_t depth = sample < base ? ((base - sample) << 8) / (base ? base : 1) : 0;
+        uint32_t slope = sample < oldest ? ((uint32_t)(oldest - sample) << 8) / (base ? base : 1) : 0;
+
+        if (!touched) {
+            baseline += (int32_t)sample - (int32_t)base;
+        }
+
+        if (now - changedAt < TOUCH_HOLDOFF_US) {
+            return false;
+        }
+
+        if (!touched) {
+            bool deep = depth >= TOUCH_PRESS_DEPTH;
+            bool fast = slope >= TOUCH_SLOPE_DEPTH && depth >= TOUCH_PRESS_DEPTH / 2;
+            if (deep || fast) {
+                touched = true;
+                pressed = true;
+                changedAt = now;
+                return true;
+            }
+        } else if (depth < TOUCH_RELEASE_DEPTH) {
+            touched = false;
+            released = true;
+            changedAt = now;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool isPressed() {
+        return touched;
+    }
+
+    bool wasPressed() {
+        return pressed;
+    }
+
+    bool wasReleased() {
+        return released;
+    }
+
+    uint16_t getBaseline() {
+        return baseline >> TOUCH_BASELINE_SHIFT;
+    }
+
+private:
+    uint16_t ring[TOUCH_RING_SIZE];
+    size_t head;
+    uint16_t samples;
+
+    // -- Baseline in fixed point, scaled by 2^TOUCH_BASELINE_SHIFT so the
+    //    IIR update is a shift and an add.
+    uint32_t baseline;
+
+    bool touched;
+    bool pressed;
+    bool released;
+    unsigned long changedAt;
+};
+
+#endif /* __TOUCHONSET_H__ */
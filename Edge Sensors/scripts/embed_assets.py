@@ -0,0 +1,93 @@
+# Gzips every file in data/ and writes them to include/EmbeddedAssets.h as
+# constant arrays with a content hash for the ETag, so the config portal
+# is served from flash instead of SPIFFS.
+#
+# Runs before each build through `extra_scripts` in platformio.ini, or by
+# hand with `python scripts/embed_assets.py`.
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")
+    PROJECT_DIR = env.subst("$PROJECT_DIR")
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+DATA_DIR = os.path.join(PROJECT_DIR, "data")
+OUTPUT = os.path.join(PROJECT_DIR, "include", "EmbeddedAssets.h")
+
+MIME_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+
+def symbol(path):
+    return "asset_" + "".join(c if c.isalnum() else "_" for c in path.strip("/"))
+
+
+def render(assets):
+    lines = [
+        "// Generated by scripts/embed_assets.py from data/, do not edit.",
+        "#ifndef __EMBEDDEDASSETS_H__",
+        "#define __EMBEDDEDASSETS_H__",
+        "",
+        "#include <ConfigManager.h>",
+        "",
+    ]
+
+    for path, mime, body, etag in assets:
+        lines.append("// %s, %d bytes gzipped" % (path, len(body)))
+        lines.append("static const uint8_t %s[] PROGMEM = {" % symbol(path))
+        for i in range(0, len(body), 16):
+            lines.append("    " + ", ".join("0x%02x" % b for b in body[i:i + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+
+    lines.append("static const EmbeddedAsset embeddedAssets[] = {")
+    for path, mime, body, etag in assets:
+        lines.append('    {"%s", "%s", %s, sizeof(%s), "\\"%s\\""},' % (path, mime, symbol(path), symbol(path), etag))
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif /* __EMBEDDEDASSETS_H__ */")
+    lines.append("")
+
+    return "\n".join(lines)
+
+
+def embed():
+    assets = []
+    for root, _, files in os.walk(DATA_DIR):
+        for name in sorted(files):
+            ext = os.path.splitext(name)[1].lower()
+            if ext not in MIME_TYPES:
+                continue
+
+            with open(os.path.join(root, name), "rb") as f:
+                content = f.read()
+
+            path = "/" + os.path.relpath(os.path.join(root, name), DATA_DIR).replace(os.sep, "/")
+            body = gzip.compress(content, 9, mtime=0)
+            etag = hashlib.sha1(content).hexdigest()[:16]
+            assets.append((path, MIME_TYPES[ext], body, etag))
+
+    header = render(sorted(assets))
+
+    # Only touch the header when it changed, so it does not force a rebuild.
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            if f.read() == header:
+                return
+    with open(OUTPUT, "w") as f:
+        f.write(header)
+    print("Embedded %d assets from data/ into include/EmbeddedAssets.h" % len(assets))
+
+
+embed()
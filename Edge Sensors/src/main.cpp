@@ -2,45 +2,181 @@
 #include <esp_now.h>
 #include <WifiEspNow.h>
 #include <WiFi.h>
-#include <EasyButtonTouch.h>
+#include <EasyButton.h>
+#include <MidiFrame.h>
+#include <SendQueue.h>
+#include <PadEngine.h>
+#include <SpscRing.h>
+#include <Discovery.h>
+#include <ClockSync.h>
+#include <EmbeddedAssets.h>
 
 #define CHANNEL 1
 #define SETUP_PIN 19
-#define TOUCH_PIN 27
 
-EasyButtonTouch touchPad(TOUCH_PIN, 35, 50);
+// -- Pads are wired to the first PAD_COUNT touch pins of PAD_PINS; pad 0
+//    is the pin single-pad boards have always used. Unconnected touch
+//    pins read as touched now and then, so only wired pads are scanned.
+#ifndef PAD_COUNT
+#define PAD_COUNT 1
+#endif
+#define PAD_PINS {27, 4, 14, 13, 33, 32, 15, 12, 2, 0}
+
+// -- The receiver stored at the last pairing is used right away at boot.
+//    Only after RECEIVER_LOST_DROPS frames in a row went unacked is it
+//    forgotten and discovered again, backing off exponentially between
+//    sweeps over the DISCOVERY_CHANNELS channels.
+#define RECEIVER_LOST_DROPS 3
+#define DISCOVERY_CHANNELS 13
+#define DISCOVERY_WINDOW_MS 20
+#define DISCOVERY_BACKOFF_MIN_MS 250
+#define DISCOVERY_BACKOFF_MAX_MS 30000
+#define ANNOUNCE_QUEUE_SIZE 8
+
+// -- The second receiver heard on the same channel becomes the standby.
+//    Every frame the primary acked is copied to it, so it follows the
+//    notes and can take over the moment FAILOVER_FAILED_SENDS sends in a
+//    row to the primary went unacked. 4 is the most that still fails over
+//    within the retries of one frame, in about 40 ms; with more the switch
+//    waits for the next frame, often the next heartbeat. Collision bursts
+//    on a busy channel still cause the odd needless failover (tools/netsim
+//    -n 8 -r 2 -c 1, about one per run), which is harmless: the old
+//    primary stays on as the standby and keeps every note. A standby is
+//    dropped after STANDBY_LOST_MIRRORS copies in a row went unacked, so a
+//    dead one is not failed back to; fewer than 5 lets the same bursts
+//    drop live standbys.
+#define FAILOVER_FAILED_SENDS 4
+#define STANDBY_LOST_MIRRORS 5
+
+#define PING_QUEUE_SIZE 4
+
+// -- Events raised within this window share one ESP-NOW frame.
+#ifndef BATCH_WINDOW_US
+#define BATCH_WINDOW_US 1500
+#endif
+
+// -- The notes held right now go out every HEARTBEAT_MS, so the receiver
+//    can release a note whose note-off frame was dropped.
+#ifndef HEARTBEAT_MS
+#define HEARTBEAT_MS 1000
+#endif
+
+// -- The send queue counters are logged every SEND_STATS_MS if they moved.
+#define SEND_STATS_MS 10000
+
+// -- DebugLog() records are printed by a task at the lowest priority on
+//    core 0, away from loop() on core 1, which looks at the ring again
+//    LOG_IDLE_MS after finding it empty. With LOG_BINARY the records go
+//    out as they are for tools/hllog to decode, else as text.
+#define LOG_TASK_STACK 3072
+#define LOG_TASK_CORE 0
+#define LOG_IDLE_MS 10
+#ifndef LOG_BINARY
+#define LOG_BINARY 0
+#endif
+
+PadEngine pads;
 EasyButton apSetupButton(SETUP_PIN);
 
 bool inAPMode = false;
 esp_now_peer_info_t slave;
-
+esp_now_peer_info_t standby;
+bool slaveKnown = false;
+bool standbyKnown = false;
+bool announcedReady = false;
+uint8_t droppedInARow = 0;
+bool receiverLost = false;
+uint8_t failedInARow = 0;
+bool failedOver = false;
+uint8_t mirrorFailedInARow = 0;
+unsigned long failingSince = 0;
+
+struct ReceivedAnnounce {
+  uint8_t mac[6];
+  DiscoveryAnnounce announce;
+};
+
+struct ReceivedPing {
+  uint32_t t1;
+  uint32_t t2;
+};
+
+// -- Announces travel from the WiFi task's receive callback to loop().
+SpscRing<ReceivedAnnounce, ANNOUNCE_QUEUE_SIZE> announceQueue;
+
+// -- Clock pings from our receiver, stamped with micros() on arrival and
+//    answered from loop().
+SpscRing<ReceivedPing, PING_QUEUE_SIZE> pingQueue;
+
+bool discovering = false;
+uint8_t sweepStep = 0;
+uint32_t helloNonce = 0;
+unsigned long helloSentAt = 0;
+ReceivedAnnounce best;
+ReceivedAnnounce second;
+unsigned long nextDiscoveryAt = 0;
+unsigned long discoveryBackoff = DISCOVERY_BACKOFF_MIN_MS;
+
+// -- Per pad note map, comma separated lists indexed by pad. Pads without
+//    an entry play the portal's pitch plus their index, at its velocity.
 struct Config {
+  char notes[48];
+  char velocities[48];
 } config;
 
+constexpr ConfigField configFields[] = {
+  CONFIG_FIELD("notes", Config, notes, both),
+  CONFIG_FIELD("velocities", Config, velocities, both),
+};
+
 struct Metadata {
     int8_t version;
 } meta;
 
 ConfigManager configManager;
+SendQueue sendQueue;
+MidiBatch midiBatch;
 
-// -- Midi message will have the following format
-//     pitchInt velocityInt statusInt ie. 100 50 0
-char midiMessageBuffer[12];
+uint16_t midiSequence = 0;
+unsigned long heartbeatAt = 0;
+unsigned long sendStatsAt = 0;
+SendQueueStats reportedStats = {};
 
 void InitESPNow();
-void ScanForSlave();
+void discoverSlave();
+void sendHello();
+void receiveMessage(const uint8_t mac[6], const uint8_t* buf, size_t count, void* cbarg);
 bool manageSlave();
-void sendData();
-void initMidiMessage();
+void useSlave(const uint8_t mac[6], uint8_t channel);
+void useStandby(const uint8_t mac[6]);
+void forgetSlave();
+void failOver();
+void mirrorSent(bool ok);
+void backOff();
+void sendData(const MidiEvent &event);
+void flushBatch();
+void sendHeartbeat();
+void answerPings();
+void sendMidi(uint8_t status, uint8_t pad);
+bool transmitFrame(const uint8_t *frame, size_t len);
+bool mirrorFrame(const uint8_t *frame, size_t len);
+bool sendFailed(const PendingFrame &frame);
+void frameDropped(const PendingFrame &frame);
+void serviceSendQueue();
+void logSendStats();
+void initPads();
+uint8_t listEntry(const char *list, uint8_t index, uint8_t fallback);
 void setupButtonCallback();
-void midiOnHelper();
-void midiOffHelper();
+void midiOnHelper(uint8_t pad);
+void midiOffHelper(uint8_t pad);
+void logTask(void *parameters);
+void writeLogRecord(const LogRecord &record);
 
 
 void InitESPNow() {
   WiFi.persistent(false);
   WiFi.mode(WIFI_AP);
-  WiFi.softAP("ESPNOW", nullptr, 3);
+  WiFi.softAP("ESPNOW", nullptr, slaveKnown ? slave.channel : CHANNEL);
   WiFi.softAPdisconnect(false);
 
   Serial.print("MAC address of this node is ");
@@ -52,94 +188,227 @@ void InitESPNow() {
     ESP.restart();
   }
 
+  // Hellos are broadcast, the receivers answer the same way.
+  WifiEspNow.addPeer(DISCOVERY_BROADCAST);
+  WifiEspNow.onReceive(receiveMessage, nullptr);
 
-  ok = WifiEspNow.addPeer(slave.peer_addr);
-  if (!ok) {
-    Serial.println("WifiEspNow.addPeer() failed");
-    ESP.restart();
+  if (slaveKnown) {
+    ok = WifiEspNow.addPeer(slave.peer_addr, slave.channel);
+    if (!ok) {
+      Serial.println("WifiEspNow.addPeer() failed");
+      ESP.restart();
+    }
   }
 }
 
-void initMidiMessage() {
+// Pitch and velocity are stored as strings by the config portal, they
+// are parsed once at boot together with the note map.
+void initPads() {
     char pitch[MIDI_LENGTH];
     char velocity[MIDI_LENGTH];
+    const uint8_t pins[] = PAD_PINS;
 
     DebugPrintln(F("Reading saved configuration"));
 
-    EEPROM.get(MAGIC_LENGTH, pitch);
-    EEPROM.get(MAGIC_LENGTH + MIDI_LENGTH, velocity);
-    int len = snprintf(midiMessageBuffer, sizeof(midiMessageBuffer), "%s %s", pitch, velocity);
-}
-// Scan for slaves in AP mode
-void ScanForSlave() {
-  int8_t scanResults = WiFi.scanNetworks();
-  // reset on each scan
-  bool slaveFound = 0;
-  memset(&slave, 0, sizeof(slave));
+    configManager.getMidiValues(pitch, velocity);
 
-  Serial.println("");
-  if (scanResults == 0) {
-    Serial.println("No WiFi devices in AP Mode found");
-  } else {
-    Serial.print("Found "); Serial.print(scanResults); Serial.println(" devices ");
-    for (int i = 0; i < scanResults; ++i) {
-      // Print SSID and RSSI for each device found
-      String SSID = WiFi.SSID(i);
-      int32_t RSSI = WiFi.RSSI(i);
-      String BSSIDstr = WiFi.BSSIDstr(i);
-      delay(10);
-      // Check if the current device starts with `Slave`
-      if (SSID.indexOf("Slave") == 0) {
-        // SSID of interest
-        Serial.println("Found a Slave.");
-        Serial.print(i + 1); Serial.print(": "); Serial.print(SSID); Serial.print(" ["); Serial.print(BSSIDstr); Serial.print("]"); Serial.print(" ("); Serial.print(RSSI); Serial.print(")"); Serial.println("");
-        // Get BSSID => Mac Address of the Slave
-        int mac[6];
-        if ( 6 == sscanf(BSSIDstr.c_str(), "%x:%x:%x:%x:%x:%x",  &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5] ) ) {
-          for (int ii = 0; ii < 6; ++ii ) {
-            slave.peer_addr[ii] = (uint8_t) mac[ii];
-          }
-        }
+    uint8_t midiPitch = constrain(atoi(pitch), 0, 127);
+    uint8_t midiVelocity = constrain(atoi(velocity), 0, 127);
 
-        slave.channel = CHANNEL; // pick a channel
-        slave.encrypt = 0; // no encryption
+    for (uint8_t i = 0; i < PAD_COUNT && i < sizeof(pins); ++i) {
+      uint8_t note = listEntry(config.notes, i, constrain(midiPitch + i, 0, 127));
+      uint8_t velocity = listEntry(config.velocities, i, midiVelocity);
+      pads.addPad(pins[i], note, velocity);
+    }
+}
 
-        slaveFound = 1;
-        // we are planning to have only one slave in this example;
-        // Hence, break after we find one, to be a bit efficient
-        break;
+// Returns the index-th number of a comma separated list, or fallback if
+// the list is shorter.
+uint8_t listEntry(const char *list, uint8_t index, uint8_t fallback) {
+    for (uint8_t i = 0; i < index; ++i) {
+      list = strchr(list, ',');
+      if (!list) {
+        return fallback;
       }
+      list++;
     }
+
+    char *end;
+    long value = strtol(list, &end, 10);
+    return end == list ? fallback : constrain(value, 0, 127);
+}
+// Sweeps the channels for a receiver, starting with the default one. On
+// each channel a hello is broadcast and announces are collected for
+// DISCOVERY_WINDOW_MS; the receiver with the most free slots wins.
+void discoverSlave() {
+  unsigned long now = millis();
+  if (!discovering) {
+    if ((long)(now - nextDiscoveryAt) >= 0) {
+      discovering = true;
+      sweepStep = 0;
+      sendHello();
+    }
+    return;
   }
 
-  if (slaveFound) {
-    Serial.println("Slave Found, processing..");
-  } else {
-    Serial.println("Slave Not Found, trying again.");
+  ReceivedAnnounce received;
+  while (announceQueue.pop(received)) {
+    const DiscoveryAnnounce &announce = received.announce;
+    if (announce.nonce != helloNonce || memcmp(received.mac, best.mac, 6) == 0) {
+      continue;
+    }
+    if (announce.capacity > best.announce.capacity) {
+      second = best;
+      best = received;
+    } else if (announce.capacity > second.announce.capacity) {
+      second = received;
+    }
+  }
+
+  if (now - helloSentAt < DISCOVERY_WINDOW_MS) {
+    return;
   }
 
-  // clean up ram
-  WiFi.scanDelete();
+  if (best.announce.capacity > 0) {
+    const uint8_t *mac = best.mac;
+    Serial.printf("Found %s [%02X:%02X:%02X:%02X:%02X:%02X] on channel %u, %u slots free.\n",
+                  best.announce.name, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
+                  best.announce.channel, best.announce.capacity);
+    discovering = false;
+    useSlave(best.mac, best.announce.channel);
+    if (second.announce.capacity > 0) {
+      mac = second.mac;
+      Serial.printf("Standby %s [%02X:%02X:%02X:%02X:%02X:%02X].\n",
+                    second.announce.name, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+      useStandby(second.mac);
+    }
+    configManager.setReceiver(best.mac, best.announce.channel, standbyKnown ? standby.peer_addr : NULL);
+    return;
+  }
+
+  if (++sweepStep < DISCOVERY_CHANNELS) {
+    sendHello();
+    return;
+  }
+
+  discovering = false;
+  DebugLog(LOG_SLAVE_NOT_FOUND, discoveryBackoff);
+  backOff();
+}
+
+// Moves to the next channel of the sweep and broadcasts a hello there.
+void sendHello() {
+  uint8_t channel = (CHANNEL - 1 + sweepStep) % DISCOVERY_CHANNELS + 1;
+  WiFi.softAP("ESPNOW", nullptr, channel);
+
+  memset(&best, 0, sizeof(best));
+  memset(&second, 0, sizeof(second));
+  helloNonce = esp_random();
+  helloSentAt = millis();
+
+  uint8_t buf[DISCOVERY_HELLO_LENGTH];
+  size_t length = Discovery::encodeHello(helloNonce, buf);
+  WifiEspNow.send(DISCOVERY_BROADCAST, buf, length);
+}
+
+// Delays the next sweep. The delay doubles on every miss and only drops
+// back once a receiver acked a frame, so a receiver that answers hellos
+// but not frames is not rediscovered in a tight loop either.
+void backOff() {
+  nextDiscoveryAt = millis() + discoveryBackoff;
+  discoveryBackoff = discoveryBackoff * 2 < DISCOVERY_BACKOFF_MAX_MS ? discoveryBackoff * 2 : DISCOVERY_BACKOFF_MAX_MS;
+}
+
+// Points ESP-NOW at a receiver. The soft-AP follows its channel, since
+// ESP-NOW only reaches peers on the home channel.
+void useSlave(const uint8_t mac[6], uint8_t channel) {
+  memset(&slave, 0, sizeof(slave));
+  memcpy(slave.peer_addr, mac, 6);
+  slave.channel = channel;
+  slave.encrypt = 0; // no encryption
+
+  WiFi.softAP("ESPNOW", nullptr, channel);
+  slaveKnown = true;
+  standbyKnown = false;
+  droppedInARow = 0;
+  failedInARow = 0;
+  failedOver = false;
+}
+
+// Standbys share the primary's channel, the only one ESP-NOW reaches.
+void useStandby(const uint8_t mac[6]) {
+  memset(&standby, 0, sizeof(standby));
+  memcpy(standby.peer_addr, mac, 6);
+  standby.channel = slave.channel;
+  standby.encrypt = 0;
+  standbyKnown = true;
+  mirrorFailedInARow = 0;
+}
+
+// Neither receiver acks any more: drop both and go back to discovery.
+void forgetSlave() {
+  DebugLog(LOG_SLAVE_LOST);
+  WifiEspNow.removePeer(slave.peer_addr);
+  if (standbyKnown) {
+    WifiEspNow.removePeer(standby.peer_addr);
+  }
+  sendQueue.clear();
+  slaveKnown = false;
+  standbyKnown = false;
+  backOff();
+}
+
+// The standby has every note the primary had, so it takes over as it is;
+// the primary becomes the standby in case it comes back. The send queue
+// is kept and its head gets all its retries again on the new primary. Only
+// one failover is made until a frame is acked again: with both receivers
+// gone the frames are dropped and the receivers forgotten. The swap is not
+// stored, a dead primary costs a failover on the next boot again.
+void failOver() {
+  esp_now_peer_info_t failed = slave;
+  slave = standby;
+  standby = failed;
+  failedInARow = 0;
+  failedOver = true;
+  mirrorFailedInARow = 0;
+  DebugLog(LOG_FAILOVER, millis() - failingSince);
+}
+
+// A standby that stopped acking, most often the primary we just failed
+// over from, is dropped instead of holding up every frame with a copy
+// that goes nowhere. The next discovery picks a new one.
+void mirrorSent(bool ok) {
+  if (ok) {
+    mirrorFailedInARow = 0;
+  } else if (standbyKnown && ++mirrorFailedInARow >= STANDBY_LOST_MIRRORS) {
+    DebugLog(LOG_STANDBY_LOST, mirrorFailedInARow);
+    WifiEspNow.removePeer(standby.peer_addr);
+    standbyKnown = false;
+  }
 }
 
 
 // Check if the slave is already paired with the master.
 // If not, pair the slave with master
 bool manageSlave() {
-  if (slave.channel == CHANNEL) {
+  if (slaveKnown) {
 
     // check if the peer exists
     bool exists = WifiEspNow.hasPeer(slave.peer_addr);
     if ( exists) {
       // Slave already paired.
+      if (standbyKnown && !WifiEspNow.hasPeer(standby.peer_addr)) {
+        WifiEspNow.addPeer(standby.peer_addr, standby.channel);
+      }
       return true;
     } else {
       // Slave not paired, attempt pair
       bool ok;
-      ok = WifiEspNow.addPeer(slave.peer_addr);
+      ok = WifiEspNow.addPeer(slave.peer_addr, slave.channel);
         if (!ok) {
             Serial.println("Slave Status: WifiEspNow.addPeer() failed");
         }
+        return ok;
     }
   } else {
     // No slave found to process
@@ -148,80 +417,275 @@ bool manageSlave() {
   }
 }
 
-void sendData(char* message) {
-    unsigned int timeout_ms = 5000;
-    char msg[60];
+void sendData(const MidiEvent &event) {
+    midiBatch.add(event, micros());
+
+    if (midiBatch.isFull()) {
+      flushBatch();
+    }
+}
+
+void flushBatch() {
+    uint8_t frame[MIDI_FRAME_MAX_LENGTH];
 
-    int len = snprintf(msg, sizeof(msg), "%s", message);
+    size_t len = midiBatch.encode(frame);
 
-    if (WifiEspNow.hasPeer(slave.peer_addr)) {
-      WifiEspNow.send(slave.peer_addr, reinterpret_cast<const uint8_t*>(msg), len);
+    if (!sendQueue.push(frame, len)) {
+      DebugLog(LOG_SEND_QUEUE_FULL);
     }
-    Serial.print("Sending: "); Serial.println(msg);
+}
 
-    WifiEspNowSendStatus status;
-    unsigned long starttime = millis();
-    do {
-        status = WifiEspNow.getSendStatus();
-        yield();
-    } while ((status == WifiEspNowSendStatus::NONE) && ((millis() - starttime) < timeout_ms));
+// Queued behind the events before it, so the receiver sees them first.
+void sendHeartbeat() {
+    MidiNoteSet held;
+    held.clear();
+    for (uint8_t i = 0; i < pads.size(); ++i) {
+      if (pads.getTouched() & (1 << i)) {
+        held.set(pads.getNote(i));
+      }
+    }
 
-    if (status == WifiEspNowSendStatus::OK) {
-      Serial.println("Message Sent succesfully");
-    } else {
-      Serial.println("Message wasn't received.");
+    if (!midiBatch.isEmpty()) {
+      flushBatch();
     }
 
+    uint8_t frame[MIDI_HEARTBEAT_LENGTH];
+    size_t len = MidiHeartbeat::encode(midiSequence, held, frame);
+    sendQueue.push(frame, len);
+    heartbeatAt = millis();
+}
+
+// Ping replies wait in the send queue like any frame; they carry the
+// time they finally go out, so the wait does not count as flight time.
+void answerPings() {
+    ReceivedPing ping;
+    while (pingQueue.pop(ping)) {
+      uint8_t frame[CLOCK_SYNC_REPLY_LENGTH];
+      size_t len = ClockSync::encodeReply(ping.t1, ping.t2, frame);
+      sendQueue.push(frame, len);
+    }
+}
+
+bool transmitFrame(const uint8_t *frame, size_t len) {
+    if (!WifiEspNow.hasPeer(slave.peer_addr)) {
+      return false;
+    }
+
+    if (ClockSync::isReply(frame, len)) {
+      uint8_t reply[CLOCK_SYNC_REPLY_LENGTH];
+      memcpy(reply, frame, len);
+      ClockSync::stampReply(reply, micros());
+      return WifiEspNow.send(slave.peer_addr, reply, len);
+    }
+
+    return WifiEspNow.send(slave.peer_addr, frame, len);
+}
+
+// Ping replies only mean something to the receiver that sent the ping.
+bool mirrorFrame(const uint8_t *frame, size_t len) {
+    uint8_t copy[SEND_QUEUE_FRAME_SIZE];
+    memcpy(copy, frame, len);
+    if (!standbyKnown || !MidiFrame::markStandby(copy, len) || !WifiEspNow.hasPeer(standby.peer_addr)) {
+      return false;
+    }
+
+    return WifiEspNow.send(standby.peer_addr, copy, len);
+}
+
+// The frame that made us fail over starts over on the new primary.
+bool sendFailed(const PendingFrame &frame) {
+    if (failedInARow++ == 0) {
+      failingSince = frame.sentAt;
+    }
+
+    if (standbyKnown && !failedOver && failedInARow >= FAILOVER_FAILED_SENDS) {
+      failOver();
+      return true;
+    }
+    return false;
+}
+
+// Runs inside the send queue, which must not be cleared from here: the
+// receiver is forgotten once serviceSendQueue() returned.
+void frameDropped(const PendingFrame &frame) {
+    (void)frame;
+    DebugLog(LOG_SEND_FAILED);
+
+    if (slaveKnown && ++droppedInARow >= RECEIVER_LOST_DROPS) {
+      receiverLost = true;
+    }
+}
+
+// Advances the send queue without waiting on the radio.
+void serviceSendQueue() {
+    if (!midiBatch.isEmpty() && (micros() - midiBatch.getStartedAt()) >= BATCH_WINDOW_US) {
+      flushBatch();
+    }
+
+    if (sendQueue.isBusy()) {
+      WifiEspNowSendStatus status = WifiEspNow.getSendStatus();
+      if (status != WifiEspNowSendStatus::NONE) {
+        if (sendQueue.isMirroring()) {
+          mirrorSent(status == WifiEspNowSendStatus::OK);
+        } else if (status == WifiEspNowSendStatus::OK) {
+          droppedInARow = 0;
+          failedInARow = 0;
+          failedOver = false;
+          discoveryBackoff = DISCOVERY_BACKOFF_MIN_MS;
+        }
+        sendQueue.onSendComplete(status == WifiEspNowSendStatus::OK);
+      }
+    }
+
+    sendQueue.loop(millis());
+}
+
+void logSendStats() {
+    const SendQueueStats &stats = sendQueue.getStats();
+    if (memcmp(&stats, &reportedStats, sizeof(stats)) == 0) {
+      return;
+    }
+
+    DebugLog(LOG_SEND_STATS, stats.sent, stats.retries, stats.dropped, stats.overflows);
+    if (stats.mirrored != reportedStats.mirrored) {
+      DebugLog(LOG_SEND_MIRRORED, stats.mirrored);
+    }
+    reportedStats = stats;
 }
 
 void setupButtonCallback() {
   Serial.println("Turning on AP Config Mode");
   inAPMode = true;
+  sendQueue.clear();
   WifiEspNow.end();
   configManager.startAP();
 }
 
-void midiOffHelper() {
-  Serial.println("Midi Pad Status: OFF");
-  char msg[60];
-  int len = snprintf(msg, sizeof(msg), "128 %s", midiMessageBuffer); // NOTE OFF
-  sendData(msg);
+void sendMidi(uint8_t status, uint8_t pad) {
+  MidiEvent event;
+  event.status = status;
+  event.note = pads.getNote(pad);
+  event.velocity = pads.getVelocity(pad);
+  event.pad = pad;
+  event.sequence = midiSequence++;
+  event.flags = 0;
+  event.timestamp = micros();
+
+  sendData(event);
+}
+
+void midiOffHelper(uint8_t pad) {
+  DebugLog(LOG_PAD_OFF, pad);
+  sendMidi(MIDI_STATUS_NOTE_OFF, pad);
 }
 
-void midiOnHelper() {
-  Serial.println("Midi Pad Status: ON");
-  char msg[60];
-  int len = snprintf(msg, sizeof(msg), "144 %s", midiMessageBuffer); // NOTE ON
-  sendData(msg);
+void midiOnHelper(uint8_t pad) {
+  DebugLog(LOG_PAD_ON, pad);
+  sendMidi(MIDI_STATUS_NOTE_ON, pad);
 }
-void printReceivedMessage(const uint8_t mac[6], const uint8_t* buf, size_t count, void* cbarg) {
-  Serial.printf("Message from %02X:%02X:%02X:%02X:%02X:%02X\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  for (int i = 0; i < count; ++i) {
-    Serial.print(static_cast<char>(buf[i]));
+
+// Prints what loop() logged. Records lost to a full ring are reported in
+// their place once there is room again.
+void logTask(void *parameters) {
+  (void)parameters;
+  uint32_t reported = 0;
+  LogRecord record;
+  for (;;) {
+    uint32_t dropped = debugLog.getDropped();
+    if (dropped != reported) {
+      record.at = micros();
+      record.format = LOG_DROPPED;
+      record.count = 1;
+      record.args[0] = dropped - reported;
+      writeLogRecord(record);
+      reported = dropped;
+    }
+
+    if (debugLog.pop(record)) {
+      writeLogRecord(record);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(LOG_IDLE_MS));
+    }
+  }
+}
+
+// One write per record, so text printed from loop() in the meantime
+// cannot end up in the middle of it.
+void writeLogRecord(const LogRecord &record) {
+#if LOG_BINARY
+  uint8_t buf[LOG_RECORD_MAX_LENGTH];
+  Serial.write(buf, LogCodec::encode(record, buf));
+#else
+  char line[LOG_LINE_LENGTH + 2];
+  size_t length = LogCodec::format(record, line, LOG_LINE_LENGTH);
+  line[length++] = '\r';
+  line[length++] = '\n';
+  Serial.write((const uint8_t *)line, length);
+#endif
+}
+
+// Runs in the WiFi task. Only discovery announces and clock pings are
+// expected; pings from receivers other than ours are ignored.
+void receiveMessage(const uint8_t mac[6], const uint8_t* buf, size_t count, void* cbarg) {
+  (void)cbarg;
+  ReceivedPing ping;
+  if (ClockSync::decodePing(buf, count, ping.t1)) {
+    ping.t2 = micros();
+    if (slaveKnown && memcmp(mac, slave.peer_addr, 6) == 0) {
+      pingQueue.push(ping);
+    }
+    return;
+  }
+
+  ReceivedAnnounce received;
+  if (Discovery::decodeAnnounce(buf, count, received.announce)) {
+    memcpy(received.mac, mac, 6);
+    announceQueue.push(received);
   }
-  Serial.println();
 }
 
 void setup() {
   DEBUG_MODE = true; // will enable debugging and log to serial monitor
   Serial.begin(115200);
   DebugPrintln("");
+  xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, NULL, tskIDLE_PRIORITY + 1, NULL, LOG_TASK_CORE);
 
   meta.version = 3;
 
   // Setup config manager
   configManager.setAPName("Demo");
   configManager.setAPFilename("/index.html");
+  configManager.setAssets(embeddedAssets);
 
 
-  configManager.begin(config);
+  configManager.begin(config, configFields);
 
-  initMidiMessage();
+  initPads();
+  // Start somewhere random so the receiver does not take the first frames
+  // after a reboot for retransmits of the previous run.
+  midiSequence = esp_random();
   Serial.println();
 
+  uint8_t mac[6];
+  uint8_t channel;
+  if (configManager.getReceiver(mac, channel)) {
+    Serial.println("Using the stored slave.");
+    memset(&slave, 0, sizeof(slave));
+    memcpy(slave.peer_addr, mac, 6);
+    slave.channel = channel;
+    slaveKnown = true;
+    if (configManager.getStandby(mac)) {
+      useStandby(mac);
+    }
+  }
+
   InitESPNow();
 
-  touchPad.onPressed(midiOffHelper);
+  sendQueue.onTransmit(transmitFrame);
+  sendQueue.onMirror(mirrorFrame);
+  sendQueue.onFailed(sendFailed);
+  sendQueue.onDropped(frameDropped);
+
   apSetupButton.onPressed(setupButtonCallback);
 }
 
@@ -230,20 +694,46 @@ void loop() {
   apSetupButton.read();
   configManager.loop();
   
-  if (slave.channel == CHANNEL) {
+  if (slaveKnown) {
     bool isPaired = false;
     if(!inAPMode) {
        isPaired = manageSlave();
     }
 
+    if (isPaired && !announcedReady) {
+      DebugLog(LOG_READY, millis());
+      announcedReady = true;
+    }
+
     if (isPaired) {
-      touchPad.read();
+      if (pads.scan(touchRead, micros())) {
+        for (uint8_t i = 0; i < pads.size(); ++i) {
+          if (pads.getPressed() & (1 << i)) {
+            midiOnHelper(i);
+          }
+          if (pads.getReleased() & (1 << i)) {
+            midiOffHelper(i);
+          }
+        }
+      }
+
+      if (millis() - heartbeatAt >= HEARTBEAT_MS) {
+        sendHeartbeat();
+      }
+      answerPings();
 
-      if(touchPad.wasPressed()) {
-        midiOnHelper();
+      serviceSendQueue();
+      if (receiverLost) {
+        receiverLost = false;
+        forgetSlave();
+      }
+
+      if (millis() - sendStatsAt >= SEND_STATS_MS) {
+        logSendStats();
+        sendStatsAt = millis();
       }
     }
-  } else {
-    ScanForSlave();
+  } else if (!inAPMode) {
+    discoverSlave();
   }
 }
\ No newline at end of file
@@ -0,0 +1,128 @@
+#ifndef __PLAYOUTQUEUE_H__
+#define __PLAYOUTQUEUE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Playout Queue
+ *
+ * Fixed capacity min-heap of items keyed by the micros() they are due
+ * at. Due times wrap with micros(), so they are compared as differences
+ * and must stay within half the wrap of each other. Items due at the same
+ * time come out in the order they were pushed, so a note-off never
+ * overtakes its note-on. Single context only.
+ */
+template<typename T, size_t Capacity>
+class PlayoutQueue {
+public:
+    PlayoutQueue() : count(0), order(0), highWater(0) {}
+
+    bool push(uint32_t dueAt, const T &item) {
+        if (count == Capacity) {
+            return false;
+        }
+
+        size_t i = count++;
+        entries[i].dueAt = dueAt;
+        entries[i].order = order++;
+        entries[i].item = item;
+        siftUp(i);
+
+        if (count > highWater) {
+            highWater = count;
+        }
+
+        return true;
+    }
+
+    // Pops the earliest item if it is due at now.
+    bool popDue(uint32_t now, T &item) {
+        if (count == 0 || (int32_t)(entries[0].dueAt - now) > 0) {
+            return false;
+        }
+
+        return pop(item);
+    }
+
+    // Pops the earliest item, due or not.
+    bool pop(T &item) {
+        if (count == 0) {
+            return false;
+        }
+
+        item = entries[0].item;
+        entries[0] = entries[--count];
+        siftDown(0);
+
+        return true;
+    }
+
+    // Micros() the earliest item is due at, only meaningful when not empty.
+    uint32_t nextDueAt() const {
+        return entries[0].dueAt;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t getHighWater() const {
+        return highWater;
+    }
+
+private:
+    struct Entry {
+        uint32_t dueAt;
+        uint32_t order;
+        T item;
+    };
+
+    Entry entries[Capacity];
+    size_t count;
+    uint32_t order;
+    size_t highWater;
+
+    static bool before(const Entry &a, const Entry &b) {
+        int32_t diff = (int32_t)(a.dueAt - b.dueAt);
+        return diff != 0 ? diff < 0 : (int32_t)(a.order - b.order) < 0;
+    }
+
+    void siftUp(size_t i) {
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!before(entries[i], entries[parent])) {
+                break;
+            }
+            swap(i, parent);
+            i = parent;
+        }
+    }
+
+    void siftDown(size_t i) {
+        for (;;) {
+            size_t smallest = i;
+            size_t left = 2 * i + 1;
+            size_t right = left + 1;
+            if (left < count && before(entries[left], entries[smallest])) {
+                smallest = left;
+            }
+            if (right < count && before(entries[right], entries[smallest])) {
+                smallest = right;
+            }
+            if (smallest == i) {
+                return;
+            }
+            swap(i, smallest);
+            i = smallest;
+        }
+    }
+
+    void swap(size_t a, size_t b) {
+        Entry tmp = entries[a];
+        entries[a] = entries[b];
+        entries[b] = tmp;
+    }
+};
+
+#endif /* __PLAYOUTQUEUE_H__ */
@@ -0,0 +1,143 @@
+#ifndef __SERIALLINK_H__
+#define __SERIALLINK_H__
+
+#include <Arduino.h>
+#include <SerialFrame.h>
+
+#include <functional>
+
+class SerialLink;
+
+/**
+ * Framed Print
+ *
+ * Print target that sends everything written to it as frames on one
+ * channel. A frame goes out at every newline or when the payload is
+ * full, so long lines arrive split over several frames.
+ */
+class FramedPrint : public Print {
+public:
+    FramedPrint(SerialLink &link, uint8_t channel) : link(link), channel(channel), length(0) {}
+
+    using Print::write;
+    size_t write(uint8_t c);
+    void flush();
+
+private:
+    SerialLink &link;
+    uint8_t channel;
+    uint8_t buf[SERIAL_FRAME_MAX_PAYLOAD];
+    size_t length;
+};
+
+/**
+ * Serial Link
+ *
+ * Multiplexes MIDI, telemetry and log output over one UART using
+ * SerialFrame, and hands control frames from the host to a callback.
+ */
+class SerialLink {
+public:
+    typedef std::function<void(const uint8_t *payload, size_t length)> ControlCallback;
+
+    SerialLink(HardwareSerial &serial) : serial(serial),
+        logPrint(*this, SERIAL_CHANNEL_LOG), telemetryPrint(*this, SERIAL_CHANNEL_TELEMETRY) {}
+
+    void begin(unsigned long baud) {
+        serial.begin(baud);
+    }
+
+    bool send(uint8_t channel, const uint8_t *payload, size_t length) {
+        uint8_t frame[SERIAL_FRAME_MAX_ENCODED];
+        size_t n = SerialFrame::encode(channel, payload, length, frame);
+        if (n == 0) {
+            return false;
+        }
+
+        return serial.write(frame, n) == n;
+    }
+
+    bool sendMidi(uint8_t status, uint8_t data1, uint8_t data2) {
+        uint8_t message[3] = {status, (uint8_t)(data1 & 0x7F), (uint8_t)(data2 & 0x7F)};
+        return send(SERIAL_CHANNEL_MIDI, message, sizeof(message));
+    }
+
+    // The rates a host UART is sure to offer, the same as tools/hlbridge.
+    static bool isSupportedBaud(uint32_t baud) {
+        static const uint32_t rates[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+        for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+            if (rates[i] == baud) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Replies on the control channel at the current rate, waits for it to
+    // leave the UART, then switches. Any other rate is ignored without a
+    // reply, so one bad request cannot leave the link at a rate nothing
+    // can follow.
+    bool setBaud(uint32_t baud) {
+        if (!isSupportedBaud(baud)) {
+            return false;
+        }
+
+        uint8_t reply[5] = {SERIAL_CONTROL_BAUD, (uint8_t)baud, (uint8_t)(baud >> 8), (uint8_t)(baud >> 16), (uint8_t)(baud >> 24)};
+        send(SERIAL_CHANNEL_CONTROL, reply, sizeof(reply));
+        serial.flush();
+        serial.updateBaudRate(baud);
+        return true;
+    }
+
+    void onControl(ControlCallback callback) {
+        controlCallback = callback;
+    }
+
+    // Reads whatever the host sent and dispatches complete control frames.
+    void poll() {
+        while (serial.available()) {
+            if (!decoder.push((uint8_t)serial.read())) {
+                continue;
+            }
+            if (decoder.channel() == SERIAL_CHANNEL_CONTROL && controlCallback) {
+                controlCallback(decoder.payload(), decoder.payloadLength());
+            }
+        }
+    }
+
+    Print &log() {
+        return logPrint;
+    }
+
+    Print &telemetry() {
+        return telemetryPrint;
+    }
+
+    const SerialFrameDecoder &getDecoder() const {
+        return decoder;
+    }
+
+private:
+    HardwareSerial &serial;
+    SerialFrameDecoder decoder;
+    FramedPrint logPrint;
+    FramedPrint telemetryPrint;
+    ControlCallback controlCallback;
+};
+
+inline size_t FramedPrint::write(uint8_t c) {
+    buf[length++] = c;
+    if (c == '\n' || length == sizeof(buf)) {
+        flush();
+    }
+    return 1;
+}
+
+inline void FramedPrint::flush() {
+    if (length > 0) {
+        link.send(channel, buf, length);
+        length = 0;
+    }
+}
+
+#endif /* __SERIALLINK_H__ */
@@ -29,11 +29,60 @@
 #include <WiFi.h>
 #include <WifiEspNow.h>
 #include <MIDI.h>
+#include <MidiFrame.h>
+#include <SpscRing.h>
+#include <LatencyStats.h>
+#include <PeerTable.h>
+#include <SerialLink.h>
+#include <FrameTrace.h>
+#include <Discovery.h>
+#include <ClockSync.h>
+#include <PlayoutQueue.h>
 
 #define CHANNEL 1
+#define EVENT_QUEUE_SIZE 64
+#define STATS_COMMAND 's'
+#define TRACE_COMMAND 't'
+#define DELAY_COMMAND 'd'   // followed by the playout delay in decimal microseconds and a newline
+#define CAPTURE_SLOTS 128
+#define HELLO_QUEUE_SIZE 8
+#define HEARTBEAT_QUEUE_SIZE 8
+#define SYNC_QUEUE_SIZE 8
+#define PLAYOUT_QUEUE_SIZE 128
+
+// -- Notes are played PLAYOUT_DELAY_US after the sensor raised them, on
+//    our clock, so retries and contention on the air turn into a fixed
+//    delay instead of jitter. Notes that arrive later than that play right
+//    away, as do notes from sensors whose clock is not known yet. 0 plays
+//    every note on arrival. The host can change the delay at run time.
+#ifndef PLAYOUT_DELAY_US
+#define PLAYOUT_DELAY_US 5000
+#endif
+#define PLAYOUT_MAX_DELAY_US 100000
+
+// -- Sensor clocks are measured with a broadcast ping this often.
+#define CLOCK_SYNC_INTERVAL_MS 500
+
+// -- A sensor heard from neither events nor heartbeats for this long has
+//    all the notes it still holds released.
+#ifndef PEER_SILENCE_MS
+#define PEER_SILENCE_MS 3000
+#endif
+// -- A second receiver on the same channel, built with another name, is
+//    taken as standby by the sensors that find both.
+#ifndef RECEIVER_NAME
+#define RECEIVER_NAME "Slave_1"
+#endif
 
 #define SERIALMIDI_BAUD_RATE  115200
 
+// -- With SERIAL_FRAMED set, UART0 carries SerialFrame frames with MIDI,
+//    telemetry and log channels instead of raw MIDI bytes. The host can
+//    raise the baud rate with a SERIAL_CONTROL_BAUD control frame.
+#ifndef SERIAL_FRAMED
+#define SERIAL_FRAMED 0
+#endif
+
 struct SerialMIDISettings : public midi::DefaultSettings
 {
   static const long BaudRate = SERIALMIDI_BAUD_RATE;
@@ -44,50 +93,500 @@ HardwareSerial                SerialMIDI(0);
 
 MIDI_CREATE_CUSTOM_INSTANCE(HardwareSerial, SerialMIDI, MIDI, SerialMIDISettings);
 
+SerialLink serialLink(SerialMIDI);
+
+// -- Human readable output. In raw mode it shares the UART with MIDI, so
+//    nothing is printed there once setup() is done unless asked for.
+#if SERIAL_FRAMED
+Print &Log = serialLink.log();
+Print &Telemetry = serialLink.telemetry();
+#else
+Print &Log = Serial;
+Print &Telemetry = Serial;
+#endif
+
+struct ReceivedEvent {
+  MidiEvent event;
+  uint8_t peer;
+};
+
+struct ReceivedHeartbeat {
+  uint8_t peer;
+  bool standby;
+  uint16_t sequence;
+  MidiNoteSet held;
+};
+
+struct ReceivedHello {
+  uint8_t mac[6];
+  uint32_t nonce;
+};
+
+struct ReceivedSync {
+  uint8_t peer;
+  uint32_t t1;
+  uint32_t t2;
+  uint32_t t3;
+  uint32_t t4;
+};
+
+// -- A note waiting for its time. timestamp is the sender's, only set
+//    for notes that came from an event.
+struct ScheduledNote {
+  uint8_t peer;
+  uint8_t status;
+  uint8_t note;
+  uint8_t velocity;
+  bool fromEvent;
+  uint16_t sequence;
+  uint32_t timestamp;
+};
+
+// -- Decoded events travel from the WiFi task's receive callback to
+//    loop() through this ring, so no UART writes happen in radio context.
+SpscRing<ReceivedEvent, EVENT_QUEUE_SIZE> eventQueue;
+
+// -- Discovery hellos from sensors, answered from loop() for the same
+//    reason.
+SpscRing<ReceivedHello, HELLO_QUEUE_SIZE> helloQueue;
+
+// -- Heartbeats travel separately from events; their sequence number
+//    tells loop() whether events dispatched already overtook them.
+SpscRing<ReceivedHeartbeat, HEARTBEAT_QUEUE_SIZE> heartbeatQueue;
+
+// -- Ping replies, stamped with our micros() when they came in.
+SpscRing<ReceivedSync, SYNC_QUEUE_SIZE> syncQueue;
+
+// -- Sensors we have heard from. Only the receive callback adds peers;
+//    loop() looks them up by the compact index carried in each event.
+PeerTable peerTable;
+
+// -- Touch-to-MIDI stats per sensor, indexed by peer index and only
+//    touched from loop().
+PeerLinkStats linkStats[PEER_TABLE_MAX_PEERS];
+
+// -- Notes each sensor holds as far as the MIDI output is concerned once
+//    the playout queue has drained, the sequence its next event should
+//    carry, and how many notes had to be released for it. Only touched
+//    from loop().
+MidiNoteSet heldNotes[PEER_TABLE_MAX_PEERS];
+uint16_t nextSequence[PEER_TABLE_MAX_PEERS];
+uint32_t releasedNotes[PEER_TABLE_MAX_PEERS];
+
+// -- Sensors we are the standby receiver for: their notes are followed in
+//    heldNotes but played by their primary. Only touched from loop().
+bool standbyFor[PEER_TABLE_MAX_PEERS];
+uint32_t takeovers[PEER_TABLE_MAX_PEERS];
+
+// -- Clock of each sensor against ours, and the notes it has waiting in
+//    the playout queue with the time the last of them is due. Only
+//    touched from loop().
+ClockEstimator sensorClocks[PEER_TABLE_MAX_PEERS];
+uint8_t pendingNotes[PEER_TABLE_MAX_PEERS];
+uint32_t lastDueAt[PEER_TABLE_MAX_PEERS];
+
+// -- Every MIDI message goes through here, ordered by the time it is due.
+PlayoutQueue<ScheduledNote, PLAYOUT_QUEUE_SIZE> playoutQueue;
+uint32_t playoutDelay = PLAYOUT_DELAY_US;
+uint32_t playedLate = 0;
+uint32_t playedUnsynced = 0;
+unsigned long pingAt = 0;
+bool readingDelay = false;
+uint32_t delayDigits = 0;
+
+// -- The last CAPTURE_SLOTS frames as they came off the air, malformed
+//    ones included, for replay on a PC after a show went wrong.
+CaptureRing<CAPTURE_SLOTS> captureRing;
+
+// -- Frames rejected by MidiFrame::decode, indexed by FrameResult.
+//    Only written from the receive callback.
+volatile uint32_t rejectedFrames[FRAME_RESULT_COUNT];
+
 void InitESPNow();
 void configDeviceAP();
 void printReceivedMessage(const uint8_t mac[6], const uint8_t* buf, size_t count, void* cbarg);
+void dispatchEvents();
+void answerHellos();
+void reconcileHeartbeats();
+void releaseSilentPeers();
+void releaseNotes(uint8_t peer, const MidiNoteSet &keep);
+void follow(uint8_t peer, bool standby);
+void syncClocks();
+void pingSensors();
+uint32_t dueAt(uint8_t peer, uint32_t timestamp);
+void schedule(const ScheduledNote &note, uint32_t due);
+void playDue();
+void setPlayoutDelay(uint32_t us);
+void readDelayCommand();
+void printStats();
+void emitNote(uint8_t status, uint8_t note, uint8_t velocity);
+void handleControl(const uint8_t *payload, size_t length);
+void dumpTrace();
 
 
 void printReceivedMessage(const uint8_t mac[6], const uint8_t* buf, size_t count, void* cbarg) {
-  int delimiterCount = 0;
+  (void)cbarg;
+  uint32_t now = micros();
+  captureRing.record(mac, buf, count, now);
+
+  if (ClockSync::isClockSync(buf, count)) {
+    ReceivedSync sync;
+    if (ClockSync::decodeReply(buf, count, sync.t1, sync.t2, sync.t3)) {
+      Peer *peer = peerTable.find(mac);
+      if (peer) {
+        sync.peer = peer->index;
+        sync.t4 = now;
+        syncQueue.push(sync);
+      }
+    }
+    return;
+  }
+
+  if (Discovery::isDiscovery(buf, count)) {
+    ReceivedHello hello;
+    if (Discovery::decodeHello(buf, count, hello.nonce)) {
+      memcpy(hello.mac, mac, 6);
+      helloQueue.push(hello);
+    }
+    return;
+  }
+
+  ReceivedHeartbeat heartbeat;
+  if (MidiHeartbeat::decode(buf, count, heartbeat.sequence, heartbeat.held)) {
+    Peer *peer = peerTable.find(mac);
+    if (peer) {
+      peer->lastSeen = millis();
+      heartbeat.peer = peer->index;
+      heartbeat.standby = MidiHeartbeat::isStandby(buf);
+      heartbeatQueue.push(heartbeat);
+    }
+    return;
+  }
+
+  MidiEvent events[MIDI_FRAME_MAX_EVENTS];
+  uint8_t eventCount;
+  FrameResult result = MidiFrame::decode(buf, count, events, eventCount);
+  if (result != FRAME_OK) {
+    rejectedFrames[result]++;
+    return;
+  }
+
+  Peer *peer = peerTable.find(mac);
+  if (!peer) {
+    return;
+  }
+
+  peer->lastSeen = millis();
+  if (!PeerTable::accept(*peer, events[0].sequence, eventCount)) {
+    return;
+  }
+
+  ReceivedEvent received;
+  received.peer = peer->index;
+  for (uint8_t i = 0; i < eventCount; ++i) {
+    received.event = events[i];
+    eventQueue.push(received);
+  }
+}
+
+// Drains the event queue from loop() into the playout queue. Events of
+// sensors we are the standby for only update their notes.
+void dispatchEvents() {
+  ReceivedEvent received;
+  while (eventQueue.pop(received)) {
+    const MidiEvent &event = received.event;
+
+    follow(received.peer, event.flags & MIDI_FLAG_STANDBY);
+    if (!standbyFor[received.peer]) {
+      ScheduledNote note;
+      note.peer = received.peer;
+      note.status = event.status;
+      note.note = event.note;
+      note.velocity = event.velocity;
+      note.fromEvent = true;
+      note.sequence = event.sequence;
+      note.timestamp = event.timestamp;
+      schedule(note, dueAt(received.peer, event.timestamp));
+    }
+
+    if ((event.status & 0xF0) == MIDI_STATUS_NOTE_ON && event.velocity > 0) {
+      heldNotes[received.peer].set(event.note);
+    } else {
+      heldNotes[received.peer].reset(event.note);
+    }
+    nextSequence[received.peer] = event.sequence + 1;
+  }
+}
+
+// Releases the notes a sensor no longer holds according to its heartbeat.
+// A heartbeat sent before events that were dispatched already is stale
+// and skipped, the next one will do. Notes the heartbeat holds but we do
+// not are left alone: a late note-on is worse than a missed one.
+void reconcileHeartbeats() {
+  ReceivedHeartbeat heartbeat;
+  while (heartbeatQueue.pop(heartbeat)) {
+    follow(heartbeat.peer, heartbeat.standby);
+    int16_t ahead = (int16_t)(nextSequence[heartbeat.peer] - heartbeat.sequence);
+    if (ahead > 0 && ahead < PEER_REPLAY_WINDOW) {
+      continue;
+    }
+    releaseNotes(heartbeat.peer, heartbeat.held);
+  }
+}
+
+void releaseSilentPeers() {
+  MidiNoteSet none;
+  none.clear();
+
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < peerTable.size(); ++i) {
+    if (heldNotes[i].any() && now - peerTable.get(i)->lastSeen > PEER_SILENCE_MS) {
+      releaseNotes(i, none);
+    }
+  }
+}
+
+// Sends a note-off for every note the peer holds that is not in keep,
+// behind the notes of the peer still waiting to be played. As its standby
+// the notes are only forgotten, the primary releases them.
+void releaseNotes(uint8_t peer, const MidiNoteSet &keep) {
+  MidiNoteSet &held = heldNotes[peer];
+  ScheduledNote off;
+  off.peer = peer;
+  off.status = MIDI_STATUS_NOTE_OFF;
+  off.velocity = 0;
+  off.fromEvent = false;
+
+  for (uint8_t word = 0; word < 4; ++word) {
+    uint32_t stale = held.bits[word] & ~keep.bits[word];
+    while (stale) {
+      uint8_t bit = __builtin_ctz(stale);
+      stale &= stale - 1;
+      off.note = word * 32 + bit;
+      if (!standbyFor[peer]) {
+        schedule(off, micros());
+        releasedNotes[peer]++;
+      }
+    }
+    held.bits[word] &= keep.bits[word];
+  }
+}
+
+// Frames from a sensor say whether we are its primary or its standby.
+// Taking over needs nothing else: the notes we followed are the ones
+// sounding, and the sensor resends what the primary never acked.
+void follow(uint8_t peer, bool standby) {
+  if (standbyFor[peer] && !standby) {
+    takeovers[peer]++;
+  }
+  standbyFor[peer] = standby;
+}
+
+void syncClocks() {
+  ReceivedSync sync;
+  while (syncQueue.pop(sync)) {
+    sensorClocks[sync.peer].addSample(sync.t1, sync.t2, sync.t3, sync.t4);
+  }
+}
+
+// Broadcast, so sensors need no peer slot; each answers its own receiver.
+void pingSensors() {
+  if (millis() - pingAt < CLOCK_SYNC_INTERVAL_MS) {
+    return;
+  }
+  pingAt = millis();
+
+  uint8_t buf[CLOCK_SYNC_PING_LENGTH];
+  size_t length = ClockSync::encodePing(micros(), buf);
+  WifiEspNow.send(DISCOVERY_BROADCAST, buf, length);
+}
+
+// Our time to play an event the sensor raised at timestamp.
+uint32_t dueAt(uint8_t peer, uint32_t timestamp) {
+  uint32_t now = micros();
+  if (playoutDelay == 0) {
+    return now;
+  }
 
-  int status = 0;
-  int pitch = 0;
-  int velocity = 0;
+  const ClockEstimator &clock = sensorClocks[peer];
+  if (!clock.isSynced()) {
+    playedUnsynced++;
+    return now;
+  }
 
-  char messageBuffer[40];
-  for (int i = 0; i < count; ++i) {
-    messageBuffer[i] = static_cast<char>(buf[i]);
-    //Serial.print(static_cast<char>(buf[i]));
+  int32_t wait = (int32_t)(clock.toLocal(timestamp, now) + playoutDelay - now);
+  if (wait < 0) {
+    playedLate++;
+    return now;
   }
 
-  char * pch;
-  pch = strtok (messageBuffer," ");
-  while (pch != NULL)
-  {
+  // A clock estimate that far off is not to be trusted with a note.
+  return now + (wait <= PLAYOUT_MAX_DELAY_US ? wait : playoutDelay);
+}
 
-    if(delimiterCount == 0) {
-      status = atoi(pch);
+// Queues a note, never ahead of notes of the same peer queued before it.
+// A full queue plays its earliest note early to make room.
+void schedule(const ScheduledNote &note, uint32_t due) {
+  if (pendingNotes[note.peer] > 0 && (int32_t)(due - lastDueAt[note.peer]) < 0) {
+    due = lastDueAt[note.peer];
+  }
+
+  if (playoutQueue.size() == PLAYOUT_QUEUE_SIZE) {
+    ScheduledNote earliest;
+    playoutQueue.pop(earliest);
+    pendingNotes[earliest.peer]--;
+    emitNote(earliest.status, earliest.note, earliest.velocity);
+    playedLate++;
+  }
+
+  playoutQueue.push(due, note);
+  pendingNotes[note.peer]++;
+  lastDueAt[note.peer] = due;
+}
+
+void playDue() {
+  ScheduledNote note;
+  while (playoutQueue.popDue(micros(), note)) {
+    pendingNotes[note.peer]--;
+    emitNote(note.status, note.note, note.velocity);
+    if (note.fromEvent) {
+      linkStats[note.peer].record(note.sequence, note.timestamp, micros());
     }
-    if(delimiterCount == 1) {
-      pitch = atoi(pch);
+  }
+}
+
+void setPlayoutDelay(uint32_t us) {
+  playoutDelay = us < PLAYOUT_MAX_DELAY_US ? us : PLAYOUT_MAX_DELAY_US;
+  Telemetry.printf("playout delay %u us\n", playoutDelay);
+}
+
+// Collects the digits after a DELAY_COMMAND as they come in, so loop()
+// never waits on the host.
+void readDelayCommand() {
+  while (readingDelay && Serial.available()) {
+    int c = Serial.read();
+    if (c >= '0' && c <= '9') {
+      delayDigits = delayDigits * 10 + (c - '0');
+      continue;
     }
-    if(delimiterCount == 2) {
-      velocity = atoi(pch);
+    readingDelay = false;
+    setPlayoutDelay(delayDigits);
+  }
+}
+
+// Broadcasts an announce for every queued hello. A sensor we already
+// know keeps its slot, so it counts towards the capacity offered to it.
+void answerHellos() {
+  ReceivedHello hello;
+  while (helloQueue.pop(hello)) {
+    uint8_t peers = peerTable.size();
+    bool known = false;
+    for (uint8_t i = 0; i < peers && !known; ++i) {
+      known = memcmp(peerTable.get(i)->mac, hello.mac, 6) == 0;
     }
-    pch = strtok (NULL, " ");
-    delimiterCount++;
+
+    DiscoveryAnnounce announce;
+    announce.nonce = hello.nonce;
+    announce.channel = CHANNEL;
+    announce.capacity = PEER_TABLE_MAX_PEERS - peers + (known ? 1 : 0);
+    announce.peers = peers;
+    strncpy(announce.name, RECEIVER_NAME, sizeof(announce.name));
+    announce.name[DISCOVERY_MAX_NAME] = '\0';
+
+    uint8_t buf[DISCOVERY_MAX_LENGTH];
+    size_t length = Discovery::encodeAnnounce(announce, buf);
+    WifiEspNow.send(DISCOVERY_BROADCAST, buf, length);
   }
+}
 
-  Serial.println();
-  if(status == 128) {
-      MIDI.sendNoteOff(pitch, velocity,1);
+void emitNote(uint8_t status, uint8_t note, uint8_t velocity) {
+#if SERIAL_FRAMED
+  serialLink.sendMidi(status, note, velocity); // channel 1
+#else
+  if(status == MIDI_STATUS_NOTE_OFF) {
+      MIDI.sendNoteOff(note, velocity, 1);
   }
-  if(status == 144) {
-      MIDI.sendNoteOn(pitch, velocity, 1);
+  if(status == MIDI_STATUS_NOTE_ON) {
+      MIDI.sendNoteOn(note, velocity, 1);
   }
+#endif
+}
 
+void handleControl(const uint8_t *payload, size_t length) {
+  if (length == 1 && payload[0] == SERIAL_CONTROL_STATS) {
+    printStats();
+  }
+  if (length == 1 && payload[0] == SERIAL_CONTROL_TRACE) {
+    dumpTrace();
+  }
+  if (length == 5 && payload[0] == SERIAL_CONTROL_DELAY) {
+    setPlayoutDelay(payload[1] | (payload[2] << 8) | ((uint32_t)payload[3] << 16) | ((uint32_t)payload[4] << 24));
+  }
+  if (length == 5 && payload[0] == SERIAL_CONTROL_BAUD) {
+    uint32_t baud = payload[1] | (payload[2] << 8) | ((uint32_t)payload[3] << 16) | ((uint32_t)payload[4] << 24);
+    serialLink.setBaud(baud);
+  }
+}
+
+// Sends the capture ring as a FrameTrace file: one frame per record on
+// the trace channel, or "trace <hex>" lines when sending raw MIDI.
+void dumpTrace() {
+  uint8_t record[TRACE_MAX_RECORD_LENGTH];
+
+  captureRing.pause();
+#if SERIAL_FRAMED
+  serialLink.send(SERIAL_CHANNEL_TRACE, (const uint8_t *)TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+#else
+  Telemetry.println();
+  Telemetry.print("trace ");
+  for (int i = 0; i < TRACE_MAGIC_LENGTH; ++i) {
+    Telemetry.printf("%02X", TRACE_MAGIC[i]);
+  }
+  Telemetry.println();
+#endif
+
+  for (size_t i = 0; i < captureRing.size(); ++i) {
+    size_t length = FrameTrace::encode(captureRing.get(i), record);
+#if SERIAL_FRAMED
+    serialLink.send(SERIAL_CHANNEL_TRACE, record, length);
+#else
+    Telemetry.print("trace ");
+    for (size_t j = 0; j < length; ++j) {
+      Telemetry.printf("%02X", record[j]);
+    }
+    Telemetry.println();
+#endif
+  }
+  captureRing.resume();
+}
+
+// Dumps per-sensor latency (in microseconds above the fastest delivery),
+// loss and reorder counts, plus receiver-wide queue and reject counters.
+void printStats() {
+  unsigned long now = millis();
+
+  Telemetry.println();
+  for (uint8_t i = 0; i < peerTable.size(); ++i) {
+    const Peer *peer = peerTable.get(i);
+    const uint8_t *mac = peer->mac;
+    const PeerLinkStats &link = linkStats[i];
+    const LatencyHistogram &latency = link.getLatency();
+    const ClockEstimator &clock = sensorClocks[i];
+    Telemetry.printf("%u %02X:%02X:%02X:%02X:%02X:%02X frames=%u duplicates=%u age=%lums events=%u lost=%u reordered=%u released=%u p50=%u p90=%u p99=%u max=%u rtt=%u drift=%dppm standby=%u takeovers=%u\n",
+                  i, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
+                  peer->frames, peer->duplicates, now - peer->lastSeen,
+                  link.getEvents(), link.getLost(), link.getReordered(), releasedNotes[i],
+                  latency.percentile(50), latency.percentile(90), latency.percentile(99), latency.getMax(),
+                  clock.getRoundTrip(), clock.getDriftPpm(), standbyFor[i], takeovers[i]);
+  }
+
+  Telemetry.printf("peers: %u rejected=%u\n", peerTable.size(), peerTable.getRejected());
+  Telemetry.printf("queue: highWater=%u overflows=%u\n", (unsigned)eventQueue.getHighWater(), eventQueue.getOverflows());
+  Telemetry.printf("playout: delay=%u late=%u unsynced=%u highWater=%u\n",
+                playoutDelay, playedLate, playedUnsynced, (unsigned)playoutQueue.getHighWater());
+  Telemetry.printf("rejected: short=%u long=%u version=%u status=%u data=%u\n",
+                rejectedFrames[FRAME_TOO_SHORT], rejectedFrames[FRAME_TOO_LONG], rejectedFrames[FRAME_BAD_VERSION],
+                rejectedFrames[FRAME_BAD_STATUS], rejectedFrames[FRAME_BAD_DATA]);
 }
 
 // Init ESP Now with fallback
@@ -96,47 +595,59 @@ void InitESPNow() {
   bool ok = WifiEspNow.begin();
 
   if (ok) {
-    Serial.println("ESPNow Init Success");
+    Log.println("ESPNow Init Success");
   }
   else {
-    Serial.println("ESPNow Init Failed");
+    Log.println("ESPNow Init Failed");
     // Retry InitESPNow, add a counte and then restart?
     // InitESPNow();
     // or Simply Restart
     ESP.restart();
   }
+
+  // Announces go out as broadcasts, so sensors need no peer slot here
+  // until they send MIDI.
+  WifiEspNow.addPeer(DISCOVERY_BROADCAST);
 }
 
-// config AP SSID
+// config AP SSID. Sensors find the receiver through discovery hellos, the
+// soft-AP only fixes the channel ESP-NOW runs on.
 void configDeviceAP() {
-  const char *SSID = "Slave_1";
+  const char *SSID = RECEIVER_NAME;
   WiFi.persistent(false);
   WiFi.mode(WIFI_AP);
   WiFi.softAPdisconnect(false);
   bool result = WiFi.softAP(SSID, "Slave_1_Password", CHANNEL, 0);
   if (!result) {
-    Serial.println("AP Config failed.");
+    Log.println("AP Config failed.");
   } else {
-    Serial.println("AP Config Success. Broadcasting with AP: " + String(SSID));
+    Log.println("AP Config Success. Broadcasting with AP: " + String(SSID));
   }
 }
 
 void setup() {
+#if SERIAL_FRAMED
+  serialLink.begin(SERIALMIDI_BAUD_RATE);
+  serialLink.onControl(handleControl);
+#else
   Serial.begin(SERIALMIDI_BAUD_RATE);
-  Serial.println("ESPNow/Basic/Slave Example");
+#endif
+  Log.println("ESPNow/Basic/Slave Example");
   //Set device in AP mode to begin with
   WiFi.mode(WIFI_AP);
   // configure device AP mode
   configDeviceAP();
   // This is the mac address of the Slave in AP Mode
-  Serial.print("AP MAC: "); Serial.println(WiFi.softAPmacAddress());
+  Log.print("AP MAC: "); Log.println(WiFi.softAPmacAddress());
   // Init ESPNow with a fallback logic
   InitESPNow();
   // Once ESPNow is successfully Init, we will register for recv CB to
   // get recv packer info.
-  Serial.println("Register received callback");
+  Log.println("Register received callback");
 
+#if !SERIAL_FRAMED
   MIDI.begin(MIDI_CHANNEL_OMNI);  // Listen to all incoming messages
+#endif
 
   WifiEspNow.onReceive(printReceivedMessage, nullptr);
 }
@@ -144,6 +655,37 @@ void setup() {
 
 
 void loop() {
+     dispatchEvents();
+     reconcileHeartbeats();
+     releaseSilentPeers();
+     syncClocks();
+     playDue();
+     answerHellos();
+     pingSensors();
+
+#if SERIAL_FRAMED
+     serialLink.poll();
+#else
+     // A lone STATS_COMMAND byte from the host asks for a stats dump, the
+     // MIDI parser ignores it anyway since it is not a status byte.
+     if (Serial.available() && Serial.peek() == STATS_COMMAND) {
+       Serial.read();
+       printStats();
+     }
+     if (Serial.available() && Serial.peek() == TRACE_COMMAND) {
+       Serial.read();
+       dumpTrace();
+     }
+     if (Serial.available() && Serial.peek() == DELAY_COMMAND) {
+       Serial.read();
+       readingDelay = true;
+       delayDigits = 0;
+     }
+     readDelayCommand();
+
      // Read incoming messages
-     MIDI.read();
+     if (!readingDelay) {
+       MIDI.read();
+     }
+#endif
 }
\ No newline at end of file
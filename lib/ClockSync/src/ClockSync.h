@@ -0,0 +1,237 @@
+#ifndef __CLOCKSYNC_H__
+#define __CLOCKSYNC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// -- Clock synchronization over ESP-NOW, shared by the edge sensors and
+//    the serial receiver. The receiver broadcasts a ping stamped with its
+//    micros(); a sensor that is paired with it answers with the ping's
+//    stamp, its micros() when the ping came in and its micros() when the
+//    reply went out:
+//
+//    ping:   0      1     2..5
+//            magic  type  t1 (receiver)
+//    reply:  0      1     2..5  6..9          10..13
+//            magic  type  t1    t2 (sensor)   t3 (sensor)
+//
+//    With t4 the receiver's micros() at the reply, the sensor clock is
+//    ahead by ((t2 - t1) + (t3 - t4)) / 2, give or take half the
+//    asymmetry of the round trip (t4 - t1) - (t3 - t2). All stamps are
+//    little endian. The magic can never be mistaken for a MidiFrame
+//    version.
+#define CLOCK_SYNC_MAGIC 0xC5
+#define CLOCK_SYNC_PING_LENGTH 6
+#define CLOCK_SYNC_REPLY_LENGTH 14
+
+#define CLOCK_SYNC_TYPE_PING 'P'
+#define CLOCK_SYNC_TYPE_REPLY 'R'
+
+// -- The estimate uses the fastest round trip of the last
+//    CLOCK_SYNC_WINDOW replies; the slower ones waited in a queue on the
+//    way and say little about the offset. The drift is measured between
+//    estimates at least CLOCK_SYNC_DRIFT_SPAN_MS apart. Replies slower
+//    than CLOCK_SYNC_STEP_US are ignored; one further than that from the
+//    prediction means the sensor restarted, and the estimate starts over.
+#define CLOCK_SYNC_WINDOW 8
+#define CLOCK_SYNC_DRIFT_SPAN_MS 8000
+#define CLOCK_SYNC_STEP_US 20000
+
+// -- Drift is kept in units of 2^-CLOCK_SYNC_DRIFT_SHIFT, about 0.06 ppm.
+#define CLOCK_SYNC_DRIFT_SHIFT 24
+
+/**
+ * Clock Sync codec
+ */
+class ClockSync {
+public:
+    static bool isClockSync(const uint8_t *buf, size_t count) {
+        return count >= 2 && buf[0] == CLOCK_SYNC_MAGIC;
+    }
+
+    // buf must hold CLOCK_SYNC_PING_LENGTH bytes.
+    static size_t encodePing(uint32_t t1, uint8_t *buf) {
+        buf[0] = CLOCK_SYNC_MAGIC;
+        buf[1] = CLOCK_SYNC_TYPE_PING;
+        write(t1, buf + 2);
+        return CLOCK_SYNC_PING_LENGTH;
+    }
+
+    static bool decodePing(const uint8_t *buf, size_t count, uint32_t &t1) {
+        if (count != CLOCK_SYNC_PING_LENGTH || buf[0] != CLOCK_SYNC_MAGIC || buf[1] != CLOCK_SYNC_TYPE_PING) {
+            return false;
+        }
+        t1 = read(buf + 2);
+        return true;
+    }
+
+    // buf must hold CLOCK_SYNC_REPLY_LENGTH bytes. t3 is filled in by
+    // stampReply() right before the reply goes on the air.
+    static size_t encodeReply(uint32_t t1, uint32_t t2, uint8_t *buf) {
+        buf[0] = CLOCK_SYNC_MAGIC;
+        buf[1] = CLOCK_SYNC_TYPE_REPLY;
+        write(t1, buf + 2);
+        write(t2, buf + 6);
+        write(t2, buf + 10);
+        return CLOCK_SYNC_REPLY_LENGTH;
+    }
+
+    static bool isReply(const uint8_t *buf, size_t count) {
+        return count == CLOCK_SYNC_REPLY_LENGTH && buf[0] == CLOCK_SYNC_MAGIC && buf[1] == CLOCK_SYNC_TYPE_REPLY;
+    }
+
+    static void stampReply(uint8_t *buf, uint32_t t3) {
+        write(t3, buf + 10);
+    }
+
+    static bool decodeReply(const uint8_t *buf, size_t count, uint32_t &t1, uint32_t &t2, uint32_t &t3) {
+        if (!isReply(buf, count)) {
+            return false;
+        }
+        t1 = read(buf + 2);
+        t2 = read(buf + 6);
+        t3 = read(buf + 10);
+        return true;
+    }
+
+private:
+    static void write(uint32_t value, uint8_t *out) {
+        out[0] = (uint8_t)value;
+        out[1] = (uint8_t)(value >> 8);
+        out[2] = (uint8_t)(value >> 16);
+        out[3] = (uint8_t)(value >> 24);
+    }
+
+    static uint32_t read(const uint8_t *in) {
+        return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    }
+};
+
+/**
+ * Clock Estimator
+ *
+ * Offset and drift of one sensor's micros() against ours, from ping
+ * replies. Offsets are sensor minus receiver and wrap with micros(), so
+ * they are only ever used as differences.
+ */
+class ClockEstimator {
+public:
+    ClockEstimator() {
+        reset();
+    }
+
+    void reset() {
+        count = 0;
+        next = 0;
+        synced = false;
+        anchored = false;
+        drift = 0;
+        resets = 0;
+    }
+
+    // t1 and t4 are ours, t2 and t3 the sensor's.
+    void addSample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) {
+        int32_t roundTrip = (int32_t)(t4 - t1) - (int32_t)(t3 - t2);
+        if (roundTrip < 0 || roundTrip > CLOCK_SYNC_STEP_US) {
+            return;
+        }
+
+        Sample sample;
+        sample.at = t4;
+        sample.offset = t2 - t1 - (uint32_t)roundTrip / 2;
+        sample.roundTrip = (uint32_t)roundTrip;
+
+        if (synced) {
+            int32_t step = (int32_t)(sample.offset - offsetAt(t4));
+            if (step > CLOCK_SYNC_STEP_US || step < -CLOCK_SYNC_STEP_US) {
+                restart(sample);
+                return;
+            }
+        }
+
+        samples[next] = sample;
+        next = (next + 1) % CLOCK_SYNC_WINDOW;
+        if (count < CLOCK_SYNC_WINDOW) {
+            count++;
+        }
+
+        const Sample *best = &samples[0];
+        for (uint8_t i = 1; i < count; i++) {
+            if (samples[i].roundTrip < best->roundTrip) {
+                best = &samples[i];
+            }
+        }
+
+        if (!anchored) {
+            anchor = *best;
+            anchored = true;
+        } else if (best->at - anchor.at >= CLOCK_SYNC_DRIFT_SPAN_MS * 1000UL) {
+            // Drift over the span, folded into the running value with a
+            // weight of 1/4 so one unlucky round trip does not swing it.
+            int64_t measured = ((int64_t)(int32_t)(best->offset - anchor.offset) << CLOCK_SYNC_DRIFT_SHIFT) /
+                               (int64_t)(best->at - anchor.at);
+            drift = drift == 0 ? (int32_t)measured : drift + (int32_t)((measured - drift) / 4);
+            anchor = *best;
+        }
+
+        base = *best;
+        synced = true;
+    }
+
+    bool isSynced() const {
+        return synced;
+    }
+
+    // The sensor's micros() at our time now.
+    uint32_t offsetAt(uint32_t now) const {
+        int64_t elapsed = (int32_t)(now - base.at);
+        return base.offset + (uint32_t)((elapsed * drift) >> CLOCK_SYNC_DRIFT_SHIFT);
+    }
+
+    // Our micros() for a sensor timestamp, now being about that time.
+    uint32_t toLocal(uint32_t sensorTime, uint32_t now) const {
+        return sensorTime - offsetAt(now);
+    }
+
+    // Sensor clock rate against ours in parts per million.
+    int32_t getDriftPpm() const {
+        return (int32_t)(((int64_t)drift * 1000000) >> CLOCK_SYNC_DRIFT_SHIFT);
+    }
+
+    uint32_t getRoundTrip() const {
+        return synced ? base.roundTrip : 0;
+    }
+
+    uint32_t getResets() const {
+        return resets;
+    }
+
+private:
+    struct Sample {
+        uint32_t at;
+        uint32_t offset;
+        uint32_t roundTrip;
+    };
+
+    Sample samples[CLOCK_SYNC_WINDOW];
+    uint8_t count;
+    uint8_t next;
+    bool synced;
+    bool anchored;
+    Sample base;
+    Sample anchor;
+    int32_t drift;
+    uint32_t resets;
+
+    void restart(const Sample &sample) {
+        samples[0] = sample;
+        count = 1;
+        next = 1 % CLOCK_SYNC_WINDOW;
+        anchor = sample;
+        base = sample;
+        drift = 0;
+        resets++;
+    }
+};
+
+#endif /* __CLOCKSYNC_H__ */
@@ -0,0 +1,116 @@
+#ifndef __DISCOVERY_H__
+#define __DISCOVERY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// -- Receiver discovery over ESP-NOW, shared by the edge sensors and the
+//    serial receiver. A sensor broadcasts a hello on a channel; every
+//    receiver that hears it broadcasts an announce carrying the hello's
+//    nonce, so neither side has to add the other as a peer before pairing.
+//
+//    hello:     0      1        2     3..6
+//               magic  version  type  nonce
+//    announce:  0      1        2     3..6   7        8         9      10           11..
+//               magic  version  type  nonce  channel  capacity  peers  name length  name
+//
+//    capacity is the number of sensors the receiver can still take, the
+//    asking sensor included if it is already known. The nonce is little
+//    endian. The magic can never be mistaken for a MidiFrame version.
+#define DISCOVERY_MAGIC 0xD5
+#define DISCOVERY_VERSION 1
+#define DISCOVERY_HELLO_LENGTH 7
+#define DISCOVERY_ANNOUNCE_HEADER_LENGTH 11
+#define DISCOVERY_MAX_NAME 16
+#define DISCOVERY_MAX_LENGTH (DISCOVERY_ANNOUNCE_HEADER_LENGTH + DISCOVERY_MAX_NAME)
+
+#define DISCOVERY_TYPE_HELLO 'H'
+#define DISCOVERY_TYPE_ANNOUNCE 'A'
+
+static const uint8_t DISCOVERY_BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+/**
+ * Discovery Announce
+ */
+struct DiscoveryAnnounce {
+    uint32_t nonce;
+    uint8_t channel;
+    uint8_t capacity;
+    uint8_t peers;
+    char name[DISCOVERY_MAX_NAME + 1];
+};
+
+/**
+ * Discovery codec
+ */
+class Discovery {
+public:
+    static bool isDiscovery(const uint8_t *buf, size_t count) {
+        return count >= 3 && buf[0] == DISCOVERY_MAGIC;
+    }
+
+    // buf must hold DISCOVERY_HELLO_LENGTH bytes.
+    static size_t encodeHello(uint32_t nonce, uint8_t *buf) {
+        writeHeader(DISCOVERY_TYPE_HELLO, nonce, buf);
+        return DISCOVERY_HELLO_LENGTH;
+    }
+
+    static bool decodeHello(const uint8_t *buf, size_t count, uint32_t &nonce) {
+        return count == DISCOVERY_HELLO_LENGTH && readHeader(buf, DISCOVERY_TYPE_HELLO, nonce);
+    }
+
+    // buf must hold DISCOVERY_MAX_LENGTH bytes. Longer names are cut.
+    static size_t encodeAnnounce(const DiscoveryAnnounce &announce, uint8_t *buf) {
+        size_t nameLength = strnlen(announce.name, DISCOVERY_MAX_NAME);
+
+        writeHeader(DISCOVERY_TYPE_ANNOUNCE, announce.nonce, buf);
+        buf[7] = announce.channel;
+        buf[8] = announce.capacity;
+        buf[9] = announce.peers;
+        buf[10] = (uint8_t)nameLength;
+        memcpy(buf + DISCOVERY_ANNOUNCE_HEADER_LENGTH, announce.name, nameLength);
+
+        return DISCOVERY_ANNOUNCE_HEADER_LENGTH + nameLength;
+    }
+
+    static bool decodeAnnounce(const uint8_t *buf, size_t count, DiscoveryAnnounce &announce) {
+        if (count < DISCOVERY_ANNOUNCE_HEADER_LENGTH || !readHeader(buf, DISCOVERY_TYPE_ANNOUNCE, announce.nonce)) {
+            return false;
+        }
+
+        uint8_t nameLength = buf[10];
+        if (nameLength > DISCOVERY_MAX_NAME || count != DISCOVERY_ANNOUNCE_HEADER_LENGTH + (size_t)nameLength) {
+            return false;
+        }
+
+        announce.channel = buf[7];
+        announce.capacity = buf[8];
+        announce.peers = buf[9];
+        memcpy(announce.name, buf + DISCOVERY_ANNOUNCE_HEADER_LENGTH, nameLength);
+        announce.name[nameLength] = '\0';
+
+        return true;
+    }
+
+private:
+    static void writeHeader(uint8_t type, uint32_t nonce, uint8_t *buf) {
+        buf[0] = DISCOVERY_MAGIC;
+        buf[1] = DISCOVERY_VERSION;
+        buf[2] = type;
+        buf[3] = (uint8_t)(nonce & 0xFF);
+        buf[4] = (uint8_t)(nonce >> 8);
+        buf[5] = (uint8_t)(nonce >> 16);
+        buf[6] = (uint8_t)(nonce >> 24);
+    }
+
+    static bool readHeader(const uint8_t *buf, uint8_t type, uint32_t &nonce) {
+        if (buf[0] != DISCOVERY_MAGIC || buf[1] != DISCOVERY_VERSION || buf[2] != type) {
+            return false;
+        }
+        nonce = (uint32_t)buf[3] | ((uint32_t)buf[4] << 8) | ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 24);
+        return true;
+    }
+};
+
+#endif /* __DISCOVERY_H__ */
@@ -0,0 +1,144 @@
+#ifndef __FRAMETRACE_H__
+#define __FRAMETRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+// -- Trace of received ESP-NOW frames. A trace file is TRACE_MAGIC followed
+//    by records, each:
+//
+//      0..3           4..9   10       11 .. 11+length-1
+//      timestamp (us) mac    length   frame bytes
+//
+//    Timestamps are little endian micros() of the receiver when the frame
+//    arrived. Frames longer than TRACE_SNAPLEN are cut, like pcap does.
+#define TRACE_MAGIC "HLT1"
+#define TRACE_MAGIC_LENGTH 4
+#define TRACE_RECORD_HEADER_LENGTH 11
+#define TRACE_SNAPLEN 96
+#define TRACE_MAX_RECORD_LENGTH (TRACE_RECORD_HEADER_LENGTH + TRACE_SNAPLEN)
+
+/**
+ * Trace Record
+ */
+struct TraceRecord {
+    uint32_t timestamp;
+    uint8_t mac[6];
+    uint8_t length;
+    uint8_t data[TRACE_SNAPLEN];
+};
+
+/**
+ * Frame Trace codec
+ */
+class FrameTrace {
+public:
+    // Writes the record into out, which must hold TRACE_MAX_RECORD_LENGTH
+    // bytes. Returns the number of bytes written.
+    static size_t encode(const TraceRecord &record, uint8_t *out) {
+        out[0] = (uint8_t)record.timestamp;
+        out[1] = (uint8_t)(record.timestamp >> 8);
+        out[2] = (uint8_t)(record.timestamp >> 16);
+        out[3] = (uint8_t)(record.timestamp >> 24);
+        memcpy(out + 4, record.mac, 6);
+        out[10] = record.length;
+        memcpy(out + TRACE_RECORD_HEADER_LENGTH, record.data, record.length);
+
+        return TRACE_RECORD_HEADER_LENGTH + record.length;
+    }
+
+    // Reads one record from in. Returns the number of bytes consumed, or 0
+    // if available does not hold a whole, valid record.
+    static size_t decode(const uint8_t *in, size_t available, TraceRecord &record) {
+        if (available < TRACE_RECORD_HEADER_LENGTH) {
+            return 0;
+        }
+
+        uint8_t length = in[10];
+        if (length > TRACE_SNAPLEN || available < (size_t)TRACE_RECORD_HEADER_LENGTH + length) {
+            return 0;
+        }
+
+        record.timestamp = (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+        memcpy(record.mac, in + 4, 6);
+        record.length = length;
+        memcpy(record.data, in + TRACE_RECORD_HEADER_LENGTH, length);
+
+        return TRACE_RECORD_HEADER_LENGTH + length;
+    }
+};
+
+/**
+ * Capture Ring
+ *
+ * Preallocated ring that always holds the last Slots received frames.
+ * record() is called from the receive callback; the reader pauses
+ * capture, walks the records oldest first with get(), then resumes.
+ * Frames arriving while paused are not captured.
+ */
+template<size_t Slots>
+class CaptureRing {
+public:
+    CaptureRing() : next(0), total(0), state(CAPTURE_IDLE) {}
+
+    void record(const uint8_t mac[6], const uint8_t *buf, size_t count, uint32_t now) {
+        uint8_t expected = CAPTURE_IDLE;
+        if (!state.compare_exchange_strong(expected, CAPTURE_WRITING, std::memory_order_acquire)) {
+            return;
+        }
+
+        TraceRecord &slot = records[next];
+        slot.timestamp = now;
+        memcpy(slot.mac, mac, 6);
+        slot.length = count < TRACE_SNAPLEN ? count : TRACE_SNAPLEN;
+        memcpy(slot.data, buf, slot.length);
+
+        next = (next + 1) % Slots;
+        total.fetch_add(1, std::memory_order_relaxed);
+        state.store(CAPTURE_IDLE, std::memory_order_release);
+    }
+
+    // Waits for a record() in progress to finish, then stops capturing.
+    void pause() {
+        uint8_t expected = CAPTURE_IDLE;
+        while (!state.compare_exchange_weak(expected, CAPTURE_PAUSED, std::memory_order_acquire)) {
+            expected = CAPTURE_IDLE;
+        }
+    }
+
+    void resume() {
+        state.store(CAPTURE_IDLE, std::memory_order_release);
+    }
+
+    size_t size() const {
+        uint32_t n = total.load(std::memory_order_acquire);
+        return n < Slots ? n : Slots;
+    }
+
+    // index 0 is the oldest record still held.
+    const TraceRecord &get(size_t index) const {
+        size_t first = total.load(std::memory_order_acquire) < Slots ? 0 : next;
+        return records[(first + index) % Slots];
+    }
+
+    uint32_t getTotal() const {
+        return total.load(std::memory_order_acquire);
+    }
+
+private:
+    enum {
+        CAPTURE_IDLE,
+        CAPTURE_WRITING,
+        CAPTURE_PAUSED,
+    };
+
+    TraceRecord records[Slots];
+    size_t next;
+    std::atomic<uint32_t> total;
+    std::atomic<uint8_t> state;
+};
+
+#endif /* __FRAMETRACE_H__ */
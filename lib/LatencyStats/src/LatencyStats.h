@@ -0,0 +1,180 @@
+#ifndef __LATENCYSTATS_H__
+#define __LATENCYSTATS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// -- Each power of two is split into LATENCY_SUB_BUCKETS buckets, so the
+//    relative error of a reported percentile is at most 1 / SUB_BUCKETS.
+//    24 powers of two cover everything up to ~16 s in microseconds.
+#define LATENCY_SUB_BUCKET_BITS 3
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAGNITUDES 24
+#define LATENCY_BUCKETS (LATENCY_MAGNITUDES * LATENCY_SUB_BUCKETS)
+
+/**
+ * Latency Histogram
+ *
+ * Fixed-size, log-bucketed histogram of microsecond samples.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() {
+        clear();
+    }
+
+    void clear() {
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        max = 0;
+    }
+
+    void record(uint32_t us) {
+        buckets[bucketFor(us)]++;
+        count++;
+        if (us > max) {
+            max = us;
+        }
+    }
+
+    // Upper bound of the bucket holding the given percentile (0-100).
+    uint32_t percentile(uint8_t p) const {
+        if (count == 0) {
+            return 0;
+        }
+
+        uint32_t rank = (uint32_t)(((uint64_t)count * p + 99) / 100);
+        if (rank == 0) {
+            rank = 1;
+        }
+
+        uint32_t seen = 0;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                uint32_t bound = upperBound(i);
+                return bound < max ? bound : max;
+            }
+        }
+
+        return max;
+    }
+
+    uint32_t getCount() const {
+        return count;
+    }
+
+    uint32_t getMax() const {
+        return max;
+    }
+
+private:
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+
+    static size_t bucketFor(uint32_t us) {
+        if (us < LATENCY_SUB_BUCKETS) {
+            return us;
+        }
+
+        uint8_t magnitude = 31 - __builtin_clz(us);
+        uint8_t sub = (us >> (magnitude - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+        size_t index = (magnitude - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+
+        return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+    }
+
+    static uint32_t upperBound(size_t index) {
+        if (index < LATENCY_SUB_BUCKETS) {
+            return index;
+        }
+
+        uint8_t magnitude = index / LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS - 1;
+        uint32_t sub = index % LATENCY_SUB_BUCKETS;
+        uint32_t width = 1UL << (magnitude - LATENCY_SUB_BUCKET_BITS);
+
+        return (1UL << magnitude) + (sub + 1) * width - 1;
+    }
+};
+
+/**
+ * Peer Link Stats
+ *
+ * Latency, loss and reordering seen on the link from one sensor. The
+ * sensor clock is not synchronized with ours, so latency is measured
+ * against the smallest (receive - send) offset seen so far: it is the
+ * delay on top of the fastest delivery, which is what jitter and retries
+ * add.
+ */
+class PeerLinkStats {
+public:
+    PeerLinkStats() {
+        clear();
+    }
+
+    void clear() {
+        latency.clear();
+        events = 0;
+        lost = 0;
+        reordered = 0;
+        expected = 0;
+        minOffset = 0;
+        started = false;
+    }
+
+    void record(uint16_t sequence, uint32_t sentAt, uint32_t receivedAt) {
+        events++;
+
+        int32_t offset = (int32_t)(receivedAt - sentAt);
+        if (!started || offset < minOffset) {
+            minOffset = offset;
+        }
+        latency.record((uint32_t)(offset - minOffset));
+
+        if (!started) {
+            started = true;
+            expected = sequence + 1;
+            return;
+        }
+
+        int16_t gap = (int16_t)(sequence - expected);
+        if (gap >= 0) {
+            lost += gap;
+            expected = sequence + 1;
+        } else {
+            reordered++;
+            if (lost > 0) {
+                lost--;
+            }
+        }
+    }
+
+    const LatencyHistogram &getLatency() const {
+        return latency;
+    }
+
+    uint32_t getEvents() const {
+        return events;
+    }
+
+    uint32_t getLost() const {
+        return lost;
+    }
+
+    uint32_t getReordered() const {
+        return reordered;
+    }
+
+private:
+    LatencyHistogram latency;
+    uint32_t events;
+    uint32_t lost;
+    uint32_t reordered;
+    uint16_t expected;
+    int32_t minOffset;
+    bool started;
+};
+
+#endif /* __LATENCYSTATS_H__ */
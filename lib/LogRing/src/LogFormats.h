@@ -0,0 +1,40 @@
+#ifndef __LOGFORMATS_H__
+#define __LOGFORMATS_H__
+
+// -- Every message that goes through a LogRing, shared by the firmwares
+//    and tools/hllog. The id of a format is its position, so formats are
+//    only ever appended. Arguments are 32 bit, formats may only use %u,
+//    %d, %x, %X and %c with flags and a width, no length modifiers.
+#define LOG_FORMATS(X) \
+    X(LOG_DROPPED, "%u log records dropped") \
+    X(LOG_PAD_ON, "Midi Pad %u Status: ON") \
+    X(LOG_PAD_OFF, "Midi Pad %u Status: OFF") \
+    X(LOG_SEND_QUEUE_FULL, "Send queue full, message dropped.") \
+    X(LOG_SEND_FAILED, "Message wasn't received.") \
+    X(LOG_SLAVE_LOST, "Slave lost, discovering.") \
+    X(LOG_SLAVE_NOT_FOUND, "Slave Not Found, trying again in %u ms.") \
+    X(LOG_READY, "Ready %u ms after boot.") \
+    X(LOG_SCAN_STARTED, "Scanning WiFi networks...") \
+    X(LOG_SCAN_FAILED, "scan failed") \
+    X(LOG_SCAN_DONE, "%d networks found") \
+    X(LOG_CONFIG_STORED, "Config stored: true") \
+    X(LOG_CONFIG_UNCHANGED, "Config stored: false") \
+    X(LOG_CONFIG_NOT_STORED, "Config could not be stored") \
+    X(LOG_FAILOVER, "Receiver lost, switched to the standby after %u ms.") \
+    X(LOG_SEND_STATS, "Sends: %u acked, %u retried, %u dropped, %u overflowed.") \
+    X(LOG_SEND_MIRRORED, "Sends: %u mirrored to the standby.") \
+    X(LOG_STANDBY_LOST, "Standby lost after %u unacked copies.")
+
+#define LOG_FORMAT_ID(id, text) id,
+#define LOG_FORMAT_TEXT(id, text) text,
+
+enum LogFormat {
+    LOG_FORMATS(LOG_FORMAT_ID)
+    LOG_FORMAT_COUNT
+};
+
+static const char *const logFormats[LOG_FORMAT_COUNT] = {
+    LOG_FORMATS(LOG_FORMAT_TEXT)
+};
+
+#endif /* __LOGFORMATS_H__ */
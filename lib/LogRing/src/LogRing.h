@@ -0,0 +1,164 @@
+#ifndef __LOGRING_H__
+#define __LOGRING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <SpscRing.h>
+
+#include "LogFormats.h"
+
+// -- A record is a format id from LogFormats.h, the micros() it was logged
+//    at and up to LOG_MAX_ARGS 32 bit arguments. On the wire:
+//
+//    0      1       2      3..6  7..           last
+//    magic  format  count  at    args (count)  sum
+//
+//    All values little endian; sum is the low byte of the sum of every
+//    byte before it. The magic never occurs in the ASCII text printed
+//    around records, so a reader can pass text through and pick the
+//    records out of the same stream.
+#define LOG_MAGIC 0xFE
+#define LOG_MAX_ARGS 4
+#define LOG_RECORD_HEADER_LENGTH 7
+#define LOG_RECORD_MAX_LENGTH (LOG_RECORD_HEADER_LENGTH + 4 * LOG_MAX_ARGS + 1)
+
+// -- Longest line format() produces, terminator included.
+#define LOG_LINE_LENGTH 128
+
+struct LogRecord {
+    uint32_t at;
+    uint8_t format;
+    uint8_t count;
+    uint32_t args[LOG_MAX_ARGS];
+};
+
+/**
+ * Log Record codec
+ */
+class LogCodec {
+public:
+    // buf must hold LOG_RECORD_MAX_LENGTH bytes.
+    static size_t encode(const LogRecord &record, uint8_t *buf) {
+        size_t length = 0;
+        buf[length++] = LOG_MAGIC;
+        buf[length++] = record.format;
+        buf[length++] = record.count;
+        write(record.at, buf + length);
+        length += 4;
+        for (uint8_t i = 0; i < record.count; i++) {
+            write(record.args[i], buf + length);
+            length += 4;
+        }
+        buf[length] = sum(buf, length);
+        return length + 1;
+    }
+
+    // Bytes a record starting at buf takes, 0 if buf does not start one or
+    // it is not complete yet.
+    static size_t decode(const uint8_t *buf, size_t count, LogRecord &record) {
+        if (count < LOG_RECORD_HEADER_LENGTH || buf[0] != LOG_MAGIC || buf[2] > LOG_MAX_ARGS) {
+            return 0;
+        }
+
+        size_t length = LOG_RECORD_HEADER_LENGTH + 4 * buf[2];
+        if (count < length + 1 || buf[length] != sum(buf, length)) {
+            return 0;
+        }
+
+        record.format = buf[1];
+        record.count = buf[2];
+        record.at = read(buf + 3);
+        for (uint8_t i = 0; i < record.count; i++) {
+            record.args[i] = read(buf + LOG_RECORD_HEADER_LENGTH + 4 * i);
+        }
+        return length + 1;
+    }
+
+    // Rebuilds the text of a record, without a line ending. Returns the
+    // length written to out, which is always terminated.
+    static size_t format(const LogRecord &record, char *out, size_t size) {
+        uint32_t args[LOG_MAX_ARGS] = {0};
+        memcpy(args, record.args, record.count * sizeof(args[0]));
+
+        int length;
+        if (record.format < LOG_FORMAT_COUNT) {
+            length = snprintf(out, size, logFormats[record.format],
+                              (unsigned)args[0], (unsigned)args[1], (unsigned)args[2], (unsigned)args[3]);
+        } else {
+            length = snprintf(out, size, "unknown log format %u", record.format);
+        }
+
+        if (length < 0) {
+            out[0] = '\0';
+            return 0;
+        }
+        return (size_t)length < size ? length : size - 1;
+    }
+
+private:
+    static uint8_t sum(const uint8_t *buf, size_t length) {
+        uint8_t value = 0;
+        while (length--) {
+            value += *buf++;
+        }
+        return value;
+    }
+
+    static void write(uint32_t value, uint8_t *out) {
+        out[0] = (uint8_t)value;
+        out[1] = (uint8_t)(value >> 8);
+        out[2] = (uint8_t)(value >> 16);
+        out[3] = (uint8_t)(value >> 24);
+    }
+
+    static uint32_t read(const uint8_t *in) {
+        return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    }
+};
+
+/**
+ * Log Ring
+ *
+ * Deferred logging: log() only copies a format id and its arguments into
+ * a lock-free ring, formatting and the serial port are left to whoever
+ * drains it. Records logged while the ring is full are counted and lost.
+ * Like SpscRing, log() must only be called from one context and pop()
+ * from one other.
+ */
+template<size_t Capacity>
+class LogRing {
+public:
+    template<typename... Args>
+    bool log(uint32_t at, LogFormat format, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+
+        uint32_t values[] = {(uint32_t)args..., 0};
+        LogRecord record;
+        record.at = at;
+        record.format = format;
+        record.count = sizeof...(Args);
+        memcpy(record.args, values, sizeof...(Args) * sizeof(values[0]));
+
+        return ring.push(record);
+    }
+
+    bool pop(LogRecord &record) {
+        return ring.pop(record);
+    }
+
+    uint32_t getDropped() const {
+        return ring.getOverflows();
+    }
+
+    size_t getHighWater() const {
+        return ring.getHighWater();
+    }
+
+private:
+    SpscRing<LogRecord, Capacity> ring;
+};
+
+#endif /* __LOGRING_H__ */
@@ -0,0 +1,292 @@
+#ifndef __MIDIFRAME_H__
+#define __MIDIFRAME_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// -- Wire format shared by the edge sensors and the serial receiver.
+//    A frame is a header followed by one or more 4 byte events. Every
+//    field is a single byte except the sequence number and the timestamp,
+//    which are little endian and belong to the first event; event i
+//    carries sequence + i. The timestamp is the sender's micros() when the
+//    first event was raised, later events add their own offset to it in
+//    MIDI_EVENT_OFFSET_UNIT_US steps, so the receiver can play a batch
+//    back with the spacing it was played in. The first event's offset is
+//    always 0.
+//
+//    header:  0        1      2..3       4       5..8
+//             version  flags  sequence   count   timestamp
+//    event:   0        1      2          3    4
+//             status   note   velocity   pad  offset
+#define MIDI_FRAME_VERSION 4
+#define MIDI_FRAME_HEADER_LENGTH 9
+#define MIDI_EVENT_LENGTH 5
+#define MIDI_EVENT_OFFSET_UNIT_US 16
+#define MIDI_FRAME_MAX_EVENTS 16
+#define MIDI_FRAME_MAX_LENGTH (MIDI_FRAME_HEADER_LENGTH + MIDI_FRAME_MAX_EVENTS * MIDI_EVENT_LENGTH)
+
+#define MIDI_STATUS_NOTE_OFF 0x80
+#define MIDI_STATUS_NOTE_ON 0x90
+
+// -- A sensor copies every frame its receiver acked to a standby receiver
+//    with MIDI_FLAG_STANDBY set. The standby follows the notes without
+//    playing them, until frames come in without the flag.
+#define MIDI_FLAG_STANDBY 0x01
+
+// -- A sensor also sends the notes it holds now and then, so the receiver
+//    can release notes whose note-off was lost:
+//
+//    heartbeat:  0      1..2       3..18
+//                magic  sequence   held notes, note n is bit n%8 of byte 3+n/8
+//
+//    sequence is the one the sensor's next event will carry, so the
+//    receiver can tell a heartbeat overtaken by later events. Copies for
+//    a standby receiver carry MIDI_HEARTBEAT_STANDBY_MAGIC instead. The
+//    magics never match MIDI_FRAME_VERSION.
+#define MIDI_HEARTBEAT_MAGIC 0xB3
+#define MIDI_HEARTBEAT_STANDBY_MAGIC 0xB4
+#define MIDI_HEARTBEAT_LENGTH 19
+
+enum FrameResult {
+    FRAME_OK = 0,
+    FRAME_TOO_SHORT,
+    FRAME_TOO_LONG,
+    FRAME_BAD_VERSION,
+    FRAME_BAD_STATUS,
+    FRAME_BAD_DATA,
+    FRAME_RESULT_COUNT
+};
+
+/**
+ * Midi Event
+ */
+struct MidiEvent {
+    uint8_t status;
+    uint8_t note;
+    uint8_t velocity;
+    uint8_t pad;
+    uint16_t sequence;
+    uint8_t flags;
+    uint32_t timestamp;
+};
+
+/**
+ * Midi Note Set
+ *
+ * One bit per MIDI note.
+ */
+struct MidiNoteSet {
+    uint32_t bits[4];
+
+    void clear() {
+        bits[0] = bits[1] = bits[2] = bits[3] = 0;
+    }
+
+    void set(uint8_t note) {
+        bits[(note >> 5) & 3] |= 1UL << (note & 31);
+    }
+
+    void reset(uint8_t note) {
+        bits[(note >> 5) & 3] &= ~(1UL << (note & 31));
+    }
+
+    bool test(uint8_t note) const {
+        return bits[(note >> 5) & 3] & (1UL << (note & 31));
+    }
+
+    bool any() const {
+        return (bits[0] | bits[1] | bits[2] | bits[3]) != 0;
+    }
+};
+
+/**
+ * Midi Heartbeat codec
+ */
+class MidiHeartbeat {
+public:
+    // buf must hold MIDI_HEARTBEAT_LENGTH bytes.
+    static size_t encode(uint16_t sequence, const MidiNoteSet &held, uint8_t *buf) {
+        buf[0] = MIDI_HEARTBEAT_MAGIC;
+        buf[1] = (uint8_t)(sequence & 0xFF);
+        buf[2] = (uint8_t)(sequence >> 8);
+        for (uint8_t i = 0; i < 16; i++) {
+            buf[3 + i] = (uint8_t)(held.bits[i >> 2] >> ((i & 3) * 8));
+        }
+
+        return MIDI_HEARTBEAT_LENGTH;
+    }
+
+    static bool decode(const uint8_t *buf, size_t count, uint16_t &sequence, MidiNoteSet &held) {
+        if (count != MIDI_HEARTBEAT_LENGTH || (buf[0] != MIDI_HEARTBEAT_MAGIC && buf[0] != MIDI_HEARTBEAT_STANDBY_MAGIC)) {
+            return false;
+        }
+
+        sequence = (uint16_t)(buf[1] | (buf[2] << 8));
+        held.clear();
+        for (uint8_t i = 0; i < 16; i++) {
+            held.bits[i >> 2] |= (uint32_t)buf[3 + i] << ((i & 3) * 8);
+        }
+
+        return true;
+    }
+
+    // Only meaningful for a buffer decode() accepted.
+    static bool isStandby(const uint8_t *buf) {
+        return buf[0] == MIDI_HEARTBEAT_STANDBY_MAGIC;
+    }
+};
+
+/**
+ * Midi Frame codec
+ */
+class MidiFrame {
+public:
+    // Writes count events into buf, which must hold MIDI_FRAME_MAX_LENGTH
+    // bytes. Sequence, flags and timestamp are taken from the first event.
+    static size_t encode(const MidiEvent *events, uint8_t count, uint8_t *buf) {
+        buf[0] = MIDI_FRAME_VERSION;
+        buf[1] = events[0].flags;
+        buf[2] = (uint8_t)(events[0].sequence & 0xFF);
+        buf[3] = (uint8_t)(events[0].sequence >> 8);
+        buf[4] = count;
+        buf[5] = (uint8_t)(events[0].timestamp & 0xFF);
+        buf[6] = (uint8_t)(events[0].timestamp >> 8);
+        buf[7] = (uint8_t)(events[0].timestamp >> 16);
+        buf[8] = (uint8_t)(events[0].timestamp >> 24);
+
+        uint8_t *out = buf + MIDI_FRAME_HEADER_LENGTH;
+        for (uint8_t i = 0; i < count; i++) {
+            uint32_t offset = (events[i].timestamp - events[0].timestamp) / MIDI_EVENT_OFFSET_UNIT_US;
+            out[0] = events[i].status;
+            out[1] = events[i].note & 0x7F;
+            out[2] = events[i].velocity & 0x7F;
+            out[3] = events[i].pad;
+            out[4] = offset < 0xFF ? (uint8_t)offset : 0xFF;
+            out += MIDI_EVENT_LENGTH;
+        }
+
+        return MIDI_FRAME_HEADER_LENGTH + count * MIDI_EVENT_LENGTH;
+    }
+
+    // Turns an encoded frame or heartbeat into its copy for a standby
+    // receiver. Returns false for anything else.
+    static bool markStandby(uint8_t *buf, size_t count) {
+        if (count == MIDI_HEARTBEAT_LENGTH && buf[0] == MIDI_HEARTBEAT_MAGIC) {
+            buf[0] = MIDI_HEARTBEAT_STANDBY_MAGIC;
+            return true;
+        }
+        if (count > MIDI_FRAME_HEADER_LENGTH && buf[0] == MIDI_FRAME_VERSION) {
+            buf[1] |= MIDI_FLAG_STANDBY;
+            return true;
+        }
+        return false;
+    }
+
+    // Reads a frame straight out of the receive buffer without copying it.
+    // Only the header decides how much of buf is touched; the events are
+    // then validated without branching so the cost only depends on the
+    // event count. events must hold MIDI_FRAME_MAX_EVENTS entries and is
+    // only meaningful when FRAME_OK is returned.
+    static FrameResult decode(const uint8_t *buf, size_t count, MidiEvent *events, uint8_t &eventCount) {
+        eventCount = 0;
+
+        if (buf == NULL || count < MIDI_FRAME_HEADER_LENGTH + MIDI_EVENT_LENGTH) {
+            return FRAME_TOO_SHORT;
+        }
+        if (count > MIDI_FRAME_MAX_LENGTH) {
+            return FRAME_TOO_LONG;
+        }
+
+        uint8_t n = buf[4];
+        size_t expected = MIDI_FRAME_HEADER_LENGTH + n * MIDI_EVENT_LENGTH;
+        if (n == 0 || count < expected) {
+            return FRAME_TOO_SHORT;
+        }
+        if (n > MIDI_FRAME_MAX_EVENTS || count > expected) {
+            return FRAME_TOO_LONG;
+        }
+
+        uint8_t flags = buf[1];
+        uint16_t sequence = (uint16_t)(buf[2] | (buf[3] << 8));
+        uint32_t timestamp = (uint32_t)buf[5] | ((uint32_t)buf[6] << 8) | ((uint32_t)buf[7] << 16) | ((uint32_t)buf[8] << 24);
+        unsigned badStatus = 0;
+        unsigned badData = buf[MIDI_FRAME_HEADER_LENGTH + 4] != 0;
+
+        const uint8_t *in = buf + MIDI_FRAME_HEADER_LENGTH;
+        for (uint8_t i = 0; i < n; i++) {
+            uint8_t kind = in[0] & 0xF0;
+            badStatus |= (kind != MIDI_STATUS_NOTE_OFF) & (kind != MIDI_STATUS_NOTE_ON);
+            badData |= ((in[1] | in[2]) & 0x80) != 0;
+
+            events[i].status = in[0];
+            events[i].note = in[1];
+            events[i].velocity = in[2];
+            events[i].pad = in[3];
+            events[i].sequence = sequence + i;
+            events[i].flags = flags;
+            events[i].timestamp = timestamp + in[4] * MIDI_EVENT_OFFSET_UNIT_US;
+            in += MIDI_EVENT_LENGTH;
+        }
+
+        // The first failing check wins, version before status before data.
+        unsigned result = badData * FRAME_BAD_DATA;
+        result = badStatus ? (unsigned)FRAME_BAD_STATUS : result;
+        result = buf[0] != MIDI_FRAME_VERSION ? (unsigned)FRAME_BAD_VERSION : result;
+
+        if (result == FRAME_OK) {
+            eventCount = n;
+        }
+
+        return (FrameResult)result;
+    }
+};
+
+/**
+ * Midi Batch
+ *
+ * Collects events raised close together so they can share one frame.
+ * The owner decides when the batch window has passed and calls encode().
+ */
+class MidiBatch {
+public:
+    MidiBatch() {}
+
+    bool add(const MidiEvent &event, unsigned long now) {
+        if (count == MIDI_FRAME_MAX_EVENTS) {
+            return false;
+        }
+
+        if (count == 0) {
+            startedAt = now;
+        }
+        events[count++] = event;
+
+        return true;
+    }
+
+    size_t encode(uint8_t *buf) {
+        size_t length = MidiFrame::encode(events, count, buf);
+        count = 0;
+
+        return length;
+    }
+
+    bool isEmpty() {
+        return count == 0;
+    }
+
+    bool isFull() {
+        return count == MIDI_FRAME_MAX_EVENTS;
+    }
+
+    unsigned long getStartedAt() {
+        return startedAt;
+    }
+
+private:
+    MidiEvent events[MIDI_FRAME_MAX_EVENTS];
+    uint8_t count = 0;
+    unsigned long startedAt = 0;
+};
+
+#endif /* __MIDIFRAME_H__ */
@@ -0,0 +1,82 @@
+#ifndef __NATIVEHAL_ARDUINO_H__
+#define __NATIVEHAL_ARDUINO_H__
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HardwareSerial.h"
+#include "IPAddress.h"
+#include "NativeHal.h"
+#include "WString.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define INPUT_PULLUP 0x05
+
+#define PROGMEM
+#define PGM_P const char *
+#define F(string_literal) (string_literal)
+#define FPSTR(pstr_pointer) (pstr_pointer)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+inline unsigned long micros() {
+    return (unsigned long)(NativeHal::nanos() / 1000);
+}
+
+inline unsigned long millis() {
+    return (unsigned long)(NativeHal::nanos() / 1000000);
+}
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    if (mode == INPUT_PULLUP && NativeHal::getPinLevel(pin) < 0) {
+        NativeHal::setPinLevel(pin, HIGH);
+    }
+}
+
+inline int digitalRead(uint8_t pin) {
+    return NativeHal::getPinLevel(pin) == LOW ? LOW : HIGH;
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    NativeHal::setPinLevel(pin, level);
+}
+
+inline uint32_t esp_random() {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+inline uint16_t touchRead(uint8_t pin) {
+    return NativeHal::getTouchValue(pin);
+}
+
+/**
+ * ESP
+ */
+class EspClass {
+public:
+    void restart();
+    uint32_t getFreeHeap() { return 320 * 1024; }
+    uint32_t getCycleCount() { return (uint32_t)(NativeHal::nanos() * 240 / 1000); }
+};
+
+extern EspClass ESP;
+
+#endif /* __NATIVEHAL_ARDUINO_H__ */
@@ -0,0 +1,32 @@
+#ifndef __NATIVEHAL_DNSSERVER_H__
+#define __NATIVEHAL_DNSSERVER_H__
+
+#include "Arduino.h"
+
+enum class DNSReplyCode {
+    NoError = 0,
+    FormError = 1,
+    ServerFailure = 2,
+    NonExistentDomain = 3,
+    NotImplemented = 4,
+    Refused = 5,
+};
+
+/**
+ * DNS Server, answers nothing
+ */
+class DNSServer {
+public:
+    void setErrorReplyCode(const DNSReplyCode &replyCode) { (void)replyCode; }
+    void setTTL(const uint32_t ttl) { (void)ttl; }
+    bool start(const uint16_t port, const String &domainName, const IPAddress &resolvedIP) {
+        (void)port;
+        (void)domainName;
+        (void)resolvedIP;
+        return true;
+    }
+    void processNextRequest() {}
+    void stop() {}
+};
+
+#endif /* __NATIVEHAL_DNSSERVER_H__ */
@@ -0,0 +1,61 @@
+#ifndef __NATIVEHAL_EEPROM_H__
+#define __NATIVEHAL_EEPROM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Arduino.h"
+
+/**
+ * EEPROM
+ *
+ * Emulated sector kept in memory. When HL_EEPROM names a file, begin()
+ * loads it and commit() writes the whole sector back, like the ESP32
+ * core does with its flash partition.
+ */
+class EEPROMClass {
+public:
+    bool begin(size_t size);
+    void end() { commit(); }
+    uint8_t read(int address) { return address >= 0 && (size_t)address < data.size() ? data[address] : 0; }
+    void write(int address, uint8_t value) {
+        if (address >= 0 && (size_t)address < data.size()) {
+            data[address] = value;
+        }
+    }
+    bool commit();
+    uint16_t length() { return data.size(); }
+    uint8_t *getDataPtr() { return data.data(); }
+
+    template<typename T>
+    T &get(int address, T &t) {
+        if (address >= 0 && address + sizeof(T) <= data.size()) {
+            memcpy((uint8_t *)&t, &data[address], sizeof(T));
+        }
+        return t;
+    }
+
+    template<typename T>
+    const T &put(int address, const T &t) {
+        if (address >= 0 && address + sizeof(T) <= data.size()) {
+            memcpy(&data[address], (const uint8_t *)&t, sizeof(T));
+        }
+        return t;
+    }
+
+    // -- Simulation hooks, not part of the library.
+    unsigned long getCommitCount() const { return commits; }
+    unsigned long getBytesCommitted() const { return bytesCommitted; }
+
+private:
+    std::vector<uint8_t> data;
+    unsigned long commits = 0;
+    unsigned long bytesCommitted = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* __NATIVEHAL_EEPROM_H__ */
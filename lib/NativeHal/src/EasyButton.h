@@ -0,0 +1,99 @@
+#ifndef __NATIVEHAL_EASYBUTTON_H__
+#define __NATIVEHAL_EASYBUTTON_H__
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "Arduino.h"
+
+/**
+ * EasyButton
+ *
+ * Debounced press/release tracking with the same callbacks as the
+ * EasyButton library. Reads the pin level set through NativeHal.
+ */
+class EasyButtonBase {
+public:
+    typedef std::function<void()> callback_t;
+
+    EasyButtonBase(uint32_t debounceTime, bool invert) : debounceTime(debounceTime), invert(invert) {}
+    virtual ~EasyButtonBase() {}
+
+    void onPressed(callback_t callback) { pressedCallback = callback; }
+    void onPressedFor(uint32_t duration, callback_t callback) {
+        heldDuration = duration;
+        heldCallback = callback;
+    }
+
+    bool read() {
+        uint32_t now = millis();
+        bool pressed = readPressed();
+
+        if (now - lastChange < debounceTime) {
+            changed = false;
+            return current;
+        }
+
+        changed = pressed != current;
+        if (changed) {
+            current = pressed;
+            lastChange = now;
+            heldFired = false;
+            if (!current && pressedCallback) {
+                pressedCallback();
+            }
+        }
+
+        if (current && heldCallback && !heldFired && now - lastChange >= heldDuration) {
+            heldFired = true;
+            heldCallback();
+        }
+
+        return current;
+    }
+
+    bool isPressed() { return current; }
+    bool isReleased() { return !current; }
+    bool wasPressed() { return changed && current; }
+    bool wasReleased() { return changed && !current; }
+    bool pressedFor(uint32_t duration) { return current && millis() - lastChange >= duration; }
+
+protected:
+    virtual bool readPressed() = 0;
+
+    uint32_t debounceTime;
+    bool invert;
+
+private:
+    bool current = false;
+    bool changed = false;
+    bool heldFired = false;
+    uint32_t lastChange = 0;
+    uint32_t heldDuration = 0;
+    callback_t pressedCallback;
+    callback_t heldCallback;
+};
+
+class EasyButton : public EasyButtonBase {
+public:
+    EasyButton(uint8_t pin, uint32_t debounceTime = 35, bool pullupEnable = true, bool invert = true)
+        : EasyButtonBase(debounceTime, invert), pin(pin) {
+        if (pullupEnable) {
+            pinMode(pin, INPUT_PULLUP);
+        }
+    }
+
+    void begin() {}
+
+protected:
+    bool readPressed() {
+        bool level = digitalRead(pin) == HIGH;
+        return invert ? !level : level;
+    }
+
+private:
+    uint8_t pin;
+};
+
+#endif /* __NATIVEHAL_EASYBUTTON_H__ */
@@ -0,0 +1,27 @@
+#ifndef __NATIVEHAL_EASYBUTTONTOUCH_H__
+#define __NATIVEHAL_EASYBUTTONTOUCH_H__
+
+#include "EasyButton.h"
+
+/**
+ * EasyButtonTouch, pressed while touchRead() is below the threshold
+ */
+class EasyButtonTouch : public EasyButtonBase {
+public:
+    EasyButtonTouch(uint8_t pin, uint32_t debounceTime = 35, uint16_t threshold = 50)
+        : EasyButtonBase(debounceTime, false), pin(pin), threshold(threshold) {}
+
+    void begin() {}
+    void setThreshold(uint16_t threshold) { this->threshold = threshold; }
+
+protected:
+    bool readPressed() {
+        return touchRead(pin) < threshold;
+    }
+
+private:
+    uint8_t pin;
+    uint16_t threshold;
+};
+
+#endif /* __NATIVEHAL_EASYBUTTONTOUCH_H__ */
@@ -0,0 +1,91 @@
+#ifndef __NATIVEHAL_FS_H__
+#define __NATIVEHAL_FS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+
+#include "Arduino.h"
+
+/**
+ * File backed by a host file
+ */
+class File : public Stream {
+public:
+    File() {}
+    File(FILE *fp, const char *path) : fp(fp, fclose), path(path) {}
+
+    operator bool() const { return (bool)fp; }
+
+    size_t size() const {
+        if (!fp) {
+            return 0;
+        }
+        long pos = ftell(fp.get());
+        fseek(fp.get(), 0, SEEK_END);
+        long end = ftell(fp.get());
+        fseek(fp.get(), pos, SEEK_SET);
+        return end;
+    }
+
+    int available() { return fp ? (int)(size() - ftell(fp.get())) : 0; }
+    int read() { return fp ? fgetc(fp.get()) : -1; }
+    size_t read(uint8_t *buf, size_t size) { return fp ? fread(buf, 1, size, fp.get()) : 0; }
+    int peek() {
+        if (!fp) {
+            return -1;
+        }
+        int c = fgetc(fp.get());
+        if (c != EOF) {
+            ungetc(c, fp.get());
+        }
+        return c;
+    }
+    bool seek(uint32_t pos) { return fp && fseek(fp.get(), pos, SEEK_SET) == 0; }
+
+    using Print::write;
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size) { return fp ? fwrite(buf, 1, size, fp.get()) : 0; }
+
+    const char *name() const { return path.c_str(); }
+    void close() { fp.reset(); }
+
+private:
+    std::shared_ptr<FILE> fp;
+    String path;
+};
+
+namespace fs {
+    typedef ::File File;
+
+    /**
+     * File system rooted at a host directory
+     */
+    class FS {
+    public:
+        FS(const char *root) : root(root) {}
+
+        File open(const char *path, const char *mode = "r") {
+            String full = root + path;
+            FILE *fp = fopen(full.c_str(), mode[0] == 'w' ? "wb" : (mode[0] == 'a' ? "ab" : "rb"));
+            return fp ? File(fp, path) : File();
+        }
+
+        File open(const String &path, const char *mode = "r") {
+            return open(path.c_str(), mode);
+        }
+
+        bool exists(const char *path) {
+            return (bool)open(path);
+        }
+
+        void setRoot(const char *root) { this->root = root; }
+
+    protected:
+        String root;
+    };
+}
+
+#endif /* __NATIVEHAL_FS_H__ */
@@ -0,0 +1,137 @@
+#ifndef __NATIVEHAL_HARDWARESERIAL_H__
+#define __NATIVEHAL_HARDWARESERIAL_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <deque>
+
+#include "IPAddress.h"
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/**
+ * Print
+ */
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buf++);
+        }
+        return n;
+    }
+    size_t write(const char *str) {
+        return str ? write((const uint8_t *)str, strlen(str)) : 0;
+    }
+
+    size_t print(const char *str) { return write(str); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n, int base = DEC) { return print(String((long)n, base)); }
+    size_t print(unsigned int n, int base = DEC) { return print(String((unsigned long)n, base)); }
+    size_t print(long n, int base = DEC) { return print(String(n, base)); }
+    size_t print(unsigned long n, int base = DEC) { return print(String(n, base)); }
+    size_t print(double n, int digits = 2) { return print(String(n, digits)); }
+    size_t print(const IPAddress &ip) { return print(ip.toString()); }
+
+    size_t println() { return write("\r\n"); }
+    template<typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+    template<typename T>
+    size_t println(const T &value, int format) { return print(value, format) + println(); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if (len < 0) {
+            return 0;
+        }
+        return write((const uint8_t *)buf, (size_t)len < sizeof(buf) ? len : sizeof(buf) - 1);
+    }
+};
+
+/**
+ * Stream
+ */
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+};
+
+/**
+ * Hardware Serial
+ *
+ * UART 0 is written to stdout, other UARTs are discarded. Bytes fed
+ * through inject() can be read back like data arriving on the RX pin.
+ * Writes may come from any thread, reads only from loop().
+ */
+class HardwareSerial : public Stream {
+public:
+    HardwareSerial(int uartNr) : uartNr(uartNr), baudRate(0) {}
+
+    void begin(unsigned long baud, uint32_t config = 0, int8_t rxPin = -1, int8_t txPin = -1) {
+        (void)config;
+        (void)rxPin;
+        (void)txPin;
+        baudRate = baud;
+    }
+    void end() { baudRate = 0; }
+    void updateBaudRate(unsigned long baud) { baudRate = baud; }
+    unsigned long getBaudRate() const { return baudRate; }
+
+    int available() { return rx.size(); }
+    int read() {
+        if (rx.empty()) {
+            return -1;
+        }
+        uint8_t c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+    int peek() { return rx.empty() ? -1 : rx.front(); }
+    void flush() { fflush(stdout); }
+
+    using Print::write;
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size) {
+        bytesWritten += size;
+        if (uartNr == 0) {
+            return fwrite(buf, 1, size, stdout);
+        }
+        return size;
+    }
+
+    operator bool() const { return true; }
+
+    void inject(const uint8_t *buf, size_t size) { rx.insert(rx.end(), buf, buf + size); }
+    unsigned long getBytesWritten() const { return bytesWritten; }
+
+private:
+    int uartNr;
+    unsigned long baudRate;
+    std::atomic<unsigned long> bytesWritten{0};
+    std::deque<uint8_t> rx;
+};
+
+extern HardwareSerial Serial;
+
+#endif /* __NATIVEHAL_HARDWARESERIAL_H__ */
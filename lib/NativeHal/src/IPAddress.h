@@ -0,0 +1,36 @@
+#ifndef __NATIVEHAL_IPADDRESS_H__
+#define __NATIVEHAL_IPADDRESS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "WString.h"
+
+/**
+ * IP Address
+ *
+ * Stored in network order like the ESP32 core, so the uint32_t view has
+ * the first octet in the low byte.
+ */
+class IPAddress {
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        address = (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+    }
+    IPAddress(uint32_t address) : address(address) {}
+
+    operator uint32_t() const { return address; }
+    uint8_t operator[](int index) const { return (address >> (8 * index)) & 0xFF; }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(buf);
+    }
+
+private:
+    uint32_t address;
+};
+
+#endif /* __NATIVEHAL_IPADDRESS_H__ */
@@ -0,0 +1,70 @@
+#ifndef __NATIVEHAL_MIDI_H__
+#define __NATIVEHAL_MIDI_H__
+
+#include <stdint.h>
+
+#include "Arduino.h"
+
+#define MIDI_CHANNEL_OMNI 0
+#define MIDI_CHANNEL_OFF 17
+
+namespace midi {
+    typedef uint8_t DataByte;
+    typedef uint8_t Channel;
+
+    struct DefaultSettings {
+        static const bool UseRunningStatus = false;
+        static const bool HandleNullVelocityNoteOnAsNoteOff = true;
+        static const bool Use1ByteParsing = true;
+        static const long BaudRate = 31250;
+        static const unsigned SysExMaxSize = 128;
+    };
+
+    /**
+     * MIDI interface writing the same bytes as the MIDI Library
+     */
+    template<class SerialPort, class Settings = DefaultSettings>
+    class MidiInterface {
+    public:
+        MidiInterface(SerialPort &serial) : serial(serial) {}
+
+        void begin(Channel inChannel = 1) {
+            (void)inChannel;
+            serial.begin(Settings::BaudRate);
+        }
+
+        bool read() { return false; }
+
+        void sendNoteOn(DataByte note, DataByte velocity, Channel channel) {
+            send(0x90, note, velocity, channel);
+        }
+
+        void sendNoteOff(DataByte note, DataByte velocity, Channel channel) {
+            send(0x80, note, velocity, channel);
+        }
+
+        void sendControlChange(DataByte number, DataByte value, Channel channel) {
+            send(0xB0, number, value, channel);
+        }
+
+    private:
+        SerialPort &serial;
+
+        void send(uint8_t type, DataByte data1, DataByte data2, Channel channel) {
+            if (channel == 0 || channel > 16) {
+                return;
+            }
+            serial.write((uint8_t)(type | ((channel - 1) & 0x0F)));
+            serial.write((uint8_t)(data1 & 0x7F));
+            serial.write((uint8_t)(data2 & 0x7F));
+        }
+    };
+}
+
+#define MIDI_CREATE_CUSTOM_INSTANCE(Type, SerialPort, Name, Settings) \
+    midi::MidiInterface<Type, Settings> Name((Type &)SerialPort);
+
+#define MIDI_CREATE_INSTANCE(Type, SerialPort, Name) \
+    midi::MidiInterface<Type> Name((Type &)SerialPort);
+
+#endif /* __NATIVEHAL_MIDI_H__ */
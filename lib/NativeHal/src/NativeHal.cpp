@@ -0,0 +1,586 @@
+#include "NativeHal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "SPIFFS.h"
+#include "WiFi.h"
+#include "WifiEspNow.h"
+
+#include <FrameTrace.h>
+#include <Discovery.h>
+
+HardwareSerial Serial(0);
+EspClass ESP;
+WiFiClass WiFi;
+WifiEspNowClass WifiEspNow;
+EEPROMClass EEPROM;
+SPIFFSFS SPIFFS;
+
+void setup();
+void loop();
+
+namespace {
+    const int PIN_COUNT = 40;
+
+    std::chrono::steady_clock::time_point startTime;
+    bool virtualClock = false;
+    uint64_t virtualNanos = 0;
+    uint64_t loopCostNanos = 100000;
+
+    uint16_t touchValues[PIN_COUNT];
+    int pinLevels[PIN_COUNT];
+
+    uint64_t runNanos = 0;
+    uint64_t touchPeriodNanos = 0;
+
+    std::vector<TraceRecord> replay;
+    size_t replayNext = 0;
+    bool replayFast = false;
+    uint64_t replayStartNanos = 0;
+    uint64_t replayDoneLoops = 0;
+    std::chrono::steady_clock::time_point replayWallStart;
+
+    // -- The simulated receiver answers discovery hellos sent on its
+    //    channel, one ack delay later.
+    const uint8_t receiverMac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    int receiverChannel = 1;
+    std::vector<std::pair<uint64_t, std::vector<uint8_t> > > announces;
+
+    uint64_t loopCount = 0;
+    uint64_t loopTotalNanos = 0;
+    uint64_t loopMaxNanos = 0;
+}
+
+// Loads a FrameTrace file captured on the receiver.
+static bool loadReplay(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "native: cannot open trace %s\n", path);
+        return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        bytes.insert(bytes.end(), buf, buf + n);
+    }
+    fclose(fp);
+
+    if (bytes.size() < TRACE_MAGIC_LENGTH || memcmp(bytes.data(), TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0) {
+        fprintf(stderr, "native: %s is not a frame trace\n", path);
+        return false;
+    }
+
+    size_t offset = TRACE_MAGIC_LENGTH;
+    TraceRecord record;
+    while ((n = FrameTrace::decode(bytes.data() + offset, bytes.size() - offset, record)) > 0) {
+        replay.push_back(record);
+        offset += n;
+    }
+
+    fprintf(stderr, "native: replaying %zu frames from %s\n", replay.size(), path);
+    return true;
+}
+
+// Hands every trace record that is due to the receive callback. Record
+// times are relative to the first record; in fast mode the virtual clock
+// jumps straight to the next record.
+static void replayDue() {
+    if (replayNext >= replay.size()) {
+        return;
+    }
+
+    uint32_t first = replay[0].timestamp;
+    if (replayFast) {
+        uint64_t due = replayStartNanos + (uint64_t)(replay[replayNext].timestamp - first) * 1000;
+        if (virtualNanos < due) {
+            virtualNanos = due;
+        }
+    }
+
+    while (replayNext < replay.size()) {
+        const TraceRecord &record = replay[replayNext];
+        uint64_t due = replayStartNanos + (uint64_t)(record.timestamp - first) * 1000;
+        if (NativeHal::nanos() < due) {
+            break;
+        }
+        WifiEspNow.deliver(record.mac, record.data, record.length);
+        replayNext++;
+    }
+}
+
+// Queues the simulated receiver's announce for a hello it can hear.
+static void answerHello(const uint8_t *buf, size_t count, unsigned long delayUs) {
+    uint32_t nonce;
+    if (receiverChannel == 0 || WiFi.channel() != receiverChannel || !Discovery::decodeHello(buf, count, nonce)) {
+        return;
+    }
+
+    DiscoveryAnnounce announce;
+    announce.nonce = nonce;
+    announce.channel = receiverChannel;
+    announce.capacity = 32;
+    announce.peers = 0;
+    strcpy(announce.name, "Slave_1");
+
+    uint8_t frame[DISCOVERY_MAX_LENGTH];
+    size_t length = Discovery::encodeAnnounce(announce, frame);
+    announces.push_back(std::make_pair(NativeHal::nanos() + (uint64_t)delayUs * 1000, std::vector<uint8_t>(frame, frame + length)));
+}
+
+static void announcesDue() {
+    for (size_t i = 0; i < announces.size();) {
+        if (NativeHal::nanos() < announces[i].first) {
+            i++;
+            continue;
+        }
+        std::vector<uint8_t> frame = announces[i].second;
+        announces.erase(announces.begin() + i);
+        WifiEspNow.deliver(receiverMac, frame.data(), frame.size());
+    }
+}
+
+namespace NativeHal {
+    double envDouble(const char *name, double fallback) {
+        const char *value = getenv(name);
+        return value ? atof(value) : fallback;
+    }
+
+    void begin() {
+        startTime = std::chrono::steady_clock::now();
+        virtualClock = envDouble("HL_VIRTUAL_CLOCK", 0) != 0;
+        loopCostNanos = (uint64_t)(envDouble("HL_LOOP_US", 100) * 1000);
+        runNanos = (uint64_t)(envDouble("HL_RUN_MS", 0) * 1000000);
+        touchPeriodNanos = (uint64_t)(envDouble("HL_TOUCH_PERIOD_MS", 0) * 1000000);
+
+        for (int i = 0; i < PIN_COUNT; i++) {
+            touchValues[i] = 100;
+            pinLevels[i] = -1;
+        }
+
+        const char *root = getenv("HL_SPIFFS_ROOT");
+        if (root) {
+            SPIFFS.setRoot(root);
+        }
+
+        WifiEspNow.setAckLoss(envDouble("HL_ACK_LOSS", 0));
+        WifiEspNow.setAckDelay((unsigned long)envDouble("HL_ACK_DELAY_US", 1000));
+        srand((unsigned)envDouble("HL_SEED", 1));
+        receiverChannel = (int)envDouble("HL_RECEIVER_CHANNEL", 1);
+
+        const char *trace = getenv("HL_REPLAY");
+        if (trace && loadReplay(trace)) {
+            replayFast = envDouble("HL_REPLAY_FAST", 0) != 0;
+            if (replayFast) {
+                virtualClock = true;
+            }
+            replayWallStart = std::chrono::steady_clock::now();
+        }
+    }
+
+    // A replay ends the run shortly after its last frame, once the
+    // firmware had some loops to drain its queues.
+    bool running() {
+        if (!replay.empty() && replayNext >= replay.size() && ++replayDoneLoops > 1000) {
+            return false;
+        }
+        return runNanos == 0 || nanos() < runNanos;
+    }
+
+    void startReplay() {
+        replayStartNanos = nanos();
+    }
+
+    // Plays the scripted touch pattern on every touch pin.
+    void tick() {
+        if (virtualClock) {
+            virtualNanos += loopCostNanos;
+        }
+
+        replayDue();
+        announcesDue();
+
+        if (touchPeriodNanos > 0) {
+            bool touched = (nanos() % touchPeriodNanos) < touchPeriodNanos / 2;
+            for (int i = 0; i < PIN_COUNT; i++) {
+                touchValues[i] = touched ? 10 : 100;
+            }
+        }
+    }
+
+    void report() {
+        fflush(stdout);
+        fprintf(stderr, "native: %llu loops, mean %.2f us, max %.2f us\n",
+                (unsigned long long)loopCount,
+                loopCount ? loopTotalNanos / 1000.0 / loopCount : 0.0,
+                loopMaxNanos / 1000.0);
+        fprintf(stderr, "native: %lu ESP-NOW frames sent, %lu UART0 bytes written\n",
+                WifiEspNow.getSentCount(), Serial.getBytesWritten());
+        if (!replay.empty()) {
+            double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayWallStart).count();
+            fprintf(stderr, "native: replayed %zu/%zu frames in %.3f s wall clock (%.0f frames/s)\n",
+                    replayNext, replay.size(), wall, wall > 0 ? replayNext / wall : 0.0);
+        }
+    }
+
+    uint64_t nanos() {
+        if (virtualClock) {
+            return virtualNanos;
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    void useVirtualClock(bool enabled) {
+        virtualClock = enabled;
+    }
+
+    bool isVirtualClock() {
+        return virtualClock;
+    }
+
+    void advance(uint64_t micros) {
+        if (virtualClock) {
+            virtualNanos += micros * 1000;
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(micros));
+        }
+    }
+
+    void setTouchValue(uint8_t pin, uint16_t value) {
+        if (pin < PIN_COUNT) {
+            touchValues[pin] = value;
+        }
+    }
+
+    uint16_t getTouchValue(uint8_t pin) {
+        return pin < PIN_COUNT ? touchValues[pin] : 0;
+    }
+
+    void setPinLevel(uint8_t pin, int level) {
+        if (pin < PIN_COUNT) {
+            pinLevels[pin] = level;
+        }
+    }
+
+    int getPinLevel(uint8_t pin) {
+        return pin < PIN_COUNT ? pinLevels[pin] : -1;
+    }
+
+    void recordLoop(uint64_t nanos) {
+        loopCount++;
+        loopTotalNanos += nanos;
+        if (nanos > loopMaxNanos) {
+            loopMaxNanos = nanos;
+        }
+    }
+}
+
+void delay(uint32_t ms) {
+    NativeHal::advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    NativeHal::advance(us);
+}
+
+void yield() {
+    if (!NativeHal::isVirtualClock()) {
+        std::this_thread::yield();
+    }
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core) {
+    (void)name;
+    (void)stackDepth;
+    (void)priority;
+    (void)core;
+    std::thread(task, parameters).detach();
+    if (created) {
+        *created = NULL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+void EspClass::restart() {
+    fprintf(stderr, "native: ESP.restart() called\n");
+    NativeHal::report();
+    exit(0);
+}
+
+// -- WifiEspNow
+
+bool WifiEspNowClass::begin() {
+    started = true;
+    return true;
+}
+
+void WifiEspNowClass::end() {
+    started = false;
+    peers.clear();
+}
+
+int WifiEspNowClass::listPeers(WifiEspNowPeerInfo *out, int maxPeers) const {
+    int n = 0;
+    for (size_t i = 0; i < peers.size() && n < maxPeers; i++) {
+        out[n++] = peers[i];
+    }
+    return peers.size();
+}
+
+bool WifiEspNowClass::hasPeer(const uint8_t mac[WIFIESPNOW_ALEN]) const {
+    for (size_t i = 0; i < peers.size(); i++) {
+        if (memcmp(peers[i].mac, mac, WIFIESPNOW_ALEN) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WifiEspNowClass::addPeer(const uint8_t mac[WIFIESPNOW_ALEN], int channel, const uint8_t key[WIFIESPNOW_KEYLEN], int netif) {
+    (void)key;
+    (void)netif;
+    if (!started) {
+        return false;
+    }
+    if (hasPeer(mac)) {
+        return true;
+    }
+
+    WifiEspNowPeerInfo peer;
+    memcpy(peer.mac, mac, WIFIESPNOW_ALEN);
+    peer.channel = channel;
+    peers.push_back(peer);
+    return true;
+}
+
+bool WifiEspNowClass::removePeer(const uint8_t mac[WIFIESPNOW_ALEN]) {
+    for (size_t i = 0; i < peers.size(); i++) {
+        if (memcmp(peers[i].mac, mac, WIFIESPNOW_ALEN) == 0) {
+            peers.erase(peers.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WifiEspNowClass::onReceive(RxCallback cb, void *cbarg) {
+    rxCb = cb;
+    rxArg = cbarg;
+}
+
+bool WifiEspNowClass::send(const uint8_t mac[WIFIESPNOW_ALEN], const uint8_t *buf, size_t count) {
+    if (!started || count > WIFIESPNOW_MAXMSGLEN) {
+        return false;
+    }
+
+    sentCount++;
+    sentAt = micros();
+    pending = true;
+    result = WifiEspNowSendStatus::NONE;
+
+    if (memcmp(mac, DISCOVERY_BROADCAST, WIFIESPNOW_ALEN) == 0) {
+        answerHello(buf, count, ackDelayUs);
+    }
+
+    bool delivered = txHook ? txHook(mac, buf, count) : true;
+    bool lost = ackLoss > 0 && rand() < ackLoss * ((double)RAND_MAX + 1);
+    if (!delivered || lost) {
+        result = WifiEspNowSendStatus::FAIL;
+    }
+    return true;
+}
+
+WifiEspNowSendStatus WifiEspNowClass::getSendStatus() const {
+    if (pending && result == WifiEspNowSendStatus::NONE && micros() - sentAt >= ackDelayUs) {
+        return WifiEspNowSendStatus::OK;
+    }
+    return result;
+}
+
+void WifiEspNowClass::deliver(const uint8_t mac[WIFIESPNOW_ALEN], const uint8_t *buf, size_t count) {
+    if (started && rxCb) {
+        rxCb(mac, buf, count, rxArg);
+    }
+}
+
+// -- WiFi
+
+bool WiFiClass::softAP(const char *ssid, const char *passphrase, int channel, int ssidHidden, int maxConnection) {
+    (void)ssid;
+    (void)passphrase;
+    apChannel = channel;
+    (void)ssidHidden;
+    (void)maxConnection;
+    return true;
+}
+
+bool WiFiClass::softAPConfig(IPAddress localIp, IPAddress gateway, IPAddress subnet) {
+    (void)gateway;
+    (void)subnet;
+    apIp = localIp;
+    return true;
+}
+
+static String formatMac(const uint8_t *mac) {
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return String(buf);
+}
+
+String WiFiClass::softAPmacAddress() {
+    uint8_t apMac[6];
+    memcpy(apMac, mac, 6);
+    apMac[5]++;
+    return formatMac(apMac);
+}
+
+String WiFiClass::macAddress() {
+    return formatMac(mac);
+}
+
+void WiFiClass::seedNetworks() {
+    if (networksSeeded) {
+        return;
+    }
+    networksSeeded = true;
+
+    const uint8_t receiver[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    addNetwork("Slave_1", receiver, -40, 1);
+}
+
+void WiFiClass::addNetwork(const char *ssid, const uint8_t bssid[6], int32_t rssi, int32_t channel) {
+    networksSeeded = true;
+
+    Network network;
+    network.ssid = ssid;
+    memcpy(network.bssid, bssid, 6);
+    network.rssi = rssi;
+    network.channel = channel;
+    network.auth = WIFI_AUTH_WPA2_PSK;
+    networks.push_back(network);
+}
+
+// A scan takes scanDurationMs; synchronous scans block for that long.
+int16_t WiFiClass::scanNetworks(bool async, bool showHidden) {
+    (void)showHidden;
+    seedNetworks();
+
+    scanRunning = true;
+    scanDone = false;
+    scanStart = millis();
+    if (async) {
+        return WIFI_SCAN_RUNNING;
+    }
+
+    delay(scanDurationMs);
+    scanRunning = false;
+    scanDone = true;
+    return networks.size();
+}
+
+int16_t WiFiClass::scanComplete() {
+    if (scanRunning && millis() - scanStart >= scanDurationMs) {
+        scanRunning = false;
+        scanDone = true;
+    }
+    if (scanRunning) {
+        return WIFI_SCAN_RUNNING;
+    }
+    return scanDone ? (int16_t)networks.size() : WIFI_SCAN_FAILED;
+}
+
+void WiFiClass::scanDelete() {
+    scanDone = false;
+}
+
+String WiFiClass::SSID(uint8_t i) {
+    return i < networks.size() ? networks[i].ssid : String();
+}
+
+int32_t WiFiClass::RSSI(uint8_t i) {
+    return i < networks.size() ? networks[i].rssi : 0;
+}
+
+uint8_t *WiFiClass::BSSID(uint8_t i) {
+    return i < networks.size() ? networks[i].bssid : NULL;
+}
+
+String WiFiClass::BSSIDstr(uint8_t i) {
+    return i < networks.size() ? formatMac(networks[i].bssid) : String();
+}
+
+int32_t WiFiClass::channel(uint8_t i) {
+    return i < networks.size() ? networks[i].channel : 0;
+}
+
+wifi_auth_mode_t WiFiClass::encryptionType(uint8_t i) {
+    return i < networks.size() ? networks[i].auth : WIFI_AUTH_OPEN;
+}
+
+// -- EEPROM
+
+bool EEPROMClass::begin(size_t size) {
+    data.assign(size, 0xFF);
+
+    const char *path = getenv("HL_EEPROM");
+    if (path) {
+        FILE *fp = fopen(path, "rb");
+        if (fp) {
+            size_t n = fread(data.data(), 1, size, fp);
+            (void)n;
+            fclose(fp);
+        }
+    }
+    return true;
+}
+
+bool EEPROMClass::commit() {
+    commits++;
+    bytesCommitted += data.size();
+
+    const char *path = getenv("HL_EEPROM");
+    if (!path) {
+        return true;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+    return ok;
+}
+
+// -- Entry point, same contract as the Arduino core
+
+int main() {
+    NativeHal::begin();
+    setup();
+    NativeHal::startReplay();
+
+    while (NativeHal::running()) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        loop();
+        NativeHal::recordLoop(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        NativeHal::tick();
+    }
+
+    NativeHal::report();
+    return 0;
+}
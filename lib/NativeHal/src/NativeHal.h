@@ -0,0 +1,48 @@
+#ifndef __NATIVEHAL_H__
+#define __NATIVEHAL_H__
+
+#include <stdint.h>
+
+/**
+ * Native HAL
+ *
+ * Process-wide state behind the Arduino stand-ins: the clock, the touch
+ * and GPIO inputs, and the loop timing report. The clock is the host's
+ * monotonic clock unless the virtual clock is enabled, in which case time
+ * only moves through advance() and delay().
+ *
+ * Behaviour of a run is set through environment variables:
+ *   HL_RUN_MS           stop after this many milliseconds (0 = forever)
+ *   HL_VIRTUAL_CLOCK    1 to use the virtual clock, each loop() costs HL_LOOP_US
+ *   HL_TOUCH_PERIOD_MS  touch the pads every N ms, held for half the period
+ *   HL_ACK_LOSS         fraction of ESP-NOW sends that are not acked
+ *   HL_RECEIVER_CHANNEL channel of the simulated receiver that answers
+ *                       discovery hellos (default 1, 0 for none)
+ *   HL_REPLAY           FrameTrace file whose frames are delivered to the
+ *                       ESP-NOW receive callback at their recorded times
+ *   HL_REPLAY_FAST      1 to replay as fast as possible on the virtual clock
+ *   HL_FLASH            file backing the "config" flash partition, see
+ *                       esp_partition.h for HL_FLASH_SECTORS/HL_FLASH_CUT_AFTER
+ */
+namespace NativeHal {
+    void begin();
+    bool running();
+    void tick();
+    void report();
+    void startReplay();
+
+    uint64_t nanos();
+    void useVirtualClock(bool enabled);
+    bool isVirtualClock();
+    void advance(uint64_t micros);
+
+    void setTouchValue(uint8_t pin, uint16_t value);
+    uint16_t getTouchValue(uint8_t pin);
+    void setPinLevel(uint8_t pin, int level);
+    int getPinLevel(uint8_t pin);
+
+    void recordLoop(uint64_t nanos);
+    double envDouble(const char *name, double fallback);
+}
+
+#endif /* __NATIVEHAL_H__ */
@@ -0,0 +1,34 @@
+#ifndef __NATIVEHAL_SPIFFS_H__
+#define __NATIVEHAL_SPIFFS_H__
+
+#include "FS.h"
+
+/**
+ * SPIFFS
+ *
+ * Serves files from HL_SPIFFS_ROOT, which defaults to the project's
+ * data/ directory.
+ */
+class SPIFFSFS : public fs::FS {
+public:
+    SPIFFSFS() : fs::FS("data") {}
+
+    bool begin(bool formatOnFail = false, const char *basePath = "/spiffs", uint8_t maxOpenFiles = 10) {
+        (void)formatOnFail;
+        (void)basePath;
+        (void)maxOpenFiles;
+        mounts++;
+        return true;
+    }
+    void end() {}
+
+    // -- Simulation hooks, not part of the library.
+    unsigned long getMountCount() const { return mounts; }
+
+private:
+    unsigned long mounts = 0;
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif /* __NATIVEHAL_SPIFFS_H__ */
@@ -0,0 +1,126 @@
+#ifndef __NATIVEHAL_WSTRING_H__
+#define __NATIVEHAL_WSTRING_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+/**
+ * Arduino String backed by std::string
+ */
+class String {
+public:
+    String() {}
+    String(const char *cstr) : str(cstr ? cstr : "") {}
+    String(const std::string &s) : str(s) {}
+    explicit String(char c) : str(1, c) {}
+    explicit String(int value, unsigned char base = 10) { fromLong(value, base); }
+    explicit String(unsigned int value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(long value, unsigned char base = 10) { fromLong(value, base); }
+    explicit String(unsigned long value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(double value, unsigned char decimals = 2) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+        str = buf;
+    }
+
+    const char *c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.length(); }
+    char charAt(unsigned int index) const { return index < str.length() ? str[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(str.find(c, from)); }
+    int indexOf(const char *s, unsigned int from = 0) const { return position(str.find(s, from)); }
+    int indexOf(const String &s, unsigned int from = 0) const { return position(str.find(s.str, from)); }
+    bool startsWith(const String &prefix) const { return str.compare(0, prefix.str.length(), prefix.str) == 0; }
+
+    String substring(unsigned int from) const { return from < str.length() ? String(str.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        return from < str.length() && from < to ? String(str.substr(from, to - from)) : String();
+    }
+
+    long toInt() const { return atol(str.c_str()); }
+
+    String &operator+=(const String &rhs) { str += rhs.str; return *this; }
+    String &operator+=(const char *rhs) { if (rhs) str += rhs; return *this; }
+    String &operator+=(char rhs) { str += rhs; return *this; }
+    String &operator+=(int rhs) { return *this += String(rhs); }
+    String &operator+=(unsigned int rhs) { return *this += String(rhs); }
+    String &operator+=(long rhs) { return *this += String(rhs); }
+    String &operator+=(unsigned long rhs) { return *this += String(rhs); }
+    bool concat(const String &rhs) { str += rhs.str; return true; }
+    bool concat(const char *rhs) { if (rhs) str += rhs; return true; }
+    bool concat(char rhs) { str += rhs; return true; }
+
+    bool operator==(const String &rhs) const { return str == rhs.str; }
+    bool operator==(const char *rhs) const { return str == (rhs ? rhs : ""); }
+    bool operator!=(const String &rhs) const { return str != rhs.str; }
+    bool operator!=(const char *rhs) const { return !(*this == rhs); }
+    bool operator<(const String &rhs) const { return str < rhs.str; }
+
+private:
+    std::string str;
+
+    static int position(size_t pos) {
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+
+    void fromLong(long value, unsigned char base) {
+        if (value < 0 && base == 10) {
+            str = "-";
+            appendUnsigned((unsigned long)(-value), base);
+        } else {
+            appendUnsigned((unsigned long)value, base);
+        }
+    }
+
+    void fromUnsigned(unsigned long value, unsigned char base) {
+        appendUnsigned(value, base);
+    }
+
+    void appendUnsigned(unsigned long value, unsigned char base) {
+        char buf[8 * sizeof(long) + 1];
+        char *p = buf + sizeof(buf) - 1;
+        *p = '\0';
+        do {
+            unsigned digit = value % base;
+            *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+            value /= base;
+        } while (value);
+        str += p;
+    }
+};
+
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String &s) : String(s) {}
+    StringSumHelper(const char *s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &lhs, const String &rhs) {
+    StringSumHelper sum(lhs);
+    sum += rhs;
+    return sum;
+}
+
+inline StringSumHelper operator+(const String &lhs, const char *rhs) {
+    StringSumHelper sum(lhs);
+    sum += rhs;
+    return sum;
+}
+
+inline StringSumHelper operator+(const char *lhs, const String &rhs) {
+    StringSumHelper sum(lhs);
+    sum += rhs;
+    return sum;
+}
+
+inline StringSumHelper operator+(const String &lhs, char rhs) {
+    StringSumHelper sum(lhs);
+    sum += rhs;
+    return sum;
+}
+
+#endif /* __NATIVEHAL_WSTRING_H__ */
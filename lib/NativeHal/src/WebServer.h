@@ -0,0 +1,175 @@
+#ifndef __NATIVEHAL_WEBSERVER_H__
+#define __NATIVEHAL_WEBSERVER_H__
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "WiFi.h"
+
+enum HTTPMethod {
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS,
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) - 1)
+
+/**
+ * Web Server
+ *
+ * No sockets: requests are fed in with request() and the response is
+ * captured in getResponse(), which is enough to drive and time handlers.
+ */
+class WebServer {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    struct Response {
+        int code = 0;
+        String contentType;
+        String body;
+        std::vector<std::pair<String, String> > headers;
+    };
+
+    WebServer(int port = 80) : port(port) {}
+
+    void begin() {}
+    void close() {}
+    void handleClient() {}
+
+    void on(const String &uri, HTTPMethod method, THandlerFunction fn) {
+        routes.push_back(Route{uri, method, fn});
+    }
+    void on(const String &uri, THandlerFunction fn) {
+        on(uri, HTTP_ANY, fn);
+    }
+    void onNotFound(THandlerFunction fn) { notFound = fn; }
+
+    void collectHeaders(const char *headerKeys[], const size_t headerKeysCount) {
+        (void)headerKeys;
+        (void)headerKeysCount;
+    }
+
+    String uri() { return currentUri; }
+    HTTPMethod method() { return currentMethod; }
+    String arg(const String &name) { return args.count(name) ? args[name] : String(); }
+    bool hasArg(const String &name) { return args.count(name) > 0; }
+    String header(const String &name) { return requestHeaders.count(name) ? requestHeaders[name] : String(); }
+    bool hasHeader(const String &name) { return requestHeaders.count(name) > 0; }
+    String hostHeader() { return header("Host"); }
+    WiFiClient &client() { return currentClient; }
+
+    void sendHeader(const String &name, const String &value, bool first = false) {
+        if (first) {
+            response.headers.insert(response.headers.begin(), std::make_pair(name, value));
+        } else {
+            response.headers.push_back(std::make_pair(name, value));
+        }
+    }
+    void setContentLength(size_t length) { contentLength = length; }
+
+    void send(int code, const char *contentType = NULL, const String &content = String("")) {
+        response.code = code;
+        response.contentType = contentType;
+        response.body += content;
+    }
+    void send(int code, const String &contentType, const String &content) {
+        send(code, contentType.c_str(), content);
+    }
+    void send_P(int code, const char *contentType, const char *content, size_t length) {
+        response.code = code;
+        response.contentType = contentType;
+        response.body += String(std::string(content, length));
+    }
+    void sendContent(const String &content) { response.body += content; }
+    void sendContent_P(const char *content, size_t length) { response.body += String(std::string(content, length)); }
+
+    template<typename T>
+    size_t streamFile(T &file, const String &contentType) {
+        response.code = 200;
+        response.contentType = contentType;
+        uint8_t buf[256];
+        size_t total = 0;
+        size_t n;
+        while ((n = file.read(buf, sizeof(buf))) > 0) {
+            response.body += String(std::string((const char *)buf, n));
+            total += n;
+        }
+        return total;
+    }
+
+    // -- Simulation hooks, not part of the library.
+    const Response &request(HTTPMethod method, const String &uri, const String &body = String(),
+                            const std::map<String, String> &headers = std::map<String, String>()) {
+        currentMethod = method;
+        currentUri = uri;
+        requestHeaders = headers;
+        if (body.length() > 0 && !requestHeaders.count("Content-Length")) {
+            requestHeaders["Content-Length"] = String((unsigned long)body.length());
+        }
+        args.clear();
+        args["plain"] = body;
+        response = Response();
+        contentLength = CONTENT_LENGTH_UNKNOWN;
+
+        if (header("Content-Type") == "application/x-www-form-urlencoded") {
+            parseForm(body);
+        }
+
+        for (size_t i = 0; i < routes.size(); i++) {
+            if (routes[i].uri == uri && (routes[i].method == HTTP_ANY || routes[i].method == method)) {
+                routes[i].fn();
+                return response;
+            }
+        }
+        if (notFound) {
+            notFound();
+        }
+        return response;
+    }
+    const Response &getResponse() const { return response; }
+
+private:
+    struct Route {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction fn;
+    };
+
+    int port;
+    std::vector<Route> routes;
+    THandlerFunction notFound;
+
+    HTTPMethod currentMethod = HTTP_GET;
+    String currentUri;
+    std::map<String, String> args;
+    std::map<String, String> requestHeaders;
+    WiFiClient currentClient;
+    Response response;
+    size_t contentLength = CONTENT_LENGTH_UNKNOWN;
+
+    void parseForm(const String &body) {
+        int start = 0;
+        while (start < (int)body.length()) {
+            int end = body.indexOf('&', start);
+            if (end < 0) {
+                end = body.length();
+            }
+            String pair = body.substring(start, end);
+            int eq = pair.indexOf('=');
+            if (eq > 0) {
+                args[pair.substring(0, eq)] = pair.substring(eq + 1);
+            }
+            start = end + 1;
+        }
+    }
+};
+
+#endif /* __NATIVEHAL_WEBSERVER_H__ */
@@ -0,0 +1,111 @@
+#ifndef __NATIVEHAL_WIFI_H__
+#define __NATIVEHAL_WIFI_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Arduino.h"
+
+typedef enum {
+    WIFI_MODE_NULL = 0,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA,
+} wifi_mode_t;
+
+typedef enum {
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+} wifi_auth_mode_t;
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_DISCONNECTED,
+} wl_status_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+/**
+ * WiFi Client
+ */
+class WiFiClient {
+public:
+    IPAddress localIP() { return IPAddress(192, 168, 1, 1); }
+    void stop() {}
+};
+
+/**
+ * WiFi
+ *
+ * Scans return the networks registered with addNetwork(). By default a
+ * single receiver soft-AP ("Slave_1") is visible on channel 1. channel()
+ * is the channel of the last softAP() call.
+ */
+class WiFiClass {
+public:
+    struct Network {
+        String ssid;
+        uint8_t bssid[6];
+        int32_t rssi;
+        int32_t channel;
+        wifi_auth_mode_t auth;
+    };
+
+    void persistent(bool persistent) { (void)persistent; }
+    bool mode(wifi_mode_t mode) { currentMode = mode; return true; }
+    wifi_mode_t getMode() { return currentMode; }
+    bool disconnect(bool wifiOff = false) { (void)wifiOff; return true; }
+    wl_status_t status() { return WL_DISCONNECTED; }
+
+    bool softAP(const char *ssid, const char *passphrase = NULL, int channel = 1, int ssidHidden = 0, int maxConnection = 4);
+    bool softAPConfig(IPAddress localIp, IPAddress gateway, IPAddress subnet);
+    bool softAPdisconnect(bool wifiOff = false) { (void)wifiOff; return true; }
+    IPAddress softAPIP() { return apIp; }
+    String softAPmacAddress();
+    String macAddress();
+
+    int16_t scanNetworks(bool async = false, bool showHidden = false);
+    int16_t scanComplete();
+    void scanDelete();
+    String SSID(uint8_t i);
+    int32_t RSSI(uint8_t i);
+    uint8_t *BSSID(uint8_t i);
+    String BSSIDstr(uint8_t i);
+    int32_t channel(uint8_t i);
+    int32_t channel() { return apChannel; }
+    wifi_auth_mode_t encryptionType(uint8_t i);
+
+    // -- Simulation hooks, not part of the library.
+    void addNetwork(const char *ssid, const uint8_t bssid[6], int32_t rssi, int32_t channel);
+    void clearNetworks() { networks.clear(); }
+    void setMacAddress(const uint8_t mac[6]) { memcpy(this->mac, mac, 6); }
+    const uint8_t *getMacAddress() const { return mac; }
+    void setScanDuration(unsigned long ms) { scanDurationMs = ms; }
+
+private:
+    wifi_mode_t currentMode = WIFI_MODE_NULL;
+    IPAddress apIp = IPAddress(192, 168, 4, 1);
+    int32_t apChannel = 1;
+    uint8_t mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x10};
+    std::vector<Network> networks;
+    bool networksSeeded = false;
+    bool scanRunning = false;
+    bool scanDone = false;
+    unsigned long scanStart = 0;
+    unsigned long scanDurationMs = 120;
+
+    void seedNetworks();
+};
+
+extern WiFiClass WiFi;
+
+#endif /* __NATIVEHAL_WIFI_H__ */
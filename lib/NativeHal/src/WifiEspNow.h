@@ -0,0 +1,78 @@
+#ifndef __NATIVEHAL_WIFIESPNOW_H__
+#define __NATIVEHAL_WIFIESPNOW_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <vector>
+
+#include "esp_now.h"
+
+#define WIFIESPNOW_ALEN 6
+#define WIFIESPNOW_KEYLEN 16
+#define WIFIESPNOW_MAXMSGLEN 250
+
+enum class WifiEspNowSendStatus : uint8_t {
+    NONE,
+    OK,
+    FAIL,
+};
+
+struct WifiEspNowPeerInfo {
+    uint8_t mac[WIFIESPNOW_ALEN];
+    int channel;
+};
+
+/**
+ * WifiEspNow
+ *
+ * Same surface as the WifiEspNow library. Sends are handed to the
+ * transmit hook (if any) and acked after HL_ACK_DELAY_US, or failed with
+ * probability HL_ACK_LOSS. deliver() plays the part of the radio and
+ * calls the receive callback.
+ */
+class WifiEspNowClass {
+public:
+    typedef void (*RxCallback)(const uint8_t mac[WIFIESPNOW_ALEN], const uint8_t *buf, size_t count, void *cbarg);
+    typedef std::function<bool(const uint8_t *mac, const uint8_t *buf, size_t count)> TxHook;
+
+    bool begin();
+    void end();
+
+    bool setPrimaryKey(const uint8_t key[WIFIESPNOW_KEYLEN]) { (void)key; return true; }
+    int listPeers(WifiEspNowPeerInfo *peers, int maxPeers) const;
+    bool hasPeer(const uint8_t mac[WIFIESPNOW_ALEN]) const;
+    bool addPeer(const uint8_t mac[WIFIESPNOW_ALEN], int channel = 0, const uint8_t key[WIFIESPNOW_KEYLEN] = nullptr, int netif = ESP_IF_WIFI_AP);
+    bool removePeer(const uint8_t mac[WIFIESPNOW_ALEN]);
+
+    void onReceive(RxCallback cb, void *cbarg);
+    bool send(const uint8_t mac[WIFIESPNOW_ALEN], const uint8_t *buf, size_t count);
+    WifiEspNowSendStatus getSendStatus() const;
+
+    // -- Simulation hooks, not part of the library.
+    void onTransmit(TxHook hook) { txHook = hook; }
+    void deliver(const uint8_t mac[WIFIESPNOW_ALEN], const uint8_t *buf, size_t count);
+    void setAckLoss(double loss) { ackLoss = loss; }
+    void setAckDelay(unsigned long us) { ackDelayUs = us; }
+    unsigned long getSentCount() const { return sentCount; }
+
+private:
+    bool started = false;
+    std::vector<WifiEspNowPeerInfo> peers;
+    RxCallback rxCb = nullptr;
+    void *rxArg = nullptr;
+    TxHook txHook;
+
+    double ackLoss = 0;
+    unsigned long ackDelayUs = 1000;
+    unsigned long sentCount = 0;
+    unsigned long sentAt = 0;
+    bool pending = false;
+    WifiEspNowSendStatus result = WifiEspNowSendStatus::NONE;
+};
+
+extern WifiEspNowClass WifiEspNow;
+
+#endif /* __NATIVEHAL_WIFIESPNOW_H__ */
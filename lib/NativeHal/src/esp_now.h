@@ -0,0 +1,25 @@
+#ifndef __NATIVEHAL_ESP_NOW_H__
+#define __NATIVEHAL_ESP_NOW_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_KEY_LEN 16
+#define ESP_NOW_MAX_DATA_LEN 250
+
+typedef enum {
+    ESP_IF_WIFI_STA = 0,
+    ESP_IF_WIFI_AP,
+} wifi_interface_t;
+
+typedef struct esp_now_peer_info {
+    uint8_t peer_addr[ESP_NOW_ETH_ALEN];
+    uint8_t lmk[ESP_NOW_KEY_LEN];
+    uint8_t channel;
+    wifi_interface_t ifidx;
+    bool encrypt;
+    void *priv;
+} esp_now_peer_info_t;
+
+#endif /* __NATIVEHAL_ESP_NOW_H__ */
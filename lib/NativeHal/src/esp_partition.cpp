@@ -0,0 +1,180 @@
+#include "esp_partition.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+static esp_partition_t configPartition = {
+    ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, 0x290000, 0, "config", false
+};
+
+static std::vector<uint8_t> flash;
+static std::vector<unsigned long> erases;
+static bool loaded = false;
+static long budget = -1;
+static bool powered = true;
+static unsigned long bytesProgrammed = 0;
+static unsigned long sectorsErased = 0;
+
+static void save() {
+    const char *path = getenv("HL_FLASH");
+    if (!path) {
+        return;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp) {
+        fwrite(flash.data(), 1, flash.size(), fp);
+        fclose(fp);
+    }
+}
+
+static void load() {
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+
+    const char *sectors = getenv("HL_FLASH_SECTORS");
+    FlashSim::format(sectors ? atoi(sectors) : 4);
+
+    const char *cut = getenv("HL_FLASH_CUT_AFTER");
+    if (cut) {
+        budget = atol(cut);
+    }
+
+    const char *path = getenv("HL_FLASH");
+    if (path) {
+        FILE *fp = fopen(path, "rb");
+        if (fp) {
+            size_t n = fread(flash.data(), 1, flash.size(), fp);
+            (void)n;
+            fclose(fp);
+        }
+    }
+}
+
+// Takes size bytes from the power budget. Returns how many of them
+// happen before the power is gone.
+static size_t spend(size_t size) {
+    if (!powered) {
+        return 0;
+    }
+    if (budget < 0 || (long)size <= budget) {
+        if (budget >= 0) {
+            budget -= size;
+        }
+        return size;
+    }
+
+    size_t done = budget;
+    budget = 0;
+    powered = false;
+    if (getenv("HL_FLASH_CUT_AFTER")) {
+        fprintf(stderr, "native: flash power lost\n");
+    }
+    return done;
+}
+
+static bool inRange(const esp_partition_t *partition, size_t offset, size_t size) {
+    return partition == &configPartition && offset <= flash.size() && size <= flash.size() - offset;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label) {
+    load();
+
+    if (type != configPartition.type) {
+        return NULL;
+    }
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != configPartition.subtype) {
+        return NULL;
+    }
+    if (label && strcmp(label, configPartition.label) != 0) {
+        return NULL;
+    }
+    return &configPartition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+    if (!inRange(partition, src_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!powered) {
+        return ESP_FAIL;
+    }
+
+    memcpy(dst, flash.data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+    if (!inRange(partition, dst_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t done = spend(size);
+    const uint8_t *in = (const uint8_t *)src;
+    for (size_t i = 0; i < done; i++) {
+        flash[dst_offset + i] &= in[i];
+    }
+    bytesProgrammed += done;
+    save();
+
+    return done == size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (!inRange(partition, offset, size) || offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t done = spend(size);
+    memset(flash.data() + offset, 0xFF, done);
+    for (size_t sector = offset / SPI_FLASH_SEC_SIZE; sector < (offset + done) / SPI_FLASH_SEC_SIZE; sector++) {
+        erases[sector]++;
+        sectorsErased++;
+    }
+    save();
+
+    return done == size ? ESP_OK : ESP_FAIL;
+}
+
+namespace FlashSim {
+    void format(size_t sectors) {
+        loaded = true;
+        flash.assign(sectors * SPI_FLASH_SEC_SIZE, 0xFF);
+        erases.assign(sectors, 0);
+        configPartition.size = flash.size();
+        bytesProgrammed = 0;
+        sectorsErased = 0;
+        budget = -1;
+        powered = true;
+    }
+
+    void cutPowerAfter(long bytes) {
+        budget = bytes;
+    }
+
+    void powerOn() {
+        budget = -1;
+        powered = true;
+    }
+
+    bool isPowered() {
+        return powered;
+    }
+
+    unsigned long getBytesProgrammed() {
+        return bytesProgrammed;
+    }
+
+    unsigned long getSectorsErased() {
+        return sectorsErased;
+    }
+
+    unsigned long getSectorErases(size_t sector) {
+        return sector < erases.size() ? erases[sector] : 0;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef __NATIVEHAL_ESP_PARTITION_H__
+#define __NATIVEHAL_ESP_PARTITION_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_DATA_NVS = 0x02,
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+/**
+ * Partition API
+ *
+ * A single data partition labelled "config" of HL_FLASH_SECTORS sectors
+ * (default 4), with NOR semantics: erase sets a sector to 0xFF, writes can
+ * only clear bits. When HL_FLASH names a file the partition is loaded
+ * from it and saved after every write and erase.
+ *
+ * HL_FLASH_CUT_AFTER (or FlashSim::cutPowerAfter()) loses power once that
+ * many bytes were programmed or erased: the operation in flight stops
+ * halfway and every later one fails until FlashSim::powerOn().
+ */
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+// -- Simulation hooks, not part of the IDF.
+namespace FlashSim {
+    void format(size_t sectors);
+    void cutPowerAfter(long bytes);
+    void powerOn();
+    bool isPowered();
+    unsigned long getBytesProgrammed();
+    unsigned long getSectorsErased();
+    unsigned long getSectorErases(size_t sector);
+}
+
+#endif /* __NATIVEHAL_ESP_PARTITION_H__ */
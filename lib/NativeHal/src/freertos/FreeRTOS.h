@@ -0,0 +1,18 @@
+#ifndef __NATIVEHAL_FREERTOS_H__
+#define __NATIVEHAL_FREERTOS_H__
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+#endif /* __NATIVEHAL_FREERTOS_H__ */
@@ -0,0 +1,19 @@
+#ifndef __NATIVEHAL_TASK_H__
+#define __NATIVEHAL_TASK_H__
+
+#include "FreeRTOS.h"
+
+// -- Tasks are host threads that run until the process exits. Priorities
+//    and cores are ignored, and vTaskDelay() sleeps on the wall clock even
+//    when the virtual clock is enabled.
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+typedef void (*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+
+#endif /* __NATIVEHAL_TASK_H__ */
@@ -0,0 +1,151 @@
+#ifndef __PEERTABLE_H__
+#define __PEERTABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+#define PEER_MAC_LENGTH 6
+#define PEER_REPLAY_WINDOW 64
+
+// -- Capacity of the hash table, must be a power of two. At most
+//    PEER_TABLE_MAX_PEERS sensors are admitted so probes stay short.
+#ifndef PEER_TABLE_SLOTS
+#define PEER_TABLE_SLOTS 64
+#endif
+#define PEER_TABLE_MAX_PEERS (PEER_TABLE_SLOTS / 2)
+
+/**
+ * Peer
+ */
+struct Peer {
+    uint8_t mac[PEER_MAC_LENGTH];
+    uint8_t index;
+    uint32_t lastSeen;
+    uint32_t frames;
+    uint32_t duplicates;
+
+    // -- Replay window over event sequence numbers: bit i of seen is set
+    //    when (highest - i) has been received.
+    uint16_t highest;
+    uint64_t seen;
+};
+
+/**
+ * Peer Table
+ *
+ * Fixed-size, open-addressed (linear probing) table of sensors keyed by
+ * MAC. Peers are never removed, so lookups need no tombstones and stay
+ * allocation-free. Each peer also gets a compact index (0, 1, 2, ... in
+ * order of first contact) for per-peer arrays elsewhere.
+ *
+ * Only one context may call find(); others may read peers through
+ * size() and get(), which only expose fully initialised entries.
+ */
+class PeerTable {
+public:
+    PeerTable() : count(0), rejected(0) {
+        memset(slots, 0, sizeof(slots));
+        memset(used, 0, sizeof(used));
+    }
+
+    // Returns the peer for mac, adding it on first contact. Returns NULL
+    // when the table is full.
+    Peer *find(const uint8_t mac[PEER_MAC_LENGTH]) {
+        size_t slot = hash(mac) & (PEER_TABLE_SLOTS - 1);
+
+        while (used[slot]) {
+            if (memcmp(slots[slot].mac, mac, PEER_MAC_LENGTH) == 0) {
+                return &slots[slot];
+            }
+            slot = (slot + 1) & (PEER_TABLE_SLOTS - 1);
+        }
+
+        uint8_t n = count.load(std::memory_order_relaxed);
+        if (n >= PEER_TABLE_MAX_PEERS) {
+            rejected++;
+            return NULL;
+        }
+
+        Peer &peer = slots[slot];
+        memset(&peer, 0, sizeof(peer));
+        memcpy(peer.mac, mac, PEER_MAC_LENGTH);
+        peer.index = n;
+        used[slot] = true;
+        byIndex[n] = &peer;
+        count.store(n + 1, std::memory_order_release);
+
+        return &peer;
+    }
+
+    // Records the sequence numbers [first, first + n) and returns false if
+    // first was already seen, i.e. the frame is a retransmit we already
+    // handled. A jump further back than the window is taken as a sensor
+    // restart and resets the window.
+    static bool accept(Peer &peer, uint16_t first, uint8_t n) {
+        if (peer.frames > 0) {
+            int16_t diff = (int16_t)(first - peer.highest);
+            if (diff <= 0 && -diff < PEER_REPLAY_WINDOW) {
+                if (peer.seen & (1ULL << -diff)) {
+                    peer.duplicates++;
+                    return false;
+                }
+            } else if (diff <= 0) {
+                peer.seen = 0;
+                peer.highest = first - 1;
+            }
+        } else {
+            peer.highest = first - 1;
+        }
+
+        peer.frames++;
+        for (uint8_t i = 0; i < n; i++) {
+            mark(peer, first + i);
+        }
+
+        return true;
+    }
+
+    uint8_t size() const {
+        return count.load(std::memory_order_acquire);
+    }
+
+    const Peer *get(uint8_t index) const {
+        return index < size() ? byIndex[index] : NULL;
+    }
+
+    uint32_t getRejected() const {
+        return rejected;
+    }
+
+private:
+    Peer slots[PEER_TABLE_SLOTS];
+    bool used[PEER_TABLE_SLOTS];
+    Peer *byIndex[PEER_TABLE_MAX_PEERS];
+    std::atomic<uint8_t> count;
+    uint32_t rejected;
+
+    // FNV-1a over the MAC. Sensors from one batch share their first three
+    // bytes, so all six are mixed in.
+    static uint32_t hash(const uint8_t mac[PEER_MAC_LENGTH]) {
+        uint32_t h = 2166136261UL;
+        for (int i = 0; i < PEER_MAC_LENGTH; i++) {
+            h = (h ^ mac[i]) * 16777619UL;
+        }
+        return h ^ (h >> 16);
+    }
+
+    static void mark(Peer &peer, uint16_t sequence) {
+        int16_t diff = (int16_t)(sequence - peer.highest);
+        if (diff > 0) {
+            peer.seen = diff < PEER_REPLAY_WINDOW ? (peer.seen << diff) | 1 : 1;
+            peer.highest = sequence;
+        } else if (-diff < PEER_REPLAY_WINDOW) {
+            peer.seen |= 1ULL << -diff;
+        }
+    }
+};
+
+#endif /* __PEERTABLE_H__ */
@@ -0,0 +1,219 @@
+#ifndef __SERIALFRAME_H__
+#define __SERIALFRAME_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// -- Framed transport for the receiver's UART. Plain C++ so the host side
+//    can include the same header to decode the stream.
+//
+//    Before stuffing a frame is:
+//
+//      0        1        2 .. 2+length-1   2+length..3+length
+//      channel  length   payload           CRC-16/CCITT-FALSE (little endian)
+//
+//    The CRC covers channel, length and payload. The frame is then COBS
+//    encoded, so it contains no zero bytes, and terminated by a single 0x00.
+//    A receiver can join the stream at any point and resynchronize on the
+//    next zero.
+#define SERIAL_FRAME_MAX_PAYLOAD 128
+#define SERIAL_FRAME_MAX_RAW (SERIAL_FRAME_MAX_PAYLOAD + 4)
+#define SERIAL_FRAME_MAX_ENCODED (SERIAL_FRAME_MAX_RAW + SERIAL_FRAME_MAX_RAW / 254 + 2)
+
+enum SerialChannel {
+    SERIAL_CHANNEL_MIDI = 0,
+    SERIAL_CHANNEL_TELEMETRY = 1,
+    SERIAL_CHANNEL_LOG = 2,
+    SERIAL_CHANNEL_CONTROL = 3,
+    SERIAL_CHANNEL_TRACE = 4,
+};
+
+// -- Commands carried on SERIAL_CHANNEL_CONTROL, first payload byte.
+#define SERIAL_CONTROL_STATS 's'
+#define SERIAL_CONTROL_TRACE 't'
+#define SERIAL_CONTROL_BAUD 'B' // followed by the new baud rate, uint32 little endian
+#define SERIAL_CONTROL_DELAY 'D' // followed by the playout delay in microseconds, uint32 little endian
+
+/**
+ * Serial Frame codec
+ */
+class SerialFrame {
+public:
+    static uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF) {
+        while (length--) {
+            crc ^= (uint16_t)(*data++) << 8;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    // Writes the stuffed frame including the trailing zero into out, which
+    // must hold SERIAL_FRAME_MAX_ENCODED bytes. Returns 0 if the payload
+    // is too long.
+    static size_t encode(uint8_t channel, const uint8_t *payload, size_t length, uint8_t *out) {
+        if (length > SERIAL_FRAME_MAX_PAYLOAD) {
+            return 0;
+        }
+
+        uint8_t raw[SERIAL_FRAME_MAX_RAW];
+        raw[0] = channel;
+        raw[1] = (uint8_t)length;
+        memcpy(raw + 2, payload, length);
+        uint16_t crc = crc16(raw, length + 2);
+        raw[length + 2] = (uint8_t)(crc & 0xFF);
+        raw[length + 3] = (uint8_t)(crc >> 8);
+
+        size_t n = stuff(raw, length + 4, out);
+        out[n++] = 0;
+
+        return n;
+    }
+
+    // COBS encodes length bytes of in into out, without the delimiter.
+    static size_t stuff(const uint8_t *in, size_t length, uint8_t *out) {
+        size_t codeAt = 0;
+        size_t n = 1;
+        uint8_t code = 1;
+
+        for (size_t i = 0; i < length; i++) {
+            if (in[i] == 0) {
+                out[codeAt] = code;
+                codeAt = n++;
+                code = 1;
+                continue;
+            }
+
+            out[n++] = in[i];
+            if (++code == 0xFF) {
+                out[codeAt] = code;
+                codeAt = n++;
+                code = 1;
+            }
+        }
+        out[codeAt] = code;
+
+        return n;
+    }
+
+    // COBS decodes in place. Returns the decoded length, or -1 if the
+    // block is malformed.
+    static int unstuff(uint8_t *buf, size_t length) {
+        size_t in = 0;
+        size_t out = 0;
+
+        while (in < length) {
+            uint8_t code = buf[in++];
+            if (code == 0 || in + code - 1 > length) {
+                return -1;
+            }
+            for (uint8_t i = 1; i < code; i++) {
+                buf[out++] = buf[in++];
+            }
+            if (code != 0xFF && in < length) {
+                buf[out++] = 0;
+            }
+        }
+
+        return out;
+    }
+};
+
+/**
+ * Serial Frame Decoder
+ *
+ * Feed it the byte stream one byte at a time; push() returns true when a
+ * complete, CRC-checked frame is available through channel()/payload().
+ */
+class SerialFrameDecoder {
+public:
+    SerialFrameDecoder() : length(0), overflow(false), frameChannel(0), frameLength(0),
+        frames(0), crcErrors(0), malformed(0), overruns(0) {}
+
+    bool push(uint8_t c) {
+        if (c != 0) {
+            if (length < sizeof(buf)) {
+                buf[length++] = c;
+            } else {
+                overflow = true;
+            }
+            return false;
+        }
+
+        size_t received = length;
+        bool overflowed = overflow;
+        length = 0;
+        overflow = false;
+
+        if (received == 0) {
+            return false;
+        }
+        if (overflowed) {
+            overruns++;
+            return false;
+        }
+
+        int n = SerialFrame::unstuff(buf, received);
+        if (n < 4 || buf[1] != n - 4) {
+            malformed++;
+            return false;
+        }
+
+        uint16_t crc = (uint16_t)(buf[n - 2] | (buf[n - 1] << 8));
+        if (SerialFrame::crc16(buf, n - 2) != crc) {
+            crcErrors++;
+            return false;
+        }
+
+        frameChannel = buf[0];
+        frameLength = buf[1];
+        frames++;
+
+        return true;
+    }
+
+    uint8_t channel() const {
+        return frameChannel;
+    }
+
+    const uint8_t *payload() const {
+        return buf + 2;
+    }
+
+    size_t payloadLength() const {
+        return frameLength;
+    }
+
+    uint32_t getFrames() const {
+        return frames;
+    }
+
+    uint32_t getCrcErrors() const {
+        return crcErrors;
+    }
+
+    uint32_t getMalformed() const {
+        return malformed;
+    }
+
+    uint32_t getOverruns() const {
+        return overruns;
+    }
+
+private:
+    uint8_t buf[SERIAL_FRAME_MAX_ENCODED];
+    size_t length;
+    bool overflow;
+
+    uint8_t frameChannel;
+    uint8_t frameLength;
+
+    uint32_t frames;
+    uint32_t crcErrors;
+    uint32_t malformed;
+    uint32_t overruns;
+};
+
+#endif /* __SERIALFRAME_H__ */
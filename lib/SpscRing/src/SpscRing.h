@@ -0,0 +1,79 @@
+#ifndef __SPSCRING_H__
+#define __SPSCRING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+/**
+ * Single producer, single consumer ring
+ *
+ * Lock-free as long as push() is only called from one context (e.g. the
+ * WiFi receive callback) and pop() from another (e.g. loop()). Capacity
+ * must be a power of two; one slot is never used so that head == tail
+ * always means empty.
+ */
+template<typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0), overflows(0), highWater(0) {}
+
+    bool push(const T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t next = (h + 1) & (Capacity - 1);
+
+        if (next == tail.load(std::memory_order_acquire)) {
+            overflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        items[h] = item;
+        head.store(next, std::memory_order_release);
+
+        size_t used = (next - tail.load(std::memory_order_relaxed)) & (Capacity - 1);
+        if (used > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(used, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    bool pop(T &item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = items[t];
+        tail.store((t + 1) & (Capacity - 1), std::memory_order_release);
+
+        return true;
+    }
+
+    size_t size() const {
+        return (head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire)) & (Capacity - 1);
+    }
+
+    // Number of items rejected because the ring was full.
+    uint32_t getOverflows() const {
+        return overflows.load(std::memory_order_relaxed);
+    }
+
+    // Largest number of items that were queued at once.
+    size_t getHighWater() const {
+        return highWater.load(std::memory_order_relaxed);
+    }
+
+private:
+    T items[Capacity];
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<uint32_t> overflows;
+    std::atomic<size_t> highWater;
+};
+
+#endif /* __SPSCRING_H__ */
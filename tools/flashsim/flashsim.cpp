@@ -0,0 +1,186 @@
+/**
+ * flashsim - exercises the Edge Sensors ConfigStore on the simulated
+ * flash partition from lib/NativeHal.
+ *
+ *   flashsim wear [saves]     writes amplification and erase spread for a
+ *                             run of config saves
+ *   flashsim powerloss        cuts the power at every byte of an update
+ *                             that spans a sector change and checks that
+ *                             every key comes back with its old or new
+ *                             value and the store keeps working
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ConfigStore.h>
+
+#define SCHEMA 1
+#define SECTORS 4
+#define KEYS 8
+
+struct Settings {
+    char pitch[10];
+    char velocity[10];
+    uint8_t block[100];
+};
+
+static void fill(Settings &settings, int generation) {
+    memset(&settings, 0, sizeof(settings));
+    snprintf(settings.pitch, sizeof(settings.pitch), "%d", 36 + generation % 60);
+    snprintf(settings.velocity, sizeof(settings.velocity), "%d", 127 - generation % 100);
+    for (size_t i = 0; i < sizeof(settings.block); i++) {
+        settings.block[i] = (uint8_t)(i + (i < 8 ? generation : 0));
+    }
+}
+
+static bool save(ConfigStore &store, const Settings &settings) {
+    bool ok = store.put(0, settings.pitch, strlen(settings.pitch));
+    ok = store.put(1, settings.velocity, strlen(settings.velocity)) && ok;
+    return store.putBlock(2, settings.block, sizeof(settings.block)) && ok;
+}
+
+static void load(ConfigStore &store, Settings &settings) {
+    memset(&settings, 0, sizeof(settings));
+    store.get(0, settings.pitch, sizeof(settings.pitch) - 1);
+    store.get(1, settings.velocity, sizeof(settings.velocity) - 1);
+    store.getBlock(2, settings.block, sizeof(settings.block));
+}
+
+static int wear(int saves) {
+    FlashSim::format(SECTORS);
+
+    ConfigStore store;
+    if (!store.begin(SCHEMA)) {
+        fprintf(stderr, "begin failed\n");
+        return 1;
+    }
+
+    Settings settings;
+    for (int i = 0; i < saves; i++) {
+        fill(settings, i);
+        save(store, settings);
+    }
+
+    const ConfigStoreStats &stats = store.getStats();
+    printf("saves:              %d of %zu bytes\n", saves, sizeof(settings));
+    printf("puts:               %u, %u unchanged\n", stats.writes, stats.unchanged);
+    printf("value bytes:        %u\n", stats.bytesRequested);
+    printf("bytes programmed:   %lu (%.2fx the changed values, %.2fx the full settings)\n",
+           FlashSim::getBytesProgrammed(),
+           stats.bytesRequested ? (double)FlashSim::getBytesProgrammed() / stats.bytesRequested : 0.0,
+           (double)FlashSim::getBytesProgrammed() / ((double)saves * sizeof(settings)));
+    printf("sectors erased:     %lu (a whole-sector EEPROM commit would erase %d)\n", FlashSim::getSectorsErased(), saves);
+    printf("erases per sector:");
+    for (size_t i = 0; i < SECTORS; i++) {
+        printf(" %lu", FlashSim::getSectorErases(i));
+    }
+    printf("\n");
+
+    return 0;
+}
+
+// Builds a store whose head sector is almost full, so the update under
+// test crosses into the spare sector and compacts the oldest one.
+static void prepare(Settings &before) {
+    FlashSim::format(SECTORS);
+
+    ConfigStore store;
+    store.begin(SCHEMA);
+
+    int generation = 0;
+    fill(before, generation);
+    save(store, before);
+    while (FlashSim::getSectorsErased() < 3) {
+        fill(before, ++generation);
+        save(store, before);
+    }
+}
+
+static int powerloss() {
+    Settings before;
+    Settings after;
+    Settings loaded;
+
+    // Learn how many bytes the update programs and erases.
+    prepare(before);
+    unsigned long start = FlashSim::getBytesProgrammed() + FlashSim::getSectorsErased() * SPI_FLASH_SEC_SIZE;
+    {
+        ConfigStore store;
+        store.begin(SCHEMA);
+        for (int i = 0; i < 100; i++) {
+            fill(after, 1000 + i);
+            save(store, after);
+        }
+    }
+    long total = FlashSim::getBytesProgrammed() + FlashSim::getSectorsErased() * SPI_FLASH_SEC_SIZE - start;
+    printf("update programs and erases %ld bytes, %lu sector changes\n", total, FlashSim::getSectorsErased() - 3);
+
+    int failures = 0;
+    for (long cut = 0; cut < total; cut++) {
+        prepare(before);
+
+        // Saves generation by generation until the power goes.
+        FlashSim::cutPowerAfter(cut);
+        Settings committed = before;
+        {
+            ConfigStore store;
+            store.begin(SCHEMA);
+            for (int i = 0; i < 100 && FlashSim::isPowered(); i++) {
+                fill(after, 1000 + i);
+                if (save(store, after)) {
+                    committed = after;
+                }
+            }
+        }
+        FlashSim::powerOn();
+
+        ConfigStore store;
+        if (!store.begin(SCHEMA)) {
+            printf("cut at %ld: begin failed\n", cut);
+            failures++;
+            continue;
+        }
+        load(store, loaded);
+
+        // Each key holds the last value that was committed, or the one
+        // being written when the power went.
+        bool pitchOk = !strcmp(loaded.pitch, committed.pitch) || !strcmp(loaded.pitch, after.pitch);
+        bool velocityOk = !strcmp(loaded.velocity, committed.velocity) || !strcmp(loaded.velocity, after.velocity);
+        bool blockOk = true;
+        for (size_t i = 0; i < sizeof(loaded.block); i += CONFIG_STORE_MAX_VALUE) {
+            size_t n = sizeof(loaded.block) - i < CONFIG_STORE_MAX_VALUE ? sizeof(loaded.block) - i : CONFIG_STORE_MAX_VALUE;
+            blockOk = blockOk && (!memcmp(loaded.block + i, committed.block + i, n) || !memcmp(loaded.block + i, after.block + i, n));
+        }
+
+        fill(after, 7);
+        bool writable = save(store, after);
+        ConfigStore reopened;
+        reopened.begin(SCHEMA);
+        load(reopened, loaded);
+        writable = writable && !memcmp(&loaded, &after, sizeof(after));
+
+        if (!pitchOk || !velocityOk || !blockOk || !writable) {
+            printf("cut at %ld: pitch %s, velocity %s, block %s, writable %s\n", cut,
+                   pitchOk ? "ok" : "BAD", velocityOk ? "ok" : "BAD", blockOk ? "ok" : "BAD", writable ? "ok" : "BAD");
+            failures++;
+        }
+    }
+
+    printf("%ld power cuts, %d failures\n", total, failures);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "wear") == 0) {
+        return wear(argc >= 3 ? atoi(argv[2]) : 1000);
+    }
+    if (argc == 2 && strcmp(argv[1], "powerloss") == 0) {
+        return powerloss();
+    }
+
+    fprintf(stderr, "usage: %s wear [saves]\n"
+                    "       %s powerloss\n", argv[0], argv[0]);
+    return 2;
+}
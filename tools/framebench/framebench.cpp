@@ -0,0 +1,218 @@
+/**
+ * framebench - cost of the MidiFrame codec per event.
+ *
+ *   framebench [frames]   encodes and decodes frames of 1 to
+ *                         MIDI_FRAME_MAX_EVENTS events, checks that every
+ *                         event comes back as it went in, and prints the
+ *                         encode and decode cost per event next to the
+ *                         ASCII "144 60 100" messages the frames replaced,
+ *                         then the receiver's decode throughput in frames
+ *                         per second for accepted frames and for each
+ *                         reason a frame is rejected for
+ *
+ * Events vary per frame so the compiler cannot hoist the work out of the
+ * loops; a checksum of the output keeps it from dropping it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include <MidiFrame.h>
+
+#define ROUNDS 5
+#define ASCII_LENGTH 60
+
+static volatile uint32_t sink;
+
+static std::vector<MidiEvent> record(size_t frames, uint8_t count) {
+    std::vector<MidiEvent> events(frames * count);
+    srand(count);
+
+    // Event i of a frame carries the frame's sequence + i and an offset
+    // the wire can represent, as MidiBatch produces them.
+    for (size_t n = 0; n < events.size(); n++) {
+        MidiEvent &event = events[n];
+        event.status = rand() % 2 ? MIDI_STATUS_NOTE_ON : MIDI_STATUS_NOTE_OFF;
+        event.note = rand() % 128;
+        event.velocity = rand() % 128;
+        event.pad = rand() % 10;
+        event.sequence = (uint16_t)n;
+        event.flags = 0;
+        event.timestamp = (uint32_t)(n / count * 1000 + (n % count) * MIDI_EVENT_OFFSET_UNIT_US);
+    }
+
+    return events;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool same(const MidiEvent &a, const MidiEvent &b) {
+    return a.status == b.status && a.note == b.note && a.velocity == b.velocity && a.pad == b.pad &&
+           a.sequence == b.sequence && a.flags == b.flags && a.timestamp == b.timestamp;
+}
+
+// What midiOnHelper() and printReceivedMessage() did per event before
+// the binary frame.
+static double ascii(const std::vector<MidiEvent> &events) {
+    char message[ASCII_LENGTH];
+    char copy[40];
+    uint32_t sum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < events.size(); n++) {
+        int length = snprintf(message, sizeof(message), "%u %u %u", events[n].status, events[n].note, events[n].velocity);
+        memcpy(copy, message, length + 1);
+        for (char *token = strtok(copy, " "); token != NULL; token = strtok(NULL, " ")) {
+            sum += atoi(token);
+        }
+    }
+    double time = seconds(start);
+
+    sink = sum;
+    return time;
+}
+
+// Frames of count events, each broken the same way by corrupt.
+static double decodeRate(size_t frames, uint8_t count, void (*corrupt)(std::vector<uint8_t> &frame),
+                         FrameResult expected) {
+    std::vector<MidiEvent> events = record(frames, count);
+    std::vector<std::vector<uint8_t> > wire(frames);
+    for (size_t n = 0; n < frames; n++) {
+        uint8_t buf[MIDI_FRAME_MAX_LENGTH];
+        wire[n].assign(buf, buf + MidiFrame::encode(&events[n * count], count, buf));
+        if (corrupt) {
+            corrupt(wire[n]);
+        }
+    }
+
+    double best = 1e9;
+    for (int round = 0; round < ROUNDS; round++) {
+        MidiEvent decoded[MIDI_FRAME_MAX_EVENTS];
+        uint32_t sum = 0;
+        size_t wrong = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < frames; n++) {
+            uint8_t decodedCount;
+            FrameResult result = MidiFrame::decode(wire[n].data(), wire[n].size(), decoded, decodedCount);
+            sum += decodedCount;
+            wrong += result != expected;
+        }
+        double time = seconds(start);
+        sink = sum;
+        if (wrong) {
+            fprintf(stderr, "events=%u: frames not decoded as %d\n", count, expected);
+            exit(1);
+        }
+
+        best = time < best ? time : best;
+    }
+
+    return best;
+}
+
+static void truncate(std::vector<uint8_t> &frame) {
+    frame.resize(frame.size() - 1);
+}
+
+static void extend(std::vector<uint8_t> &frame) {
+    frame.push_back(0);
+}
+
+static void version(std::vector<uint8_t> &frame) {
+    frame[0] = MIDI_FRAME_VERSION + 1;
+}
+
+static void status(std::vector<uint8_t> &frame) {
+    frame[frame.size() - MIDI_EVENT_LENGTH] = 0xB0;
+}
+
+static void data(std::vector<uint8_t> &frame) {
+    frame[frame.size() - MIDI_EVENT_LENGTH + 1] |= 0x80;
+}
+
+int main(int argc, char **argv) {
+    size_t frames = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+
+    printf("events  bytes  encode ns/event  decode ns/event  ascii ns/event\n");
+    for (uint8_t count = 1; count <= MIDI_FRAME_MAX_EVENTS; count *= 2) {
+        std::vector<MidiEvent> events = record(frames, count);
+        std::vector<uint8_t> wire(frames * MIDI_FRAME_MAX_LENGTH);
+        std::vector<uint8_t> lengths(frames);
+        double encodeBest = 1e9;
+        double decodeBest = 1e9;
+        double asciiBest = 1e9;
+
+        for (int round = 0; round < ROUNDS; round++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (size_t n = 0; n < frames; n++) {
+                lengths[n] = (uint8_t)MidiFrame::encode(&events[n * count], count, &wire[n * MIDI_FRAME_MAX_LENGTH]);
+            }
+            double encodeTime = seconds(start);
+
+            MidiEvent decoded[MIDI_FRAME_MAX_EVENTS];
+            uint32_t sum = 0;
+            start = std::chrono::steady_clock::now();
+            for (size_t n = 0; n < frames; n++) {
+                uint8_t decodedCount;
+                FrameResult result = MidiFrame::decode(&wire[n * MIDI_FRAME_MAX_LENGTH], lengths[n], decoded, decodedCount);
+                sum += result + decodedCount + decoded[0].note + decoded[decodedCount - 1].timestamp;
+            }
+            double decodeTime = seconds(start);
+            sink = sum;
+
+            for (size_t n = 0; n < frames; n++) {
+                uint8_t decodedCount;
+                if (MidiFrame::decode(&wire[n * MIDI_FRAME_MAX_LENGTH], lengths[n], decoded, decodedCount) != FRAME_OK ||
+                    decodedCount != count) {
+                    fprintf(stderr, "events=%u frame %zu: not decoded\n", count, n);
+                    return 1;
+                }
+                for (uint8_t i = 0; i < count; i++) {
+                    if (!same(decoded[i], events[n * count + i])) {
+                        fprintf(stderr, "events=%u frame %zu: event %u differs\n", count, n, i);
+                        return 1;
+                    }
+                }
+            }
+
+            double asciiTime = ascii(events);
+
+            encodeBest = encodeTime < encodeBest ? encodeTime : encodeBest;
+            decodeBest = decodeTime < decodeBest ? decodeTime : decodeBest;
+            asciiBest = asciiTime < asciiBest ? asciiTime : asciiBest;
+        }
+
+        size_t perEvent = frames * count;
+        printf("%6u  %5u  %15.2f  %15.2f  %14.2f\n", count, lengths[0],
+               encodeBest * 1e9 / perEvent, decodeBest * 1e9 / perEvent, asciiBest * 1e9 / perEvent);
+    }
+
+    struct {
+        const char *name;
+        uint8_t count;
+        void (*corrupt)(std::vector<uint8_t> &frame);
+        FrameResult expected;
+    } cases[] = {
+        {"ok, 1 event", 1, NULL, FRAME_OK},
+        {"ok, 16 events", MIDI_FRAME_MAX_EVENTS, NULL, FRAME_OK},
+        {"too short", 4, truncate, FRAME_TOO_SHORT},
+        {"too long", 4, extend, FRAME_TOO_LONG},
+        {"bad version", 4, version, FRAME_BAD_VERSION},
+        {"bad status", 4, status, FRAME_BAD_STATUS},
+        {"bad data", 4, data, FRAME_BAD_DATA},
+    };
+
+    printf("\ndecode          frames/s  ns/frame\n");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        double time = decodeRate(frames, cases[i].count, cases[i].corrupt, cases[i].expected);
+        printf("%-13s  %10.0f  %8.2f\n", cases[i].name, frames / time, time * 1e9 / frames);
+    }
+
+    return 0;
+}
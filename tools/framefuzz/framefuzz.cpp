@@ -0,0 +1,284 @@
+/**
+ * framefuzz - fuzz target for everything the receiver decodes off the air.
+ *
+ *   make && ./framefuzz [-n inputs] [-s seed] [file...]
+ *   make fuzz && ./framefuzz-libfuzzer corpus/
+ *
+ * Each input goes through the decoders in the order printReceivedMessage()
+ * in SerialReceiver tries them: ClockSync, Discovery, MidiHeartbeat and
+ * MidiFrame. Under AddressSanitizer the input sits in a buffer of exactly
+ * its length, so a decoder reading past count is caught; UBSan catches
+ * shifts and overflows. Whatever a decoder accepts must encode back to the
+ * same bytes, else the input aborts.
+ *
+ * Without libFuzzer, files given on the command line are run once each;
+ * with none, the driver mutates valid frames of every kind (byte flips,
+ * truncation, extension, header fields) -n times.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <ClockSync.h>
+#include <Discovery.h>
+#include <MidiFrame.h>
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "framefuzz: %s\n", what);
+        abort();
+    }
+}
+
+static void fuzzClockSync(const uint8_t *data, size_t size) {
+    uint8_t buf[CLOCK_SYNC_REPLY_LENGTH];
+    uint32_t t1, t2, t3;
+
+    if (ClockSync::decodePing(data, size, t1)) {
+        check(ClockSync::encodePing(t1, buf) == size && memcmp(buf, data, size) == 0, "ping round trip");
+    }
+    if (ClockSync::decodeReply(data, size, t1, t2, t3)) {
+        ClockSync::encodeReply(t1, t2, buf);
+        ClockSync::stampReply(buf, t3);
+        check(memcmp(buf, data, size) == 0, "reply round trip");
+    }
+}
+
+static void fuzzDiscovery(const uint8_t *data, size_t size) {
+    uint8_t buf[DISCOVERY_MAX_LENGTH];
+    uint32_t nonce;
+    DiscoveryAnnounce announce;
+
+    if (Discovery::decodeHello(data, size, nonce)) {
+        check(Discovery::encodeHello(nonce, buf) == size && memcmp(buf, data, size) == 0, "hello round trip");
+    }
+    if (Discovery::decodeAnnounce(data, size, announce)) {
+        // A NUL inside the name cuts it short on the way back.
+        if (strlen(announce.name) == data[10]) {
+            check(Discovery::encodeAnnounce(announce, buf) == size && memcmp(buf, data, size) == 0,
+                  "announce round trip");
+        }
+    }
+}
+
+static void fuzzHeartbeat(const uint8_t *data, size_t size) {
+    uint8_t buf[MIDI_HEARTBEAT_LENGTH];
+    uint16_t sequence;
+    MidiNoteSet held;
+
+    if (MidiHeartbeat::decode(data, size, sequence, held)) {
+        check(MidiHeartbeat::encode(sequence, held, buf) == size && memcmp(buf + 1, data + 1, size - 1) == 0,
+              "heartbeat round trip");
+        check(MidiHeartbeat::isStandby(data) == (data[0] == MIDI_HEARTBEAT_STANDBY_MAGIC), "heartbeat standby");
+    }
+}
+
+static void fuzzFrame(const uint8_t *data, size_t size) {
+    MidiEvent events[MIDI_FRAME_MAX_EVENTS];
+    uint8_t eventCount = 0xFF;
+    FrameResult result = MidiFrame::decode(data, size, events, eventCount);
+
+    check(result < FRAME_RESULT_COUNT, "result out of range");
+    check((result == FRAME_OK) == (eventCount > 0), "event count without FRAME_OK");
+    if (result != FRAME_OK) {
+        return;
+    }
+
+    uint8_t buf[MIDI_FRAME_MAX_LENGTH];
+    check(MidiFrame::encode(events, eventCount, buf) == size && memcmp(buf, data, size) == 0, "frame round trip");
+
+    // The standby copy of an accepted frame is accepted too, with the flag.
+    memcpy(buf, data, size);
+    check(MidiFrame::markStandby(buf, size), "standby copy refused");
+    check(MidiFrame::decode(buf, size, events, eventCount) == FRAME_OK && (events[0].flags & MIDI_FLAG_STANDBY),
+          "standby copy");
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (ClockSync::isClockSync(data, size)) {
+        fuzzClockSync(data, size);
+        return 0;
+    }
+    if (Discovery::isDiscovery(data, size)) {
+        fuzzDiscovery(data, size);
+        return 0;
+    }
+
+    // Neither decoder may mind being handed any other input either.
+    fuzzClockSync(data, size);
+    fuzzDiscovery(data, size);
+    fuzzHeartbeat(data, size);
+    fuzzFrame(data, size);
+    return 0;
+}
+
+#ifdef FRAMEFUZZ_DRIVER
+
+#include <unistd.h>
+
+#define MAX_INPUT 256
+
+static uint32_t state = 1;
+
+static uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// One valid input of a random kind.
+static std::vector<uint8_t> seed() {
+    uint8_t buf[MAX_INPUT];
+    size_t length = 0;
+
+    switch (next() % 6) {
+        case 0: {
+            MidiEvent events[MIDI_FRAME_MAX_EVENTS];
+            uint8_t count = 1 + next() % MIDI_FRAME_MAX_EVENTS;
+            uint32_t timestamp = next();
+            for (uint8_t i = 0; i < count; i++) {
+                events[i].status = next() % 2 ? MIDI_STATUS_NOTE_ON : MIDI_STATUS_NOTE_OFF;
+                events[i].note = next() % 128;
+                events[i].velocity = next() % 128;
+                events[i].pad = next();
+                events[i].sequence = 0;
+                events[i].flags = next() % 2;
+                events[i].timestamp = timestamp + (next() % 0x100) * MIDI_EVENT_OFFSET_UNIT_US;
+            }
+            events[0].sequence = next();
+            events[0].timestamp = timestamp;
+            length = MidiFrame::encode(events, count, buf);
+            break;
+        }
+        case 1: {
+            MidiNoteSet held;
+            for (uint8_t i = 0; i < 4; i++) {
+                held.bits[i] = next();
+            }
+            length = MidiHeartbeat::encode(next(), held, buf);
+            break;
+        }
+        case 2:
+            length = Discovery::encodeHello(next(), buf);
+            break;
+        case 3: {
+            DiscoveryAnnounce announce;
+            announce.nonce = next();
+            announce.channel = next();
+            announce.capacity = next();
+            announce.peers = next();
+            snprintf(announce.name, sizeof(announce.name), "Slave_%u", next() % 1000);
+            length = Discovery::encodeAnnounce(announce, buf);
+            break;
+        }
+        case 4:
+            length = ClockSync::encodePing(next(), buf);
+            break;
+        default:
+            length = ClockSync::encodeReply(next(), next(), buf);
+            break;
+    }
+
+    return std::vector<uint8_t>(buf, buf + length);
+}
+
+static void mutate(std::vector<uint8_t> &input) {
+    int rounds = 1 + next() % 4;
+    for (int round = 0; round < rounds; round++) {
+        switch (next() % 5) {
+            case 0:
+                if (!input.empty()) {
+                    input[next() % input.size()] ^= 1 << (next() % 8);
+                }
+                break;
+            case 1:
+                if (!input.empty()) {
+                    input[next() % input.size()] = next();
+                }
+                break;
+            case 2:
+                input.resize(next() % (input.size() + 1));
+                break;
+            case 3:
+                if (input.size() < MAX_INPUT) {
+                    input.push_back(next());
+                }
+                break;
+            default:
+                // The count and name length bytes steer how much is read.
+                if (input.size() > 10) {
+                    input[next() % 2 ? 4 : 10] = next() % 32;
+                }
+                break;
+        }
+    }
+}
+
+// Copied into a buffer of exactly its size, so a read past the end trips
+// AddressSanitizer.
+static void run(const std::vector<uint8_t> &input) {
+    uint8_t *data = new uint8_t[input.size() ? input.size() : 1];
+    memcpy(data, input.data(), input.size());
+    LLVMFuzzerTestOneInput(data, input.size());
+    delete[] data;
+}
+
+static bool runFile(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror(path);
+        return false;
+    }
+
+    std::vector<uint8_t> input;
+    uint8_t buf[MAX_INPUT];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        input.insert(input.end(), buf, buf + n);
+    }
+    fclose(fp);
+
+    run(input);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    unsigned long inputs = 1000000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': inputs = strtoul(optarg, NULL, 10); break;
+            case 's': state = strtoul(optarg, NULL, 10) | 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-n inputs] [-s seed] [file...]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            if (!runFile(argv[i])) {
+                return 1;
+            }
+        }
+        printf("%d input(s) ok\n", argc - optind);
+        return 0;
+    }
+
+    for (unsigned long i = 0; i < inputs; i++) {
+        std::vector<uint8_t> input = seed();
+        if (i % 8 != 0) {
+            mutate(input);
+        }
+        run(input);
+    }
+    printf("%lu inputs ok\n", inputs);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Measures the host hop through hlbridge on a socat pty pair: hlbench
+# writes MIDI into one end, hlbridge reads the other and hlbench times the
+# events it gets back from the socket. Extra arguments go to hlbench.
+set -e
+cd "$(dirname "$0")"
+make -s
+
+dir=$(mktemp -d)
+trap 'kill $bridge $relay 2>/dev/null; rm -rf "$dir"' EXIT
+
+socat pty,raw,echo=0,link="$dir/in" pty,raw,echo=0,link="$dir/out" &
+relay=$!
+while [ ! -e "$dir/in" ] || [ ! -e "$dir/out" ]; do sleep 0.05; done
+
+./hlbridge -s "$dir/sock" "$dir/out" &
+bridge=$!
+while [ ! -S "$dir/sock" ]; do sleep 0.05; done
+
+./hlbench -s "$dir/sock" "$@" "$dir/in"
@@ -0,0 +1,131 @@
+/**
+ * hlbench - latency of the serial hop through hlbridge.
+ *
+ *   hlbench [-n count] [-i interval_us] [-s socket] <tty>
+ *
+ * Writes note-on/note-off messages into tty, the far end of the one
+ * hlbridge reads, and waits for each to come out of the bridge's socket.
+ * Prints percentiles of
+ *
+ *   ingest     write() to the bridge's timestamp, the tty hop
+ *   delivery   write() to the consumer's recv(), the whole host hop
+ *
+ * bench.sh sets this up with a socat pty pair.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "hlbridge.h"
+
+#define TIMEOUT_MS 1000
+
+static uint64_t nowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void report(const char *name, std::vector<uint64_t> &samples) {
+    if (samples.empty()) {
+        printf("%-9s no samples\n", name);
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    printf("%-9s p50=%llu p90=%llu p99=%llu max=%llu us\n", name,
+           (unsigned long long)samples[n / 2], (unsigned long long)samples[n * 9 / 10],
+           (unsigned long long)samples[n * 99 / 100], (unsigned long long)samples[n - 1]);
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = 10000;
+    unsigned long intervalUs = 1000;
+    const char *socketPath = HLBRIDGE_SOCKET;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:i:s:")) != -1) {
+        switch (opt) {
+            case 'n': count = strtoul(optarg, NULL, 10); break;
+            case 'i': intervalUs = strtoul(optarg, NULL, 10); break;
+            case 's': socketPath = optarg; break;
+            default: optind = argc + 1; break;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "usage: %s [-n count] [-i interval_us] [-s socket] <tty>\n", argv[0]);
+        return 2;
+    }
+
+    int tty = open(argv[optind], O_RDWR | O_NOCTTY);
+    if (tty < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    struct termios tio;
+    if (tcgetattr(tty, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(tty, TCSANOW, &tio);
+    }
+
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror(socketPath);
+        return 1;
+    }
+
+    std::vector<uint64_t> ingest;
+    std::vector<uint64_t> delivery;
+    unsigned long lost = 0;
+    unsigned long wrong = 0;
+
+    for (unsigned long i = 0; i < count; i++) {
+        uint8_t message[3] = {(uint8_t)(i & 1 ? 0x80 : 0x90), (uint8_t)((i >> 1) & 0x7F), (uint8_t)(i & 1 ? 0 : 100)};
+
+        uint64_t sentAt = nowMicros();
+        if (write(tty, message, sizeof(message)) != (ssize_t)sizeof(message)) {
+            perror("write");
+            return 1;
+        }
+
+        struct pollfd pfd = {sock, POLLIN, 0};
+        BridgeEvent event;
+        if (poll(&pfd, 1, TIMEOUT_MS) != 1 || recv(sock, &event, sizeof(event), 0) != (ssize_t)sizeof(event)) {
+            lost++;
+            continue;
+        }
+        uint64_t receivedAt = nowMicros();
+
+        if (event.status != message[0] || event.data1 != message[1] || event.data2 != message[2]) {
+            wrong++;
+        }
+        ingest.push_back(event.timestamp - sentAt);
+        delivery.push_back(receivedAt - sentAt);
+
+        if (intervalUs) {
+            usleep(intervalUs);
+        }
+    }
+
+    printf("%lu messages, %lu lost, %lu mismatched\n", count, lost, wrong);
+    report("ingest", ingest);
+    report("delivery", delivery);
+    return lost || wrong ? 1 : 0;
+}
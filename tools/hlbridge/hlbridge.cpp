@@ -0,0 +1,351 @@
+/**
+ * hlbridge - hands the receiver's MIDI output to local programs.
+ *
+ *   hlbridge [-b baud] [-s socket] [-r] [-f] <tty>
+ *
+ *   -b baud     UART speed, default 115200
+ *   -s socket   path of the SOCK_SEQPACKET socket consumers connect to,
+ *               default HLBRIDGE_SOCKET
+ *   -r          accept running status
+ *   -f          the receiver was built with SERIAL_FRAMED=1: MIDI is taken
+ *               from the MIDI channel, log and telemetry go to stdout
+ *
+ * Every MIDI message read from the tty goes to every connected consumer
+ * as one BridgeEvent (see hlbridge.h). A consumer that does not keep up
+ * loses events rather than holding up the others; the event sequence
+ * numbers show the gap. SIGUSR1 prints the counters, which are printed on
+ * exit too. The tty can be a pty, see bench.sh.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+#include <vector>
+
+#include <SerialFrame.h>
+
+#include "hlbridge.h"
+
+#define MAX_CLIENTS 16
+#define READ_SIZE 256
+
+struct Client {
+    int fd;
+    uint32_t sent;
+    uint32_t dropped;
+};
+
+static volatile sig_atomic_t stopping = 0;
+static volatile sig_atomic_t statsRequested = 0;
+
+static std::vector<Client> clients;
+static uint32_t sequence = 0;
+static uint64_t bytesRead = 0;
+
+static void onSignal(int signal) {
+    if (signal == SIGUSR1) {
+        statsRequested = 1;
+    } else {
+        stopping = 1;
+    }
+}
+
+static uint64_t nowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static speed_t speedFor(long baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return B0;
+    }
+}
+
+// Raw 8N1, reads return as soon as one byte is there. On real UARTs the
+// driver is also asked to skip its receive batching.
+static int openTty(const char *path, long baud) {
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        perror("tcgetattr");
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    speed_t speed = speedFor(baud);
+    if (speed == B0) {
+        fprintf(stderr, "unsupported baud rate %ld\n", baud);
+        close(fd);
+        return -1;
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        perror("tcsetattr");
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIFLUSH);
+
+#ifdef __linux__
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &serial);
+    }
+#endif
+
+    return fd;
+}
+
+static int listenOn(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        close(fd);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, MAX_CLIENTS) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void dropClient(int epoll, size_t i) {
+    epoll_ctl(epoll, EPOLL_CTL_DEL, clients[i].fd, NULL);
+    close(clients[i].fd);
+    clients.erase(clients.begin() + i);
+}
+
+static void acceptClients(int epoll, int listener) {
+    int fd;
+    while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if (clients.size() == MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+
+        // Consumers only read; EPOLLRDHUP tells us when one went away.
+        struct epoll_event ev;
+        ev.events = EPOLLRDHUP;
+        ev.data.fd = fd;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev);
+
+        Client client = {fd, 0, 0};
+        clients.push_back(client);
+    }
+}
+
+static void publish(int epoll, BridgeEvent &event) {
+    event.sequence = sequence++;
+
+    for (size_t i = 0; i < clients.size();) {
+        ssize_t n = send(clients[i].fd, &event, sizeof(event), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n == (ssize_t)sizeof(event)) {
+            clients[i].sent++;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            clients[i].dropped++;
+        } else {
+            dropClient(epoll, i);
+            continue;
+        }
+        i++;
+    }
+}
+
+static void printStats(const MidiStreamParser &parser, const SerialFrameDecoder &decoder, bool framed) {
+    fprintf(stderr, "hlbridge: %llu bytes read, %u events, %u bytes dropped",
+            (unsigned long long)bytesRead, sequence, parser.getDropped());
+    if (framed) {
+        fprintf(stderr, ", %u frames, %u crc errors, %u malformed, %u overruns",
+                decoder.getFrames(), decoder.getCrcErrors(), decoder.getMalformed(), decoder.getOverruns());
+    }
+    fprintf(stderr, "\n");
+    for (size_t i = 0; i < clients.size(); i++) {
+        fprintf(stderr, "hlbridge: consumer %zu sent=%u dropped=%u\n", i, clients[i].sent, clients[i].dropped);
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-b baud] [-s socket] [-r] [-f] <tty>\n", name);
+}
+
+int main(int argc, char **argv) {
+    long baud = 115200;
+    const char *socketPath = HLBRIDGE_SOCKET;
+    bool runningStatus = false;
+    bool framed = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s:rf")) != -1) {
+        switch (opt) {
+            case 'b': baud = strtol(optarg, NULL, 10); break;
+            case 's': socketPath = optarg; break;
+            case 'r': runningStatus = true; break;
+            case 'f': framed = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int tty = openTty(argv[optind], baud);
+    if (tty < 0) {
+        return 1;
+    }
+    int listener = listenOn(socketPath);
+    if (listener < 0) {
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = tty;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, tty, &ev);
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &ev);
+
+    fprintf(stderr, "hlbridge: %s at %ld baud, consumers on %s\n", argv[optind], baud, socketPath);
+
+    MidiStreamParser parser(runningStatus);
+    SerialFrameDecoder decoder;
+    struct epoll_event events[MAX_CLIENTS + 2];
+
+    while (!stopping) {
+        int n = epoll_wait(epoll, events, MAX_CLIENTS + 2, -1);
+        if (statsRequested) {
+            statsRequested = 0;
+            printStats(parser, decoder, framed);
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listener) {
+                acceptClients(epoll, listener);
+                continue;
+            }
+
+            if (fd != tty) {
+                for (size_t c = 0; c < clients.size(); c++) {
+                    if (clients[c].fd == fd) {
+                        dropClient(epoll, c);
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            uint8_t buf[READ_SIZE];
+            ssize_t length = read(tty, buf, sizeof(buf));
+            if (length <= 0) {
+                if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+                    continue;
+                }
+                // The other end of a pty went away, or the adapter was
+                // unplugged.
+                fprintf(stderr, "hlbridge: %s closed\n", argv[optind]);
+                stopping = 1;
+                break;
+            }
+
+            BridgeEvent event;
+            event.timestamp = nowMicros();
+            bytesRead += length;
+
+            for (ssize_t b = 0; b < length; b++) {
+                if (!framed) {
+                    if (parser.push(buf[b], event)) {
+                        publish(epoll, event);
+                    }
+                    continue;
+                }
+
+                if (!decoder.push(buf[b])) {
+                    continue;
+                }
+                if (decoder.channel() == SERIAL_CHANNEL_MIDI) {
+                    for (size_t p = 0; p < decoder.payloadLength(); p++) {
+                        if (parser.push(decoder.payload()[p], event)) {
+                            publish(epoll, event);
+                        }
+                    }
+                } else if (decoder.channel() == SERIAL_CHANNEL_LOG || decoder.channel() == SERIAL_CHANNEL_TELEMETRY) {
+                    fwrite(decoder.payload(), 1, decoder.payloadLength(), stdout);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    printStats(parser, decoder, framed);
+    unlink(socketPath);
+    return 0;
+}
@@ -0,0 +1,145 @@
+#ifndef __HLBRIDGE_H__
+#define __HLBRIDGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// -- Consumers connect to the bridge's SOCK_SEQPACKET Unix socket and get
+//    one BridgeEvent per packet, in host byte order. timestamp is
+//    CLOCK_MONOTONIC in microseconds, taken when the read() that returned
+//    the message's last byte came back.
+#define HLBRIDGE_SOCKET "/tmp/hlbridge.sock"
+
+struct BridgeEvent {
+    uint64_t timestamp;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint8_t length;         // bytes of the MIDI message, status included
+    uint32_t sequence;      // per bridge, gaps mean this consumer fell behind
+};
+
+/**
+ * MIDI Stream Parser
+ *
+ * Splits the receiver's raw MIDI byte stream into messages. Data bytes
+ * only count after a status byte, so after line noise or text on the
+ * UART the parser picks up again at the next status byte. Running status
+ * is off by default: the receiver's MIDI library always sends the
+ * status, and trusting it would turn stray text into notes. Realtime
+ * bytes may appear anywhere and do not disturb a message in progress;
+ * system exclusive is skipped.
+ */
+class MidiStreamParser {
+public:
+    MidiStreamParser(bool runningStatus = false) : runningStatus(runningStatus), status(0), expected(0), count(0),
+        inSysex(false), dropped(0) {}
+
+    // Returns true when byte completed a message.
+    bool push(uint8_t byte, BridgeEvent &event) {
+        if (byte >= 0xF8) {
+            event.status = byte;
+            event.data1 = 0;
+            event.data2 = 0;
+            event.length = 1;
+            return true;
+        }
+
+        if (byte & 0x80) {
+            inSysex = false;
+            if (count < expected) {
+                dropped += count + 1;   // a message cut short, status included
+            }
+            count = 0;
+
+            if (byte == 0xF0 || byte == 0xF7) {
+                inSysex = byte == 0xF0;
+                status = 0;
+                expected = 0;
+                return false;
+            }
+
+            status = byte;
+            expected = dataLength(byte);
+            if (expected == 0) {
+                if (byte == 0xF4 || byte == 0xF5) {
+                    dropped++;
+                    status = 0;
+                    return false;
+                }
+                return complete(event);
+            }
+            return false;
+        }
+
+        if (inSysex) {
+            return false;
+        }
+        if (status == 0 || count == expected) {
+            // No status to attach the byte to, either after noise or
+            // because running status is off.
+            if (status == 0 || !runningStatus || status >= 0xF0) {
+                dropped++;
+                return false;
+            }
+            count = 0;
+        }
+
+        data[count++] = byte;
+        if (count == expected) {
+            return complete(event);
+        }
+        return false;
+    }
+
+    uint32_t getDropped() const {
+        return dropped;
+    }
+
+private:
+    bool runningStatus;
+    uint8_t status;
+    uint8_t expected;
+    uint8_t count;
+    uint8_t data[2];
+    bool inSysex;
+    uint32_t dropped;
+
+    static uint8_t dataLength(uint8_t status) {
+        switch (status & 0xF0) {
+            case 0xC0:
+            case 0xD0:
+                return 1;
+            case 0xF0:
+                break;
+            default:
+                return 2;
+        }
+
+        switch (status) {
+            case 0xF1:
+            case 0xF3:
+                return 1;
+            case 0xF2:
+                return 2;
+            default:
+                return 0;
+        }
+    }
+
+    bool complete(BridgeEvent &event) {
+        event.status = status;
+        event.data1 = expected > 0 ? data[0] : 0;
+        event.data2 = expected > 1 ? data[1] : 0;
+        event.length = 1 + expected;
+
+        // System common messages cancel running status.
+        if (status >= 0xF0) {
+            status = 0;
+        }
+        count = expected;
+        return true;
+    }
+};
+
+#endif /* __HLBRIDGE_H__ */
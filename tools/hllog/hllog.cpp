@@ -0,0 +1,105 @@
+/**
+ * hllog - host side of the edge sensors' deferred log.
+ *
+ *   hllog [-t] [file]   reads a sensor's serial output from file or stdin
+ *                       and writes it to stdout with every LogRing record
+ *                       turned back into its text; -t puts the sensor's
+ *                       micros() at logging in front of each record
+ *
+ * Text printed directly by the firmware passes through unchanged, so the
+ * output reads like the serial monitor of a LOG_BINARY=0 build.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <LogRing.h>
+
+static bool timestamps = false;
+static size_t records = 0;
+static size_t corrupt = 0;
+
+static void printRecord(const LogRecord &record) {
+    char line[LOG_LINE_LENGTH];
+    LogCodec::format(record, line, sizeof(line));
+    if (timestamps) {
+        printf("%10u.%06u ", record.at / 1000000, record.at % 1000000);
+    }
+    printf("%s\n", line);
+    records++;
+}
+
+// Consumes what it can of buf, returns the number of bytes used. A record
+// cut off at the end of buf is left for the next call unless at end.
+static size_t decode(const uint8_t *buf, size_t count, bool end) {
+    size_t used = 0;
+    while (used < count) {
+        const uint8_t *at = buf + used;
+        size_t left = count - used;
+
+        if (at[0] != LOG_MAGIC) {
+            const uint8_t *magic = (const uint8_t *)memchr(at, LOG_MAGIC, left);
+            size_t text = magic ? magic - at : left;
+            fwrite(at, 1, text, stdout);
+            used += text;
+            continue;
+        }
+
+        if (!end && (left < 3 || (at[2] <= LOG_MAX_ARGS && left < LOG_RECORD_HEADER_LENGTH + 4u * at[2] + 1))) {
+            break;
+        }
+
+        LogRecord record;
+        size_t length = LogCodec::decode(at, left, record);
+        if (length == 0) {
+            fputc(at[0], stdout);
+            corrupt++;
+            used++;
+            continue;
+        }
+
+        printRecord(record);
+        used += length;
+    }
+    return used;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "t")) != -1) {
+        if (opt != 't') {
+            fprintf(stderr, "usage: %s [-t] [file]\n", argv[0]);
+            return 2;
+        }
+        timestamps = true;
+    }
+
+    FILE *in = stdin;
+    if (optind < argc) {
+        in = fopen(argv[optind], "rb");
+        if (!in) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    uint8_t buf[4096];
+    size_t pending = 0;
+    ssize_t n;
+    // read() rather than fread(), so a live port is printed as it arrives.
+    while ((n = read(fileno(in), buf + pending, sizeof(buf) - pending)) > 0) {
+        pending += n;
+        size_t used = decode(buf, pending, false);
+        memmove(buf, buf + used, pending - used);
+        pending -= used;
+        fflush(stdout);
+    }
+    decode(buf, pending, true);
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    fprintf(stderr, "%zu records, %zu corrupt\n", records, corrupt);
+    return 0;
+}
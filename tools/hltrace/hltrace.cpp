@@ -0,0 +1,198 @@
+/**
+ * hltrace - host side of the receiver's frame capture.
+ *
+ *   hltrace capture <file>   reads the receiver's serial output on stdin
+ *                            after a 't' trace request and writes the
+ *                            FrameTrace records it contains to file
+ *   hltrace print <file>     lists the records of a trace file
+ *
+ * Both raw mode ("trace <hex>" lines) and SERIAL_FRAMED mode (frames on
+ * SERIAL_CHANNEL_TRACE) are understood. A trace file is replayed through
+ * the receiver's native build with HL_REPLAY=<file>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <ClockSync.h>
+#include <Discovery.h>
+#include <FrameTrace.h>
+#include <MidiFrame.h>
+#include <SerialFrame.h>
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Writes one dumped record, skipping the magic that starts every dump.
+static bool writeRecord(FILE *out, const uint8_t *data, size_t length, size_t &records) {
+    if (length == TRACE_MAGIC_LENGTH && memcmp(data, TRACE_MAGIC, TRACE_MAGIC_LENGTH) == 0) {
+        return true;
+    }
+
+    TraceRecord record;
+    if (FrameTrace::decode(data, length, record) != length) {
+        return false;
+    }
+
+    fwrite(data, 1, length, out);
+    records++;
+    return true;
+}
+
+static int capture(const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        return 1;
+    }
+    fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LENGTH, out);
+
+    SerialFrameDecoder decoder;
+    std::string line;
+    size_t records = 0;
+    size_t bad = 0;
+    int c;
+
+    while ((c = getchar()) != EOF) {
+        if (decoder.push((uint8_t)c)) {
+            if (decoder.channel() == SERIAL_CHANNEL_TRACE &&
+                !writeRecord(out, decoder.payload(), decoder.payloadLength(), records)) {
+                bad++;
+            }
+            continue;
+        }
+
+        if (c != '\n' && c != '\r') {
+            if (line.size() < 2 * TRACE_MAX_RECORD_LENGTH + 16) {
+                line += (char)c;
+            }
+            continue;
+        }
+
+        // Raw mode shares the UART with MIDI bytes, so only look at the
+        // tail of the line for the prefix.
+        size_t at = line.rfind("trace ");
+        if (at != std::string::npos) {
+            std::vector<uint8_t> data;
+            bool ok = true;
+            for (size_t i = at + 6; i + 1 < line.size(); i += 2) {
+                int hi = hexValue(line[i]);
+                int lo = hexValue(line[i + 1]);
+                if (hi < 0 || lo < 0) {
+                    ok = false;
+                    break;
+                }
+                data.push_back((uint8_t)(hi << 4 | lo));
+            }
+            if (!ok || !writeRecord(out, data.data(), data.size(), records)) {
+                bad++;
+            }
+        }
+        line.clear();
+    }
+
+    fclose(out);
+    fprintf(stderr, "%zu records written to %s, %zu malformed\n", records, path, bad);
+    return 0;
+}
+
+static int print(const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+
+    std::vector<uint8_t> bytes;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        bytes.insert(bytes.end(), buf, buf + n);
+    }
+    fclose(in);
+
+    if (bytes.size() < TRACE_MAGIC_LENGTH || memcmp(bytes.data(), TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0) {
+        fprintf(stderr, "%s is not a frame trace\n", path);
+        return 1;
+    }
+
+    size_t offset = TRACE_MAGIC_LENGTH;
+    TraceRecord record;
+    uint32_t first = 0;
+    size_t index = 0;
+    while ((n = FrameTrace::decode(bytes.data() + offset, bytes.size() - offset, record)) > 0) {
+        if (index == 0) {
+            first = record.timestamp;
+        }
+
+        MidiEvent events[MIDI_FRAME_MAX_EVENTS];
+        uint8_t eventCount = 0;
+        FrameResult result = MidiFrame::decode(record.data, record.length, events, eventCount);
+
+        printf("%5zu %10.6f %02X:%02X:%02X:%02X:%02X:%02X len=%u",
+               index, (record.timestamp - first) / 1e6,
+               record.mac[0], record.mac[1], record.mac[2], record.mac[3], record.mac[4], record.mac[5],
+               record.length);
+        uint32_t nonce;
+        uint32_t t1, t2, t3;
+        DiscoveryAnnounce announce;
+        uint16_t sequence;
+        MidiNoteSet held;
+        if (MidiHeartbeat::decode(record.data, record.length, sequence, held)) {
+            printf(" heartbeat seq=%u held=", sequence);
+            const char *separator = "";
+            for (int note = 0; note < 128; note++) {
+                if (held.test(note)) {
+                    printf("%s%d", separator, note);
+                    separator = ",";
+                }
+            }
+        } else if (ClockSync::decodePing(record.data, record.length, t1)) {
+            printf(" ping t1=%u", t1);
+        } else if (ClockSync::decodeReply(record.data, record.length, t1, t2, t3)) {
+            printf(" reply t1=%u t2=%u t3=%u rtt=%d", t1, t2, t3, (int32_t)(record.timestamp - t1) - (int32_t)(t3 - t2));
+        } else if (Discovery::decodeHello(record.data, record.length, nonce)) {
+            printf(" hello nonce=%08X", nonce);
+        } else if (Discovery::decodeAnnounce(record.data, record.length, announce)) {
+            printf(" announce nonce=%08X %s channel=%u capacity=%u", announce.nonce, announce.name, announce.channel, announce.capacity);
+        } else if (result == FRAME_OK) {
+            printf(" seq=%u", events[0].sequence);
+            for (uint8_t i = 0; i < eventCount; i++) {
+                printf(" %02X/%u/%u+%u", events[i].status, events[i].note, events[i].velocity,
+                       events[i].timestamp - events[0].timestamp);
+            }
+        } else {
+            printf(" invalid (%d)", result);
+        }
+        printf("\n");
+
+        offset += n;
+        index++;
+    }
+
+    if (offset != bytes.size()) {
+        fprintf(stderr, "%zu trailing bytes ignored\n", bytes.size() - offset);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "capture") == 0) {
+        return capture(argv[2]);
+    }
+    if (argc == 3 && strcmp(argv[1], "print") == 0) {
+        return print(argv[2]);
+    }
+
+    fprintf(stderr, "usage: %s capture <file> < /dev/ttyUSB0\n"
+                    "       %s print <file>\n", argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,1224 @@
+/**
+ * netsim - how many sensors and touches one receiver keeps up with.
+ *
+ *   netsim [-n sensors] [-t touches] [-p pads] [-r receivers] [-c channels]
+ *          [-l loss] [-j jitter] [-m mbps] [-b baud] [-P delay] [-D ppm] [-d seconds]
+ *          [-k ms] [-s seed] [-f]
+ *
+ *   -n sensors    comma separated sensor counts to sweep, default 1,2,4,8,16,32
+ *   -t touches    comma separated touch rates per pad and second to sweep,
+ *                 default 0.5,1,2,4,8
+ *   -p pads       pads per sensor, default 1
+ *   -r receivers  receivers, sensors are spread over them round robin as
+ *                 discovery would, default 1. A sensor whose channel has
+ *                 another receiver takes the next one as its standby
+ *   -c channels   WiFi channels the receivers are spread over, default 1
+ *   -l loss       fraction of data frames, and separately of acks, lost on
+ *                 the air, default 0.01
+ *   -j jitter     receive and send-status callbacks run up to this many
+ *                 microseconds late, default 300
+ *   -m mbps       PHY rate of ESP-NOW frames, default 1
+ *   -b baud       receiver UART speed, default 115200
+ *   -P delay      receiver playout delay in microseconds, default
+ *                 PLAYOUT_DELAY_US; 0 plays notes as they arrive
+ *   -D ppm        sensor clocks run up to this fast or slow, default 20
+ *   -d seconds    simulated time per run, default 10
+ *   -k ms         receiver 0 dies this long into each run, default never
+ *   -s seed       random seed, default 1
+ *   -f            the receivers were built with SERIAL_FRAMED=1
+ *
+ * Every sensor runs the loop of Edge Sensors/src/main.cpp: PadEngine,
+ * MidiBatch, SendQueue with heartbeats and standby mirroring, failing
+ * over after FAILOVER_FAILED_SENDS failed sends, dropping a standby after
+ * STANDBY_LOST_MIRRORS failed copies, and forgetting its receivers after
+ * RECEIVER_LOST_DROPS drops in a row. Every receiver runs
+ * the loop of SerialReceiver: PeerTable, the event ring, heartbeat
+ * reconciliation, the standby role, clock pings and the playout queue,
+ * and the UART. Every node has its own clock, sensors with a random
+ * offset and drift. The firmwares themselves are one global program each,
+ * so the loops are rebuilt here from the same libraries; keep them in
+ * step when either main.cpp changes. Discovery is not simulated: a sensor
+ * that lost its receivers is away for the backoff plus one discovery
+ * window and then pairs with the same ones again.
+ *
+ * The ESP-NOW medium is one 802.11b DCF channel per WiFi channel: long
+ * preamble, carrier sense with DIFS and a random backoff frozen while the
+ * air is busy, frames that start in the same slot collide, and every
+ * unicast is acked. The UART drains at baud / 10 bytes per second behind a
+ * UART_FIFO byte FIFO; a full FIFO stalls the receiver loop as a blocking
+ * write would.
+ *
+ * Latency is from the scan that raised an event to the last byte of its
+ * MIDI message leaving the UART. An event counts as dropped when it never
+ * reaches the UART, whatever the reason; the columns after drop% show the
+ * reasons that are counted.
+ *
+ * All receivers feed one synthesizer. A note-on for a note it already
+ * plays counts as doubled, a note still playing once the run drained as
+ * stuck. switch is the longest time from the first unacked send to the
+ * primary to the failover.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <queue>
+#include <vector>
+
+#include <ClockSync.h>
+#include <LatencyStats.h>
+#include <MidiFrame.h>
+#include <PadEngine.h>
+#include <PeerTable.h>
+#include <PlayoutQueue.h>
+#include <SendQueue.h>
+#include <SerialFrame.h>
+#include <SpscRing.h>
+
+// -- Mirrors of the firmware defines, see the two main.cpp files.
+#define BATCH_WINDOW_US 1500
+#define HEARTBEAT_MS 1000
+#define RECEIVER_LOST_DROPS 3
+#define FAILOVER_FAILED_SENDS 4
+#define STANDBY_LOST_MIRRORS 5
+#define DISCOVERY_WINDOW_MS 20
+#define DISCOVERY_BACKOFF_MIN_MS 250
+#define DISCOVERY_BACKOFF_MAX_MS 30000
+#define EVENT_QUEUE_SIZE 64
+#define HEARTBEAT_QUEUE_SIZE 8
+#define PEER_SILENCE_MS 3000
+#define SYNC_QUEUE_SIZE 8
+#define PLAYOUT_QUEUE_SIZE 128
+#define PLAYOUT_DELAY_US 5000
+#define PLAYOUT_MAX_DELAY_US 100000
+#define CLOCK_SYNC_INTERVAL_MS 500
+
+// -- Loop periods. A sensor loop is bounded by touchRead(), the pads are
+//    sampled every TOUCH_SAMPLE_PERIOD_US of it; the receiver loop only by
+//    its queues.
+#define SENSOR_LOOP_US 500
+#define RECEIVER_LOOP_US 50
+#define UART_FIFO 128
+
+// -- 802.11b DCF timing in microseconds. An ESP-NOW frame is a vendor
+//    specific action frame: MAC header, FCS, category, OUI, random bytes
+//    and the vendor element header come on top of the payload.
+#define AIR_PREAMBLE_US 192
+#define AIR_SIFS_US 10
+#define AIR_DIFS_US 50
+#define AIR_SLOT_US 20
+#define AIR_CW_MIN 31
+#define AIR_FRAME_OVERHEAD 43
+#define AIR_ACK_LENGTH 14
+
+// -- Touches are held for TOUCH_HOLD_MS and at least TOUCH_GAP_MS apart,
+//    which caps a pad at about 12 touches a second.
+#define TOUCH_HOLD_MS 60
+#define TOUCH_GAP_MS 20
+// -- After the last touch the run keeps going until a receiver that lost its
+//    sensor has released the notes (PEER_SILENCE_MS past the last heartbeat)
+//    and a sensor has given up on its last frame, so a note still playing at
+//    the end is really stuck and not just waiting on a timeout.
+#define DRAIN_MS (PEER_SILENCE_MS + HEARTBEAT_MS + \
+                  (SEND_QUEUE_RETRIES + 1) * SEND_QUEUE_TIMEOUT_MS)
+#define RAISED_SLOTS 1024
+
+struct Options {
+    std::vector<int> sensors;
+    std::vector<double> touches;
+    int pads;
+    int receivers;
+    int channels;
+    double loss;
+    uint32_t jitterUs;
+    double mbps;
+    long baud;
+    uint32_t playoutUs;
+    double driftPpm;
+    double seconds;
+    double killMs;
+    uint32_t seed;
+    bool framed;
+};
+
+struct Totals {
+    uint64_t offered;
+    uint64_t delivered;
+    uint64_t unpaired;
+    uint64_t queueFull;
+    uint64_t retriesOut;
+    uint64_t ringFull;
+    uint64_t duplicates;
+    uint64_t released;
+    uint64_t lostReceiver;
+    uint64_t collisions;
+    uint64_t late;
+    uint64_t failovers;
+    uint64_t switchUs;
+    uint64_t doubled;
+    uint64_t stuck;
+    LatencyHistogram latency;
+    std::vector<MidiNoteSet> sounding;
+};
+
+static uint32_t rngState = 1;
+
+// xorshift32, so runs are repeatable with the same seed on any libc.
+static uint32_t rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static double uniform() {
+    return (rng() >> 8) / 16777216.0;
+}
+
+static uint64_t exponentialUs(double perSecond) {
+    return (uint64_t)(-log(1.0 - uniform()) / perSecond * 1e6);
+}
+
+static uint8_t eventsIn(const uint8_t *frame, size_t length) {
+    return length > MIDI_FRAME_HEADER_LENGTH && frame[0] == MIDI_FRAME_VERSION ? frame[4] : 0;
+}
+
+enum AirEventKind {
+    AIR_TO_RECEIVER,
+    AIR_TO_SENSOR,
+    AIR_SEND_STATUS
+};
+
+/**
+ * Air Event
+ *
+ * Something the medium hands to a node at a given time: a frame for a
+ * receive callback or a send status for a sensor.
+ */
+struct AirEvent {
+    uint64_t at;
+    uint32_t order;
+    AirEventKind kind;
+    bool ok;
+    int node;
+    int source;
+    uint8_t length;
+    uint8_t data[SEND_QUEUE_FRAME_SIZE];
+
+    bool operator>(const AirEvent &other) const {
+        return at != other.at ? at > other.at : order > other.order;
+    }
+};
+
+typedef std::priority_queue<AirEvent, std::vector<AirEvent>, std::greater<AirEvent> > AirEvents;
+
+/**
+ * Medium
+ *
+ * One WiFi channel. Each sensor has at most one frame waiting for the air,
+ * as the send queue only starts a frame once the previous one completed;
+ * receivers only send clock pings. Broadcasts reach the sensors that
+ * listen to the sending receiver and are not acked. A receiver that is
+ * down neither hears nor acks anything.
+ */
+class Medium {
+public:
+    Medium(const Options &options, AirEvents &events, uint32_t &order) : options(options), events(events),
+        order(order), busyUntil(0), busyUs(0), collisions(0), down(-1) {}
+
+    void listen(int sensor, int receiver) {
+        listeners.push_back(std::make_pair(sensor, receiver));
+    }
+
+    void kill(int receiver) {
+        down = receiver;
+    }
+
+    void broadcast(int receiver, const uint8_t *data, size_t length, uint64_t now) {
+        send(-1, receiver, data, length, now);
+    }
+
+    void send(int sensor, int receiver, const uint8_t *data, size_t length, uint64_t now) {
+        Station station;
+        station.sensor = sensor;
+        station.receiver = receiver;
+        station.readyAt = now;
+        station.slots = rng() % (AIR_CW_MIN + 1);
+        station.length = length;
+        memcpy(station.data, data, length);
+        stations.push_back(station);
+    }
+
+    // Starts every transmission that wins the air before time to.
+    void advance(uint64_t to) {
+        while (!stations.empty()) {
+            uint64_t first = UINT64_MAX;
+            for (size_t i = 0; i < stations.size(); i++) {
+                first = startOf(stations[i]) < first ? startOf(stations[i]) : first;
+            }
+            if (first > to) {
+                return;
+            }
+
+            std::vector<Station> senders;
+            uint64_t end = first;
+            for (size_t i = 0; i < stations.size();) {
+                uint64_t start = startOf(stations[i]);
+                if (start < first + AIR_SLOT_US) {
+                    senders.push_back(stations[i]);
+                    stations.erase(stations.begin() + i);
+                    continue;
+                }
+
+                // Counted down while the air was idle, frozen from now on.
+                uint64_t counting = countFrom(stations[i]);
+                if (first > counting) {
+                    stations[i].slots -= (first - counting) / AIR_SLOT_US;
+                }
+                i++;
+            }
+
+            bool collided = senders.size() > 1;
+            if (collided) {
+                collisions += senders.size();
+            }
+            for (size_t i = 0; i < senders.size(); i++) {
+                uint64_t done = transmit(senders[i], first, collided);
+                end = done > end ? done : end;
+            }
+
+            busyUs += end - first;
+            busyUntil = end;
+        }
+    }
+
+    uint64_t getBusyUs() const {
+        return busyUs;
+    }
+
+    uint64_t getCollisions() const {
+        return collisions;
+    }
+
+private:
+    struct Station {
+        int sensor;
+        int receiver;
+        uint64_t readyAt;
+        uint32_t slots;
+        uint8_t length;
+        uint8_t data[SEND_QUEUE_FRAME_SIZE];
+    };
+
+    const Options &options;
+    AirEvents &events;
+    uint32_t &order;
+    std::vector<Station> stations;
+    std::vector<std::pair<int, int> > listeners;
+    uint64_t busyUntil;
+    uint64_t busyUs;
+    uint64_t collisions;
+    int down;
+
+    uint64_t airtime(size_t length) const {
+        return AIR_PREAMBLE_US + (uint64_t)ceil((length + AIR_FRAME_OVERHEAD) * 8 / options.mbps);
+    }
+
+    uint64_t countFrom(const Station &station) const {
+        return (station.readyAt > busyUntil ? station.readyAt : busyUntil) + AIR_DIFS_US;
+    }
+
+    uint64_t startOf(const Station &station) const {
+        return countFrom(station) + (uint64_t)station.slots * AIR_SLOT_US;
+    }
+
+    uint64_t late() const {
+        return options.jitterUs ? rng() % (options.jitterUs + 1) : 0;
+    }
+
+    // Queues the receive callback and the send status for one frame sent
+    // at start, returns when the exchange is over. A sender whose frame
+    // or ack was lost finds out when the ack would have been in.
+    uint64_t transmit(const Station &station, uint64_t start, bool collided) {
+        uint64_t received = start + airtime(station.length);
+        uint64_t done = received + AIR_SIFS_US + airtime(AIR_ACK_LENGTH);
+
+        AirEvent event;
+        if (station.sensor < 0) {
+            for (size_t i = 0; i < listeners.size(); i++) {
+                if (listeners[i].second != station.receiver || collided || uniform() < options.loss) {
+                    continue;
+                }
+                event.at = received + late();
+                event.order = order++;
+                event.kind = AIR_TO_SENSOR;
+                event.ok = true;
+                event.node = listeners[i].first;
+                event.source = station.receiver;
+                event.length = station.length;
+                memcpy(event.data, station.data, station.length);
+                events.push(event);
+            }
+            return received;
+        }
+
+        bool arrived = !collided && station.receiver != down && uniform() >= options.loss;
+        bool acked = arrived && uniform() >= options.loss;
+
+        if (arrived) {
+            event.at = received + late();
+            event.order = order++;
+            event.kind = AIR_TO_RECEIVER;
+            event.ok = true;
+            event.node = station.receiver;
+            event.source = station.sensor;
+            event.length = station.length;
+            memcpy(event.data, station.data, station.length);
+            events.push(event);
+        }
+
+        event.at = done + late();
+        event.order = order++;
+        event.kind = AIR_SEND_STATUS;
+        event.ok = acked;
+        event.node = station.sensor;
+        event.source = station.sensor;
+        event.length = 0;
+        events.push(event);
+
+        return done;
+    }
+};
+
+/**
+ * Sensor
+ *
+ * The loop of Edge Sensors/src/main.cpp once paired, fed by a touch
+ * schedule instead of touchRead(). Its micros() runs offset and at a
+ * slightly different rate from simulated time, as a crystal would.
+ */
+class Sensor {
+public:
+    // Boards are not powered up in the same millisecond; heartbeats in
+    // lockstep would collide every second.
+    Sensor(int id, int receiver, int standby, Medium &medium, const Options &options, double rate, Totals &totals) :
+        id(id), receiver(receiver), standby(standby), medium(medium), totals(totals), rate(rate), paired(true),
+        pairAt(0), droppedInARow(0), receiverLost(false), failedInARow(0), failedOver(false), mirrorFailedInARow(0), failingSince(0), sentAt(0), backoff(DISCOVERY_BACKOFF_MIN_MS),
+        now(0) {
+        clockOffset = rng();
+        clockPpm = (2 * uniform() - 1) * options.driftPpm;
+        heartbeatAt = 0UL - rng() % HEARTBEAT_MS;
+        for (int i = 0; i < options.pads; i++) {
+            pads.addPad(i, 36 + i, 100);
+            touchAt[i] = exponentialUs(rate);
+            releaseAt[i] = 0;
+        }
+        sequence = (uint16_t)rng();
+
+        queue.onTransmit([this](const uint8_t *frame, size_t length) {
+            uint8_t reply[CLOCK_SYNC_REPLY_LENGTH];
+            if (ClockSync::isReply(frame, length)) {
+                memcpy(reply, frame, length);
+                ClockSync::stampReply(reply, (uint32_t)local(this->now));
+                frame = reply;
+            }
+            this->medium.send(this->id, this->receiver, frame, length, this->now);
+            this->sentAt = this->now;
+            return true;
+        });
+        queue.onMirror([this](const uint8_t *frame, size_t length) {
+            uint8_t copy[SEND_QUEUE_FRAME_SIZE];
+            memcpy(copy, frame, length);
+            if (this->standby < 0 || !MidiFrame::markStandby(copy, length)) {
+                return false;
+            }
+            this->medium.send(this->id, this->standby, copy, length, this->now);
+            return true;
+        });
+        queue.onFailed([this](const PendingFrame &frame) {
+            (void)frame;
+            if (this->failedInARow++ == 0) {
+                this->failingSince = this->sentAt;
+            }
+            if (this->standby >= 0 && !this->failedOver && this->failedInARow >= FAILOVER_FAILED_SENDS) {
+                failOver();
+                return true;
+            }
+            return false;
+        });
+        queue.onDropped([this](const PendingFrame &frame) {
+            this->totals.retriesOut += eventsIn(frame.data, frame.length);
+            if (this->paired && ++this->droppedInARow >= RECEIVER_LOST_DROPS) {
+                this->receiverLost = true;
+            }
+        });
+    }
+
+    // One pass of loop() at time now. Pads are only touched again while
+    // touching is set.
+    void loop(uint64_t now, bool touching) {
+        this->now = now;
+        unsigned long micros = (uint32_t)local(now);
+        unsigned long millis = (unsigned long)(local(now) / 1000);
+
+        uint16_t samples[PAD_ENGINE_MAX_PADS];
+        for (uint8_t i = 0; i < pads.size(); i++) {
+            if (releaseAt[i] != 0 && now >= releaseAt[i]) {
+                releaseAt[i] = 0;
+                uint64_t gap = touching ? exponentialUs(rate) : UINT64_MAX / 2;
+                uint64_t earliest = (TOUCH_HOLD_MS + TOUCH_GAP_MS) * 1000ULL;
+                touchAt[i] = now + (gap > earliest ? gap : earliest) - TOUCH_HOLD_MS * 1000ULL;
+            } else if (releaseAt[i] == 0 && now >= touchAt[i]) {
+                releaseAt[i] = now + TOUCH_HOLD_MS * 1000ULL;
+            }
+            samples[i] = (releaseAt[i] != 0 ? 55 : 100) + rng() % 5;
+        }
+
+        if (!paired) {
+            // The firmware does not scan while it looks for a receiver;
+            // whatever the player does meanwhile is lost.
+            PadMask changed = pads.scan([&samples](uint8_t pin) { return samples[pin]; }, micros);
+            totals.unpaired += __builtin_popcount(changed);
+            totals.offered += __builtin_popcount(changed);
+            if (now >= pairAt) {
+                paired = true;
+                droppedInARow = 0;
+                failedOver = false;
+            }
+            return;
+        }
+
+        if (pads.scan([&samples](uint8_t pin) { return samples[pin]; }, micros)) {
+            for (uint8_t i = 0; i < pads.size(); i++) {
+                if (pads.getPressed() & (1 << i)) {
+                    raise(MIDI_STATUS_NOTE_ON, i);
+                }
+                if (pads.getReleased() & (1 << i)) {
+                    raise(MIDI_STATUS_NOTE_OFF, i);
+                }
+            }
+        }
+
+        if (millis - heartbeatAt >= HEARTBEAT_MS) {
+            sendHeartbeat();
+        }
+        answerPings();
+
+        if (!batch.isEmpty() && micros - batch.getStartedAt() >= BATCH_WINDOW_US) {
+            flushBatch();
+        }
+        queue.loop(millis);
+        forgetIfLost();
+    }
+
+    // receiveMessage(): pings from the primary are answered, the standby's
+    // are not.
+    void receive(int source, const uint8_t *buf, size_t count, uint64_t at) {
+        ReceivedPing ping;
+        if (ClockSync::decodePing(buf, count, ping.t1) && paired && source == receiver) {
+            ping.t2 = (uint32_t)local(at);
+            pingQueue.push(ping);
+        }
+    }
+
+    void onSendStatus(bool ok) {
+        if (queue.isMirroring()) {
+            mirrorSent(ok);
+        } else if (ok) {
+            droppedInARow = 0;
+            failedInARow = 0;
+            failedOver = false;
+            backoff = DISCOVERY_BACKOFF_MIN_MS;
+        }
+        queue.onSendComplete(ok);
+        forgetIfLost();
+    }
+
+    uint64_t raisedAt(uint16_t sequence) const {
+        return raised[sequence % RAISED_SLOTS];
+    }
+
+private:
+    struct ReceivedPing {
+        uint32_t t1;
+        uint32_t t2;
+    };
+
+    int id;
+    int receiver;
+    int standby;
+    Medium &medium;
+    Totals &totals;
+    double rate;
+    uint64_t clockOffset;
+    double clockPpm;
+    SpscRing<ReceivedPing, 4> pingQueue;
+
+    PadEngine pads;
+    MidiBatch batch;
+    SendQueue queue;
+    uint16_t sequence;
+    uint64_t touchAt[PAD_ENGINE_MAX_PADS];
+    uint64_t releaseAt[PAD_ENGINE_MAX_PADS];
+    uint64_t raised[RAISED_SLOTS];
+
+    bool paired;
+    uint64_t pairAt;
+    uint8_t droppedInARow;
+    bool receiverLost;
+    uint8_t failedInARow;
+    bool failedOver;
+    uint8_t mirrorFailedInARow;
+    uint64_t failingSince;
+    uint64_t sentAt;
+    unsigned long backoff;
+    unsigned long heartbeatAt;
+    uint64_t now;
+
+    uint64_t local(uint64_t now) const {
+        return clockOffset + now + (int64_t)(now * clockPpm / 1e6);
+    }
+
+    void raise(uint8_t status, uint8_t pad) {
+        MidiEvent event;
+        event.status = status;
+        event.note = pads.getNote(pad);
+        event.velocity = pads.getVelocity(pad);
+        event.pad = pad;
+        event.sequence = sequence++;
+        event.flags = 0;
+        event.timestamp = (uint32_t)local(now);
+
+        raised[event.sequence % RAISED_SLOTS] = now;
+        totals.offered++;
+
+        batch.add(event, event.timestamp);
+        if (batch.isFull()) {
+            flushBatch();
+        }
+    }
+
+    void flushBatch() {
+        uint8_t frame[MIDI_FRAME_MAX_LENGTH];
+        size_t length = batch.encode(frame);
+        if (!queue.push(frame, length)) {
+            totals.queueFull += eventsIn(frame, length);
+        }
+    }
+
+    void sendHeartbeat() {
+        MidiNoteSet held;
+        held.clear();
+        for (uint8_t i = 0; i < pads.size(); i++) {
+            if (pads.getTouched() & (1 << i)) {
+                held.set(pads.getNote(i));
+            }
+        }
+
+        if (!batch.isEmpty()) {
+            flushBatch();
+        }
+
+        uint8_t frame[MIDI_HEARTBEAT_LENGTH];
+        size_t length = MidiHeartbeat::encode(sequence, held, frame);
+        queue.push(frame, length);
+        heartbeatAt = (unsigned long)(local(now) / 1000);
+    }
+
+    void answerPings() {
+        ReceivedPing ping;
+        while (pingQueue.pop(ping)) {
+            uint8_t frame[CLOCK_SYNC_REPLY_LENGTH];
+            size_t length = ClockSync::encodeReply(ping.t1, ping.t2, frame);
+            queue.push(frame, length);
+        }
+    }
+
+    void failOver() {
+        int failed = receiver;
+        receiver = standby;
+        standby = failed;
+        failedInARow = 0;
+        failedOver = true;
+        mirrorFailedInARow = 0;
+        totals.failovers++;
+        if (now - failingSince > totals.switchUs) {
+            totals.switchUs = now - failingSince;
+        }
+    }
+
+    // A standby that stopped acking its copies is dropped.
+    void mirrorSent(bool ok) {
+        if (ok) {
+            mirrorFailedInARow = 0;
+        } else if (standby >= 0 && ++mirrorFailedInARow >= STANDBY_LOST_MIRRORS) {
+            standby = -1;
+        }
+    }
+
+    // The drop callback only marks the receivers lost, the queue must not
+    // be cleared from inside it.
+    void forgetIfLost() {
+        if (receiverLost) {
+            receiverLost = false;
+            forget();
+        }
+    }
+
+    // Frames still queued are lost with the receivers. The status of the
+    // frame on the air may still come in and is then ignored.
+    void forget() {
+        totals.lostReceiver++;
+        paired = false;
+        pairAt = now + (backoff + DISCOVERY_WINDOW_MS) * 1000ULL;
+        backoff = backoff * 2 < DISCOVERY_BACKOFF_MAX_MS ? backoff * 2 : DISCOVERY_BACKOFF_MAX_MS;
+        queue.clear();
+        batch.encode(scratch);
+    }
+
+    uint8_t scratch[MIDI_FRAME_MAX_LENGTH];
+};
+
+/**
+ * Receiver
+ *
+ * The receive callback and loop() of SerialReceiver in front of a UART
+ * that drains at the configured baud rate. Its micros() is simulated time.
+ */
+class Receiver {
+public:
+    Receiver(int id, Medium &medium, const Options &options, Totals &totals, std::vector<Sensor *> &sensors) :
+        id(id), medium(medium), options(options), totals(totals), sensors(sensors), pingAt(0), uartFreeAt(0), now(0) {
+        byteNs = 10ULL * 1000000000ULL / options.baud;
+        memset(heldNotes, 0, sizeof(heldNotes));
+        memset(nextSequence, 0, sizeof(nextSequence));
+        memset(sourceOf, 0, sizeof(sourceOf));
+        memset(pendingNotes, 0, sizeof(pendingNotes));
+        memset(lastDueAt, 0, sizeof(lastDueAt));
+        memset(standbyFor, 0, sizeof(standbyFor));
+    }
+
+    // printReceivedMessage(), with the sensor number standing in for its MAC.
+    void receive(int source, const uint8_t *buf, size_t count, uint64_t now) {
+        uint8_t mac[PEER_MAC_LENGTH] = {0x24, 0x0A, 0xC4, (uint8_t)(source >> 16), (uint8_t)(source >> 8), (uint8_t)source};
+
+        if (ClockSync::isClockSync(buf, count)) {
+            ReceivedSync sync;
+            if (ClockSync::decodeReply(buf, count, sync.t1, sync.t2, sync.t3)) {
+                Peer *peer = peerTable.find(mac);
+                if (peer) {
+                    sourceOf[peer->index] = source;
+                    sync.peer = peer->index;
+                    sync.t4 = (uint32_t)now;
+                    syncQueue.push(sync);
+                }
+            }
+            return;
+        }
+
+        ReceivedHeartbeat heartbeat;
+        if (MidiHeartbeat::decode(buf, count, heartbeat.sequence, heartbeat.held)) {
+            Peer *peer = peerTable.find(mac);
+            if (peer) {
+                peer->lastSeen = (uint32_t)(now / 1000);
+                sourceOf[peer->index] = source;
+                heartbeat.peer = peer->index;
+                heartbeat.standby = MidiHeartbeat::isStandby(buf);
+                heartbeatQueue.push(heartbeat);
+            }
+            return;
+        }
+
+        MidiEvent events[MIDI_FRAME_MAX_EVENTS];
+        uint8_t eventCount;
+        if (MidiFrame::decode(buf, count, events, eventCount) != FRAME_OK) {
+            return;
+        }
+
+        Peer *peer = peerTable.find(mac);
+        if (!peer) {
+            return;
+        }
+
+        sourceOf[peer->index] = source;
+        peer->lastSeen = (uint32_t)(now / 1000);
+        if (!PeerTable::accept(*peer, events[0].sequence, eventCount)) {
+            totals.duplicates++;
+            return;
+        }
+
+        ReceivedEvent received;
+        received.peer = peer->index;
+        for (uint8_t i = 0; i < eventCount; i++) {
+            received.event = events[i];
+            if (!eventQueue.push(received)) {
+                totals.ringFull++;
+            }
+        }
+    }
+
+    void loop(uint64_t now) {
+        this->now = now;
+        dispatchEvents();
+        reconcileHeartbeats();
+        releaseSilentPeers();
+        syncClocks();
+        if (!playDue()) {
+            return;
+        }
+        pingSensors();
+    }
+
+    uint64_t getUartBusyNs() const {
+        return uartBusyNs;
+    }
+
+private:
+    struct ReceivedEvent {
+        MidiEvent event;
+        uint8_t peer;
+    };
+
+    struct ReceivedHeartbeat {
+        uint8_t peer;
+        bool standby;
+        uint16_t sequence;
+        MidiNoteSet held;
+    };
+
+    struct ReceivedSync {
+        uint8_t peer;
+        uint32_t t1;
+        uint32_t t2;
+        uint32_t t3;
+        uint32_t t4;
+    };
+
+    struct ScheduledNote {
+        uint8_t peer;
+        uint8_t status;
+        uint8_t note;
+        uint8_t velocity;
+        bool fromEvent;
+        uint16_t sequence;
+    };
+
+    int id;
+    Medium &medium;
+    const Options &options;
+    Totals &totals;
+    std::vector<Sensor *> &sensors;
+
+    SpscRing<ReceivedEvent, EVENT_QUEUE_SIZE> eventQueue;
+    SpscRing<ReceivedHeartbeat, HEARTBEAT_QUEUE_SIZE> heartbeatQueue;
+    SpscRing<ReceivedSync, SYNC_QUEUE_SIZE> syncQueue;
+    PeerTable peerTable;
+    MidiNoteSet heldNotes[PEER_TABLE_MAX_PEERS];
+    uint16_t nextSequence[PEER_TABLE_MAX_PEERS];
+    bool standbyFor[PEER_TABLE_MAX_PEERS];
+    int sourceOf[PEER_TABLE_MAX_PEERS];
+    ClockEstimator sensorClocks[PEER_TABLE_MAX_PEERS];
+    uint8_t pendingNotes[PEER_TABLE_MAX_PEERS];
+    uint32_t lastDueAt[PEER_TABLE_MAX_PEERS];
+    PlayoutQueue<ScheduledNote, PLAYOUT_QUEUE_SIZE> playoutQueue;
+    uint64_t pingAt;
+
+    uint64_t byteNs;
+    uint64_t uartFreeAt;
+    uint64_t uartBusyNs = 0;
+    uint64_t now;
+
+    size_t messageLength() const {
+        if (!options.framed) {
+            return 3;
+        }
+        uint8_t message[3] = {MIDI_STATUS_NOTE_ON, 60, 100};
+        uint8_t out[SERIAL_FRAME_MAX_ENCODED];
+        return SerialFrame::encode(SERIAL_CHANNEL_MIDI, message, sizeof(message), out);
+    }
+
+    // False when the UART FIFO has no room for a message: the blocking
+    // write would hold loop() here until it has.
+    bool roomForMessage() const {
+        uint64_t nowNs = now * 1000;
+        uint64_t queued = uartFreeAt > nowNs ? (uartFreeAt - nowNs + byteNs - 1) / byteNs : 0;
+        return queued + messageLength() <= UART_FIFO;
+    }
+
+    // Returns when the message's last byte is out, in microseconds.
+    uint64_t emitNote() {
+        uint64_t nowNs = now * 1000;
+        uint64_t length = messageLength();
+        uartFreeAt = (uartFreeAt > nowNs ? uartFreeAt : nowNs) + length * byteNs;
+        uartBusyNs += length * byteNs;
+        return uartFreeAt / 1000;
+    }
+
+    void dispatchEvents() {
+        ReceivedEvent received;
+        while (eventQueue.pop(received)) {
+            const MidiEvent &event = received.event;
+
+            standbyFor[received.peer] = event.flags & MIDI_FLAG_STANDBY;
+            if (!standbyFor[received.peer]) {
+                ScheduledNote note;
+                note.peer = received.peer;
+                note.status = event.status;
+                note.note = event.note;
+                note.velocity = event.velocity;
+                note.fromEvent = true;
+                note.sequence = event.sequence;
+                schedule(note, dueAt(received.peer, event.timestamp));
+            }
+
+            if ((event.status & 0xF0) == MIDI_STATUS_NOTE_ON && event.velocity > 0) {
+                heldNotes[received.peer].set(event.note);
+            } else {
+                heldNotes[received.peer].reset(event.note);
+            }
+            nextSequence[received.peer] = event.sequence + 1;
+        }
+    }
+
+    void syncClocks() {
+        ReceivedSync sync;
+        while (syncQueue.pop(sync)) {
+            sensorClocks[sync.peer].addSample(sync.t1, sync.t2, sync.t3, sync.t4);
+        }
+    }
+
+    void pingSensors() {
+        if (now - pingAt < CLOCK_SYNC_INTERVAL_MS * 1000ULL) {
+            return;
+        }
+        pingAt = now;
+
+        uint8_t buf[CLOCK_SYNC_PING_LENGTH];
+        size_t length = ClockSync::encodePing((uint32_t)now, buf);
+        medium.broadcast(id, buf, length, now);
+    }
+
+    uint32_t dueAt(uint8_t peer, uint32_t timestamp) {
+        uint32_t now = (uint32_t)this->now;
+        const ClockEstimator &clock = sensorClocks[peer];
+        if (options.playoutUs == 0 || !clock.isSynced()) {
+            return now;
+        }
+
+        int32_t wait = (int32_t)(clock.toLocal(timestamp, now) + options.playoutUs - now);
+        if (wait < 0) {
+            totals.late++;
+            return now;
+        }
+        return now + (wait <= PLAYOUT_MAX_DELAY_US ? wait : options.playoutUs);
+    }
+
+    void schedule(const ScheduledNote &note, uint32_t due) {
+        if (pendingNotes[note.peer] > 0 && (int32_t)(due - lastDueAt[note.peer]) < 0) {
+            due = lastDueAt[note.peer];
+        }
+
+        if (playoutQueue.size() == PLAYOUT_QUEUE_SIZE) {
+            ScheduledNote earliest;
+            playoutQueue.pop(earliest);
+            play(earliest);
+            totals.late++;
+        }
+
+        playoutQueue.push(due, note);
+        pendingNotes[note.peer]++;
+        lastDueAt[note.peer] = due;
+    }
+
+    // False when the UART FIFO filled up with notes still due.
+    bool playDue() {
+        ScheduledNote note;
+        while (roomForMessage()) {
+            if (!playoutQueue.popDue((uint32_t)now, note)) {
+                return true;
+            }
+            play(note);
+        }
+        return playoutQueue.size() == 0 || (int32_t)(playoutQueue.nextDueAt() - (uint32_t)now) > 0;
+    }
+
+    void play(const ScheduledNote &note) {
+        pendingNotes[note.peer]--;
+        MidiNoteSet &sounding = totals.sounding[sourceOf[note.peer]];
+        if (note.status == MIDI_STATUS_NOTE_ON) {
+            totals.doubled += sounding.test(note.note);
+            sounding.set(note.note);
+        } else {
+            sounding.reset(note.note);
+        }
+
+        uint64_t sentAt = emitNote();
+        if (note.fromEvent) {
+            uint64_t raisedAt = sensors[sourceOf[note.peer]]->raisedAt(note.sequence);
+            totals.latency.record((uint32_t)(sentAt - raisedAt));
+            totals.delivered++;
+        }
+    }
+
+    void reconcileHeartbeats() {
+        ReceivedHeartbeat heartbeat;
+        while (heartbeatQueue.pop(heartbeat)) {
+            standbyFor[heartbeat.peer] = heartbeat.standby;
+            int16_t ahead = (int16_t)(nextSequence[heartbeat.peer] - heartbeat.sequence);
+            if (ahead > 0 && ahead < PEER_REPLAY_WINDOW) {
+                continue;
+            }
+            releaseNotes(heartbeat.peer, heartbeat.held);
+        }
+    }
+
+    void releaseSilentPeers() {
+        MidiNoteSet none;
+        none.clear();
+
+        uint32_t millis = (uint32_t)(now / 1000);
+        for (uint8_t i = 0; i < peerTable.size(); i++) {
+            if (heldNotes[i].any() && millis - peerTable.get(i)->lastSeen > PEER_SILENCE_MS) {
+                releaseNotes(i, none);
+            }
+        }
+    }
+
+    void releaseNotes(uint8_t peer, const MidiNoteSet &keep) {
+        MidiNoteSet &held = heldNotes[peer];
+        ScheduledNote off;
+        off.peer = peer;
+        off.status = MIDI_STATUS_NOTE_OFF;
+        off.velocity = 0;
+        off.fromEvent = false;
+
+        for (uint8_t word = 0; word < 4; word++) {
+            uint32_t stale = held.bits[word] & ~keep.bits[word];
+            while (stale) {
+                off.note = word * 32 + __builtin_ctz(stale);
+                stale &= stale - 1;
+                if (!standbyFor[peer]) {
+                    schedule(off, (uint32_t)now);
+                    totals.released++;
+                }
+            }
+            held.bits[word] &= keep.bits[word];
+        }
+    }
+};
+
+struct Result {
+    Totals totals;
+    double airBusy;
+    double uartBusy;
+};
+
+static void run(const Options &options, int sensorCount, double rate, Result &result) {
+    Totals &totals = result.totals;
+    totals = Totals();
+    totals.sounding.assign(sensorCount, MidiNoteSet());
+    rngState = options.seed ? options.seed : 1;
+
+    AirEvents events;
+    uint32_t order = 0;
+    std::vector<Medium *> media;
+    for (int c = 0; c < options.channels; c++) {
+        media.push_back(new Medium(options, events, order));
+    }
+
+    std::vector<Sensor *> sensors;
+    std::vector<Receiver *> receivers;
+    for (int r = 0; r < options.receivers; r++) {
+        receivers.push_back(new Receiver(r, *media[r % options.channels], options, totals, sensors));
+    }
+    for (int s = 0; s < sensorCount; s++) {
+        int r = s % options.receivers;
+        int standby = (r + options.channels) % options.receivers;
+        standby = standby != r ? standby : -1;
+        sensors.push_back(new Sensor(s, r, standby, *media[r % options.channels], options, rate, totals));
+        media[r % options.channels]->listen(s, r);
+        if (standby >= 0) {
+            media[r % options.channels]->listen(s, standby);
+        }
+    }
+
+    uint64_t touchUntil = (uint64_t)(options.seconds * 1e6);
+    uint64_t end = touchUntil + DRAIN_MS * 1000ULL;
+    uint64_t killAt = options.killMs > 0 ? (uint64_t)(options.killMs * 1000) : UINT64_MAX;
+
+    // Sensor loops are spread over the scan period, as they would be on
+    // boards powered up at different times.
+    for (uint64_t now = 0; now < end; now += RECEIVER_LOOP_US) {
+        if (now >= killAt) {
+            media[0]->kill(0);
+        }
+        for (size_t c = 0; c < media.size(); c++) {
+            media[c]->advance(now);
+        }
+        while (!events.empty() && events.top().at <= now) {
+            const AirEvent &event = events.top();
+            if (event.kind == AIR_TO_RECEIVER) {
+                if (event.node != 0 || now < killAt) {
+                    receivers[event.node]->receive(event.source, event.data, event.length, event.at);
+                }
+            } else if (event.kind == AIR_TO_SENSOR) {
+                sensors[event.node]->receive(event.source, event.data, event.length, event.at);
+            } else {
+                sensors[event.node]->onSendStatus(event.ok);
+            }
+            events.pop();
+        }
+
+        for (size_t r = now < killAt ? 0 : 1; r < receivers.size(); r++) {
+            receivers[r]->loop(now);
+        }
+
+        uint64_t phase = now % SENSOR_LOOP_US / RECEIVER_LOOP_US;
+        for (size_t s = phase; s < sensors.size(); s += SENSOR_LOOP_US / RECEIVER_LOOP_US) {
+            sensors[s]->loop(now, now < touchUntil);
+        }
+    }
+
+    uint64_t busy = 0;
+    for (size_t c = 0; c < media.size(); c++) {
+        busy += media[c]->getBusyUs();
+        totals.collisions += media[c]->getCollisions();
+        delete media[c];
+    }
+    uint64_t uartNs = 0;
+    for (size_t r = 0; r < receivers.size(); r++) {
+        uartNs += receivers[r]->getUartBusyNs();
+        delete receivers[r];
+    }
+    for (size_t s = 0; s < sensors.size(); s++) {
+        MidiNoteSet &sounding = totals.sounding[s];
+        for (uint8_t word = 0; word < 4; word++) {
+            totals.stuck += __builtin_popcount(sounding.bits[word]);
+        }
+        delete sensors[s];
+    }
+
+    result.airBusy = (double)busy / media.size() / end;
+    result.uartBusy = (double)uartNs / 1000 / receivers.size() / end;
+}
+
+template<typename T>
+static bool parseList(const char *text, std::vector<T> &list, T (*convert)(const char *)) {
+    list.clear();
+    while (*text) {
+        T value = convert(text);
+        if (value <= 0) {
+            return false;
+        }
+        list.push_back(value);
+        text = strchr(text, ',');
+        if (!text) {
+            break;
+        }
+        text++;
+    }
+    return !list.empty();
+}
+
+static int toInt(const char *text) {
+    return atoi(text);
+}
+
+static double toDouble(const char *text) {
+    return atof(text);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n sensors] [-t touches] [-p pads] [-r receivers] [-c channels]\n"
+                    "       [-l loss] [-j jitter] [-m mbps] [-b baud] [-P delay] [-D ppm] [-d seconds]\n"
+                    "       [-k ms] [-s seed] [-f]\n", name);
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    parseList("1,2,4,8,16,32", options.sensors, toInt);
+    parseList("0.5,1,2,4,8", options.touches, toDouble);
+    options.pads = 1;
+    options.receivers = 1;
+    options.channels = 1;
+    options.loss = 0.01;
+    options.jitterUs = 300;
+    options.mbps = 1;
+    options.baud = 115200;
+    options.playoutUs = PLAYOUT_DELAY_US;
+    options.driftPpm = 20;
+    options.seconds = 10;
+    options.killMs = 0;
+    options.seed = 1;
+    options.framed = false;
+
+    int opt;
+    bool ok = true;
+    while ((opt = getopt(argc, argv, "n:t:p:r:c:l:j:m:b:P:D:d:k:s:f")) != -1) {
+        switch (opt) {
+            case 'n': ok = parseList(optarg, options.sensors, toInt) && ok; break;
+            case 't': ok = parseList(optarg, options.touches, toDouble) && ok; break;
+            case 'p': options.pads = atoi(optarg); break;
+            case 'r': options.receivers = atoi(optarg); break;
+            case 'c': options.channels = atoi(optarg); break;
+            case 'l': options.loss = atof(optarg); break;
+            case 'j': options.jitterUs = strtoul(optarg, NULL, 10); break;
+            case 'm': options.mbps = atof(optarg); break;
+            case 'b': options.baud = strtol(optarg, NULL, 10); break;
+            case 'P': options.playoutUs = strtoul(optarg, NULL, 10); break;
+            case 'D': options.driftPpm = atof(optarg); break;
+            case 'd': options.seconds = atof(optarg); break;
+            case 'k': options.killMs = atof(optarg); break;
+            case 's': options.seed = strtoul(optarg, NULL, 10); break;
+            case 'f': options.framed = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (!ok || optind != argc || options.pads < 1 || options.pads > PAD_ENGINE_MAX_PADS ||
+        options.receivers < 1 || options.channels < 1 || options.channels > options.receivers ||
+        options.loss < 0 || options.loss >= 1 || options.mbps <= 0 || options.baud <= 0 || options.seconds <= 0 ||
+        options.playoutUs > PLAYOUT_MAX_DELAY_US || options.driftPpm < 0 || options.killMs < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("%d pad(s) per sensor, %d receiver(s) on %d channel(s), loss %.3f, jitter %u us, %.1f Mbps, %ld baud%s, "
+           "playout %u us, drift %.0f ppm",
+           options.pads, options.receivers, options.channels, options.loss, options.jitterUs, options.mbps,
+           options.baud, options.framed ? " framed" : "", options.playoutUs, options.driftPpm);
+    if (options.killMs > 0) {
+        printf(", receiver 0 dies at %.0f ms", options.killMs);
+    }
+    printf("\n");
+    printf("sensors  touch/s  offered/s  delivered/s  drop%%  unpaired  qfull  retries  ring  lost  dup  released  coll  late"
+           "  failover  switch  doubled  stuck  air%%  uart%%    p50    p90    p99    max\n");
+
+    for (size_t n = 0; n < options.sensors.size(); n++) {
+        for (size_t t = 0; t < options.touches.size(); t++) {
+            Result result;
+            run(options, options.sensors[n], options.touches[t], result);
+
+            const Totals &totals = result.totals;
+            double dropped = totals.offered > totals.delivered ? totals.offered - totals.delivered : 0;
+            const LatencyHistogram &latency = totals.latency;
+            printf("%7d  %7.1f  %9.0f  %11.0f  %5.1f  %8llu  %5llu  %7llu  %4llu  %4llu  %3llu  %8llu  %4llu  %4llu"
+                   "  %8llu  %6.1f  %7llu  %5llu  %4.0f  %5.0f  %5u  %5u  %5u  %5u\n",
+                   options.sensors[n], options.touches[t],
+                   totals.offered / options.seconds, totals.delivered / options.seconds,
+                   totals.offered ? 100.0 * dropped / totals.offered : 0.0,
+                   (unsigned long long)totals.unpaired, (unsigned long long)totals.queueFull,
+                   (unsigned long long)totals.retriesOut, (unsigned long long)totals.ringFull,
+                   (unsigned long long)totals.lostReceiver, (unsigned long long)totals.duplicates,
+                   (unsigned long long)totals.released, (unsigned long long)totals.collisions,
+                   (unsigned long long)totals.late, (unsigned long long)totals.failovers, totals.switchUs / 1000.0,
+                   (unsigned long long)totals.doubled, (unsigned long long)totals.stuck,
+                   100 * result.airBusy, 100 * result.uartBusy,
+                   latency.percentile(50), latency.percentile(90), latency.percentile(99), latency.getMax());
+        }
+    }
+
+    return 0;
+}
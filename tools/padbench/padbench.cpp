@@ -0,0 +1,99 @@
+/**
+ * padbench - scan cost of the Edge Sensors pad engine.
+ *
+ *   padbench [scans]   runs PadEngine and one TouchOnset per pad over the
+ *                      same synthetic touch recording for 1 to
+ *                      PAD_ENGINE_MAX_PADS pads, checks that both report
+ *                      the same presses and releases, and prints the
+ *                      detector cost per pad and scan
+ *
+ * Only the detectors are timed: on the device every scan also pays one
+ * touchRead() per pad, which is the same for both.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include <PadEngine.h>
+#include <TouchOnset.h>
+
+#define ROUNDS 5
+
+// A pad idles around 100 with some noise and is touched for a while every
+// few hundred scans, pads out of phase with each other.
+static std::vector<uint16_t> record(size_t scans) {
+    std::vector<uint16_t> samples(scans * PAD_ENGINE_MAX_PADS);
+    srand(1);
+
+    for (size_t n = 0; n < scans; n++) {
+        for (size_t i = 0; i < PAD_ENGINE_MAX_PADS; i++) {
+            size_t phase = (n + i * 37) % (300 + i * 20);
+            uint16_t level = phase < 120 ? 55 + (phase < 4 ? (4 - phase) * 10 : 0) : 100;
+            samples[n * PAD_ENGINE_MAX_PADS + i] = level + rand() % 5;
+        }
+    }
+
+    return samples;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    size_t scans = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    std::vector<uint16_t> samples = record(scans);
+
+    printf("pads  onset ns/pad  engine ns/pad  events\n");
+    for (uint8_t pads = 1; pads <= PAD_ENGINE_MAX_PADS; pads++) {
+        double onsetBest = 1e9;
+        double engineBest = 1e9;
+        unsigned long engineEvents = 0;
+
+        for (int round = 0; round < ROUNDS; round++) {
+            TouchOnset onsets[PAD_ENGINE_MAX_PADS];
+            std::vector<PadMask> onsetChanges(scans);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (size_t n = 0; n < scans; n++) {
+                const uint16_t *sample = &samples[n * PAD_ENGINE_MAX_PADS];
+                PadMask changed = 0;
+                for (uint8_t i = 0; i < pads; i++) {
+                    changed |= (PadMask)onsets[i].update(sample[i], n * TOUCH_SAMPLE_PERIOD_US) << i;
+                }
+                onsetChanges[n] = changed;
+            }
+            double onsetTime = seconds(start);
+
+            PadEngine engine;
+            for (uint8_t i = 0; i < pads; i++) {
+                engine.addPad(i, 60 + i, 100);
+            }
+            std::vector<PadMask> engineChanges(scans);
+            start = std::chrono::steady_clock::now();
+            for (size_t n = 0; n < scans; n++) {
+                engineChanges[n] = engine.update(&samples[n * PAD_ENGINE_MAX_PADS], n * TOUCH_SAMPLE_PERIOD_US);
+            }
+            double engineTime = seconds(start);
+
+            engineEvents = 0;
+            for (size_t n = 0; n < scans; n++) {
+                if (onsetChanges[n] != engineChanges[n]) {
+                    fprintf(stderr, "pads=%u scan %zu: onset %04X, engine %04X\n", pads, n, onsetChanges[n], engineChanges[n]);
+                    return 1;
+                }
+                engineEvents += __builtin_popcount(engineChanges[n]);
+            }
+
+            onsetBest = onsetTime < onsetBest ? onsetTime : onsetBest;
+            engineBest = engineTime < engineBest ? engineTime : engineBest;
+        }
+
+        printf("%4u  %12.2f  %13.2f  %6lu\n", pads,
+               onsetBest * 1e9 / scans / pads, engineBest * 1e9 / scans / pads, engineEvents);
+    }
+
+    return 0;
+}
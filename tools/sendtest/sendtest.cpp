@@ -0,0 +1,319 @@
+/**
+ * sendtest - the Edge Sensors send path against the WifiEspNow stand-in.
+ *
+ *   HL_ACK_LOSS=0.3 sendtest     or  make check  for a few loss rates
+ *
+ * Built like the firmware under env:native: this file is the sketch and
+ * lib/NativeHal supplies main(), on the virtual clock. loop() presses and
+ * releases PADS pads in turn, batches the events into frames and runs the
+ * SendQueue as serviceSendQueue() in Edge Sensors/src/main.cpp does. The
+ * stand-in drops the ack of a send with probability HL_ACK_LOSS; the frame
+ * itself always arrives, as when only the ack is lost on the air.
+ *
+ * The transmit hook plays the receiver, which drops retransmits by their
+ * sequence number as PeerTable does. The run fails if an event arrives
+ * out of the order it was raised in, if a pad's note-off arrives before
+ * its note-on, if an event never arrives, or if a loop() spent any time
+ * waiting on the radio. Prints the queue stats and loop() cost.
+ *
+ * Before the run, setup() checks that a queue cleared from inside its
+ * drop callback, as the firmware once did on losing its receiver, comes
+ * out empty and keeps working, that the frame which caused a failover is
+ * not lost, and that a sensor whose receivers are both dead fails over
+ * once and then forgets them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <Arduino.h>
+#include <NativeHal.h>
+#include <WifiEspNow.h>
+
+#include <MidiFrame.h>
+#include <SendQueue.h>
+
+#define RUN_MS 60000
+#define PADS 4
+#define TOUCH_PERIOD_MS 40
+#define BATCH_WINDOW_US 1500
+
+// -- Mirrors of the Edge Sensors/src/main.cpp defines.
+#define RECEIVER_LOST_DROPS 3
+#define FAILOVER_FAILED_SENDS 4
+
+static const uint8_t receiverMac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+
+SendQueue sendQueue;
+MidiBatch midiBatch;
+uint16_t midiSequence = 0;
+bool touched[PADS];
+
+uint32_t raised = 0;
+
+// -- What the receiver saw.
+uint16_t nextSequence = 0;
+uint32_t arrived = 0;
+uint32_t duplicates = 0;
+bool sounding[PADS];
+
+std::vector<uint32_t> loopNanos;
+unsigned long failures = 0;
+
+static void fail(const char *what, unsigned value) {
+    if (failures++ < 10) {
+        fprintf(stderr, "sendtest: %s (%u) at %lu ms\n", what, value, millis());
+    }
+}
+
+static bool receive(const uint8_t *mac, const uint8_t *buf, size_t count) {
+    (void)mac;
+    MidiEvent events[MIDI_FRAME_MAX_EVENTS];
+    uint8_t eventCount;
+    if (MidiFrame::decode(buf, count, events, eventCount) != FRAME_OK) {
+        fail("undecodable frame", (unsigned)count);
+        return true;
+    }
+
+    for (uint8_t i = 0; i < eventCount; i++) {
+        const MidiEvent &event = events[i];
+        int16_t ahead = (int16_t)(event.sequence - nextSequence);
+        if (ahead < 0) {
+            duplicates++;
+            continue;
+        }
+        if (ahead > 0) {
+            fail("event skipped", event.sequence);
+        }
+        nextSequence = event.sequence + 1;
+        arrived++;
+
+        bool on = event.status == MIDI_STATUS_NOTE_ON;
+        if (sounding[event.pad] == on) {
+            fail(on ? "note-on while sounding" : "note-off before its note-on", event.pad);
+        }
+        sounding[event.pad] = on;
+    }
+
+    return true;
+}
+
+static void flushBatch() {
+    uint8_t frame[MIDI_FRAME_MAX_LENGTH];
+    size_t len = midiBatch.encode(frame);
+    if (!sendQueue.push(frame, len)) {
+        fail("send queue full", (unsigned)len);
+    }
+}
+
+static void raise(uint8_t pad, bool on) {
+    MidiEvent event;
+    event.status = on ? MIDI_STATUS_NOTE_ON : MIDI_STATUS_NOTE_OFF;
+    event.note = 60 + pad;
+    event.velocity = 100;
+    event.pad = pad;
+    event.sequence = midiSequence++;
+    event.flags = 0;
+    event.timestamp = micros();
+
+    midiBatch.add(event, micros());
+    raised++;
+    if (midiBatch.isFull()) {
+        flushBatch();
+    }
+}
+
+static void serviceSendQueue() {
+    if (!midiBatch.isEmpty() && (micros() - midiBatch.getStartedAt()) >= BATCH_WINDOW_US) {
+        flushBatch();
+    }
+
+    if (sendQueue.isBusy()) {
+        WifiEspNowSendStatus status = WifiEspNow.getSendStatus();
+        if (status != WifiEspNowSendStatus::NONE) {
+            sendQueue.onSendComplete(status == WifiEspNowSendStatus::OK);
+        }
+    }
+
+    sendQueue.loop(millis());
+}
+
+static void finish() {
+    // Let the queue drain before counting what arrived.
+    for (unsigned long drainUntil = millis() + 1000; millis() < drainUntil; NativeHal::tick()) {
+        serviceSendQueue();
+    }
+
+    const SendQueueStats &stats = sendQueue.getStats();
+    if (arrived != raised) {
+        fail("events lost", raised - arrived);
+    }
+
+    std::sort(loopNanos.begin(), loopNanos.end());
+    size_t n = loopNanos.size();
+    printf("ack loss %.2f: %u events raised, %u arrived, %u duplicates; sent=%u retries=%u dropped=%u overflows=%u; "
+           "loop p50=%u p99=%u max=%u ns\n",
+           NativeHal::envDouble("HL_ACK_LOSS", 0), raised, arrived, duplicates,
+           stats.sent, stats.retries, stats.dropped, stats.overflows,
+           loopNanos[n / 2], loopNanos[n * 99 / 100], loopNanos[n - 1]);
+
+    if (failures) {
+        fprintf(stderr, "sendtest: FAILED, %lu problem(s)\n", failures);
+        exit(1);
+    }
+    exit(0);
+}
+
+static void checkClearFromCallback() {
+    SendQueue queue;
+    queue.onTransmit([](const uint8_t *frame, size_t len) {
+        (void)frame;
+        (void)len;
+        return false;
+    });
+    queue.onDropped([&queue](const PendingFrame &frame) {
+        (void)frame;
+        queue.clear();
+    });
+
+    uint8_t frame[MIDI_FRAME_HEADER_LENGTH + MIDI_EVENT_LENGTH] = {MIDI_FRAME_VERSION};
+    for (int i = 0; i < 3; i++) {
+        queue.push(frame, sizeof(frame));
+    }
+    for (unsigned long now = 0; now < 20 * SEND_QUEUE_TIMEOUT_MS; now += SEND_QUEUE_TIMEOUT_MS) {
+        queue.loop(now);
+    }
+    if (queue.size() != 0) {
+        fail("queue cleared in its drop callback, size", (unsigned)queue.size());
+    }
+
+    queue.push(frame, sizeof(frame));
+    if (queue.size() != 1) {
+        fail("push after a clear in the drop callback, size", (unsigned)queue.size());
+    }
+}
+
+// The primary never acks; the fourth failure switches to the standby,
+// which acks every frame. The frame that failed over must not be lost.
+static void checkFailOverKeepsHead() {
+    SendQueue queue;
+    bool primary = true;
+    unsigned unacked = 0;
+    queue.onTransmit([&primary](const uint8_t *frame, size_t len) {
+        (void)frame;
+        (void)len;
+        return !primary;
+    });
+    queue.onFailed([&primary, &unacked](const PendingFrame &frame) {
+        (void)frame;
+        if (++unacked == 4) {
+            primary = false;
+            return true;
+        }
+        return false;
+    });
+
+    uint8_t frame[MIDI_FRAME_HEADER_LENGTH + MIDI_EVENT_LENGTH] = {MIDI_FRAME_VERSION};
+    queue.push(frame, sizeof(frame));
+    for (unsigned long now = 0; now < 20 * SEND_QUEUE_TIMEOUT_MS && queue.size(); now += SEND_QUEUE_TIMEOUT_MS) {
+        queue.loop(now);
+        if (queue.isBusy()) {
+            queue.onSendComplete(true);
+        }
+    }
+    if (queue.getStats().sent != 1 || queue.getStats().dropped != 0) {
+        fail("frame that failed over, dropped", queue.getStats().dropped);
+    }
+}
+
+// Neither receiver acks. sendFailed() and frameDropped() as in main.cpp:
+// the sensor fails over once, then drops its frames and forgets both
+// receivers instead of switching between them for good.
+static void checkBothReceiversDead() {
+    SendQueue queue;
+    uint8_t failedInARow = 0;
+    bool failedOver = false;
+    uint8_t droppedInARow = 0;
+    bool receiverLost = false;
+    unsigned failovers = 0;
+    queue.onTransmit([](const uint8_t *frame, size_t len) {
+        (void)frame;
+        (void)len;
+        return true;
+    });
+    queue.onFailed([&](const PendingFrame &frame) {
+        (void)frame;
+        if (++failedInARow >= FAILOVER_FAILED_SENDS && !failedOver) {
+            failedInARow = 0;
+            failedOver = true;
+            failovers++;
+            return true;
+        }
+        return false;
+    });
+    queue.onDropped([&](const PendingFrame &frame) {
+        (void)frame;
+        if (++droppedInARow >= RECEIVER_LOST_DROPS) {
+            receiverLost = true;
+        }
+    });
+
+    uint8_t frame[MIDI_FRAME_HEADER_LENGTH + MIDI_EVENT_LENGTH] = {MIDI_FRAME_VERSION};
+    for (int i = 0; i < RECEIVER_LOST_DROPS; i++) {
+        queue.push(frame, sizeof(frame));
+    }
+    for (unsigned long now = 0; now < 1000 * SEND_QUEUE_TIMEOUT_MS && !receiverLost; now++) {
+        queue.loop(now);
+        if (queue.isBusy()) {
+            queue.onSendComplete(false);
+        }
+    }
+    if (!receiverLost || failovers != 1) {
+        fail("both receivers dead, failovers", failovers);
+    }
+}
+
+void setup() {
+    checkClearFromCallback();
+    checkFailOverKeepsHead();
+    checkBothReceiversDead();
+
+    NativeHal::useVirtualClock(true);
+    loopNanos.reserve(RUN_MS * 20);
+    WifiEspNow.begin();
+    WifiEspNow.addPeer(receiverMac);
+    WifiEspNow.onTransmit(receive);
+
+    sendQueue.onTransmit([](const uint8_t *frame, size_t len) {
+        return WifiEspNow.send(receiverMac, frame, len);
+    });
+}
+
+void loop() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long startedAt = micros();
+
+    // Every pad flips every TOUCH_PERIOD_MS / 2, pads a little apart.
+    for (uint8_t pad = 0; pad < PADS; pad++) {
+        bool touch = (millis() + pad * 7) % TOUCH_PERIOD_MS < TOUCH_PERIOD_MS / 2;
+        if (touch != touched[pad]) {
+            touched[pad] = touch;
+            raise(pad, touch);
+        }
+    }
+    serviceSendQueue();
+
+    if (micros() != startedAt) {
+        fail("loop() waited on the radio, us", (unsigned)(micros() - startedAt));
+    }
+    loopNanos.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    if (millis() >= RUN_MS) {
+        finish();
+    }
+}
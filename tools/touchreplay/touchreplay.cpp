@@ -0,0 +1,333 @@
+/**
+ * touchreplay - detection latency and false triggers of the pad engine.
+ *
+ *   touchreplay [-l loop_us,...] [-u] [-c] [-s seed] [trace...]
+ *
+ * Replays touch traces through PadEngine::scan() as loop() calls it, at
+ * each loop period of -l (default 100,500,2000 us, each loop up to half a
+ * period late), and prints per trace and period:
+ *
+ *   touches    touches in the trace
+ *   missed     touches that never fired a press
+ *   false      presses outside a touch, or a second one within it
+ *   p50..max   touch start to press
+ *
+ * A trace is a text file with one sample per line, "micros value touched",
+ * as a sketch printing micros() and touchRead() would log it, with the
+ * touched column marking where the finger really was (from a reference
+ * switch, or by hand). Without files the built-in scenarios are used:
+ *
+ *   clean   quick, firm taps on a quiet pad
+ *   soft    light touches that take 10 to 30 ms to build up
+ *   drift   clean taps while the baseline swings by 20% (humidity, cabling)
+ *   noisy   clean taps with 3x the noise and short interference dips
+ *   idle    nobody touching, noise and drift only
+ *
+ * -u feeds the detector on every loop, as before scan() kept to
+ * TOUCH_SAMPLE_PERIOD_US, to show how its time constants follow the loop.
+ * -c checks the built-in scenarios against their limits and fails if one
+ * is exceeded.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <PadEngine.h>
+#include <TouchOnset.h>
+
+#define TRACE_STEP_US 100
+#define TRACE_SECONDS 60
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+struct Sample {
+    uint32_t at;
+    uint16_t value;
+    bool touched;
+};
+
+struct Trace {
+    std::string name;
+    std::vector<Sample> samples;
+
+    // -- Limits for -c, built-in scenarios only.
+    unsigned maxMissed;
+    unsigned maxFalse;
+    double maxP90Ms;
+};
+
+struct Result {
+    unsigned touches;
+    unsigned missed;
+    unsigned falsePresses;
+    std::vector<uint32_t> latency;
+};
+
+static uint32_t state = 1;
+
+static uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static double uniform(double low, double high) {
+    return low + (high - low) * (next() / 4294967296.0);
+}
+
+struct Scenario {
+    const char *name;
+    bool touches;
+    double depth;           // fraction of the baseline a full touch takes off
+    double rampMinMs;       // time the finger takes to press fully
+    double rampMaxMs;
+    double noise;           // +- raw counts
+    double drift;           // baseline swing, fraction
+    double dipsPerSecond;   // interference dips of 30%, 200 us long
+    unsigned maxMissed;
+    unsigned maxFalse;
+    double maxP90Ms;
+};
+
+static const Scenario scenarios[] = {
+    {"clean", true, 0.45, 0.5, 2, 2, 0, 0, 0, 0, 5},
+    {"soft", true, 0.28, 10, 30, 2, 0, 0, 0, 0, 40},
+    {"drift", true, 0.45, 0.5, 2, 2, 0.2, 0, 0, 0, 5},
+    {"noisy", true, 0.45, 0.5, 2, 6, 0, 0.5, 0, 10, 5},
+    {"idle", false, 0, 0, 0, 4, 0.2, 0, 0, 0, 0},
+};
+
+static Trace synthesize(const Scenario &scenario) {
+    Trace trace;
+    trace.name = scenario.name;
+    trace.maxMissed = scenario.maxMissed;
+    trace.maxFalse = scenario.maxFalse;
+    trace.maxP90Ms = scenario.maxP90Ms;
+
+    uint32_t end = TRACE_SECONDS * 1000000UL;
+    uint32_t touchAt = 500000;
+    uint32_t rampUs = 0;
+    uint32_t releaseAt = 0;
+    uint32_t dipUntil = 0;
+
+    for (uint32_t at = 0; at < end; at += TRACE_STEP_US) {
+        double base = 100 * (1 + scenario.drift * sin(2 * M_PI * at / 20e6));
+
+        bool touched = scenario.touches && at >= touchAt && at < releaseAt;
+        if (scenario.touches && at >= touchAt && releaseAt <= touchAt) {
+            rampUs = (uint32_t)(uniform(scenario.rampMinMs, scenario.rampMaxMs) * 1000);
+            releaseAt = touchAt + (uint32_t)(uniform(80, 300) * 1000);
+            touched = true;
+        } else if (scenario.touches && releaseAt > touchAt && at >= releaseAt) {
+            touchAt = at + (uint32_t)(uniform(200, 800) * 1000);
+        }
+
+        double press = 0;
+        if (touched) {
+            press = rampUs ? std::min(1.0, (double)(at - touchAt) / rampUs) : 1;
+        } else if (releaseAt > 0 && at >= releaseAt && at - releaseAt < 5000) {
+            // The finger lifts over 5 ms, which no longer counts as touched.
+            press = 1 - (at - releaseAt) / 5000.0;
+        }
+
+        if (scenario.dipsPerSecond > 0 && uniform(0, 1) < scenario.dipsPerSecond * TRACE_STEP_US / 1e6) {
+            dipUntil = at + 200;
+        }
+        double dip = at < dipUntil ? 0.3 : 0;
+
+        Sample sample;
+        sample.at = at;
+        sample.value = (uint16_t)std::max(0.0, base * (1 - scenario.depth * press - dip) +
+                                                   uniform(-scenario.noise, scenario.noise));
+        sample.touched = touched;
+        trace.samples.push_back(sample);
+    }
+
+    return trace;
+}
+
+static bool load(const char *path, Trace &trace) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return false;
+    }
+
+    trace.name = path;
+    trace.maxMissed = trace.maxFalse = 0;
+    trace.maxP90Ms = 0;
+
+    char line[128];
+    unsigned number = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        number++;
+        unsigned long at;
+        unsigned value;
+        int touched;
+        int fields = sscanf(line, "%lu %u %d", &at, &value, &touched);
+        if (fields < 3) {
+            if (line[0] != '#' && line[0] != '\n') {
+                fprintf(stderr, "%s:%u: expected \"micros value touched\"\n", path, number);
+                fclose(fp);
+                return false;
+            }
+            continue;
+        }
+
+        Sample sample;
+        sample.at = (uint32_t)at;
+        sample.value = (uint16_t)value;
+        sample.touched = touched != 0;
+        trace.samples.push_back(sample);
+    }
+    fclose(fp);
+
+    if (trace.samples.empty()) {
+        fprintf(stderr, "%s: no samples\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Runs loop() over the trace every loopUs, up to half of that late.
+static Result replay(const Trace &trace, uint32_t loopUs, bool everyLoop) {
+    Result result = {};
+    PadEngine engine;
+    engine.addPad(0, 60, 100);
+
+    const std::vector<Sample> &samples = trace.samples;
+    size_t index = 0;
+    bool wasTouched = false;
+    bool pressedThisTouch = false;
+    uint32_t touchedAt = 0;
+
+    uint32_t start = samples.front().at;
+    uint32_t end = samples.back().at;
+    for (uint32_t now = start; now <= end; now += loopUs + next() % (loopUs / 2 + 1)) {
+        while (index + 1 < samples.size() && samples[index + 1].at <= now) {
+            index++;
+            const Sample &sample = samples[index];
+            if (sample.touched && !wasTouched) {
+                result.touches++;
+                pressedThisTouch = false;
+                touchedAt = sample.at;
+            } else if (!sample.touched && wasTouched && !pressedThisTouch) {
+                result.missed++;
+            }
+            wasTouched = sample.touched;
+        }
+
+        uint16_t value = samples[index].value;
+        PadMask changed = everyLoop ? engine.update(&value, now)
+                                    : engine.scan([value](uint8_t pin) { (void)pin; return value; }, now);
+        if (!(changed & engine.getPressed())) {
+            continue;
+        }
+
+        if (wasTouched && !pressedThisTouch) {
+            pressedThisTouch = true;
+            result.latency.push_back(now - touchedAt);
+        } else {
+            result.falsePresses++;
+        }
+    }
+    if (wasTouched && !pressedThisTouch) {
+        result.missed++;
+    }
+
+    std::sort(result.latency.begin(), result.latency.end());
+    return result;
+}
+
+static double percentileMs(const std::vector<uint32_t> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * fraction))] / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    std::vector<uint32_t> loops;
+    bool everyLoop = false;
+    bool checkLimits = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:ucs:")) != -1) {
+        switch (opt) {
+            case 'l':
+                for (char *item = strtok(optarg, ","); item; item = strtok(NULL, ",")) {
+                    loops.push_back(strtoul(item, NULL, 10));
+                }
+                break;
+            case 'u': everyLoop = true; break;
+            case 'c': checkLimits = true; break;
+            case 's': state = strtoul(optarg, NULL, 10) | 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-l loop_us,...] [-u] [-c] [-s seed] [trace...]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (loops.empty()) {
+        loops.push_back(100);
+        loops.push_back(500);
+        loops.push_back(2000);
+    }
+    for (size_t i = 0; i < loops.size(); i++) {
+        if (loops[i] == 0) {
+            fprintf(stderr, "loop periods must be above 0\n");
+            return 2;
+        }
+    }
+
+    std::vector<Trace> traces;
+    if (optind < argc) {
+        checkLimits = false;
+        for (int i = optind; i < argc; i++) {
+            Trace trace;
+            if (!load(argv[i], trace)) {
+                return 1;
+            }
+            traces.push_back(trace);
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+            traces.push_back(synthesize(scenarios[i]));
+        }
+    }
+
+    printf("sampling %s\n", everyLoop ? "every loop" : "every " XSTR(TOUCH_SAMPLE_PERIOD_US) " us");
+    printf("trace    loop us  touches  missed  false  false/min  p50 ms  p90 ms  max ms\n");
+    unsigned failed = 0;
+    for (size_t t = 0; t < traces.size(); t++) {
+        const Trace &trace = traces[t];
+        double minutes = (trace.samples.back().at - trace.samples.front().at) / 60e6;
+        for (size_t l = 0; l < loops.size(); l++) {
+            Result result = replay(trace, loops[l], everyLoop);
+            double p90 = percentileMs(result.latency, 0.9);
+            printf("%-7s  %7u  %7u  %6u  %5u  %9.1f  %6.1f  %6.1f  %6.1f\n", trace.name.c_str(), loops[l],
+                   result.touches, result.missed, result.falsePresses,
+                   minutes > 0 ? result.falsePresses / minutes : 0.0,
+                   percentileMs(result.latency, 0.5), p90, percentileMs(result.latency, 1));
+
+            // The limits hold as long as the loop keeps up with the sample
+            // period.
+            if (checkLimits && loops[l] < TOUCH_SAMPLE_PERIOD_US &&
+                (result.missed > trace.maxMissed || result.falsePresses > trace.maxFalse || p90 > trace.maxP90Ms)) {
+                fprintf(stderr, "%s at %u us: over its limits (missed %u, false %u, p90 %.1f ms)\n",
+                        trace.name.c_str(), loops[l], trace.maxMissed, trace.maxFalse, trace.maxP90Ms);
+                failed++;
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}